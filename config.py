@@ -12,6 +12,9 @@ def get_doc_classes():
     return [
         "MeshDataResource",
         "MeshDataInstance",
+        "MeshDataMultiInstance",
+        "MeshDataStaticBatch",
+        "MeshDataServer",
 
         "MeshDataInstanceProcessor",
         "PropDataMeshData",
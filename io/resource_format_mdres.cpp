@@ -0,0 +1,968 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "resource_format_mdres.h"
+
+#include "core/config/project_settings.h"
+#include "core/io/dir_access.h"
+#include "core/io/marshalls.h"
+
+#include "../mesh_data_resource.h"
+#include "../mesh_data_resource_collection.h"
+
+#define MDRES_FORMAT_VERSION 4
+#define MDRES_COLLECTION_FORMAT_VERSION 1
+#define MDRES_BLOB_ALIGNMENT 16
+
+enum MDResFlags {
+	MDRES_FLAG_2D = 1 << 0,
+	MDRES_FLAG_REAL_T_IS_DOUBLE = 1 << 1,
+};
+
+//How collision shapes and the meshes of collections are stored
+enum MDResStorage {
+	MDRES_STORAGE_EMBEDDED = 0,
+	MDRES_STORAGE_EXTERNAL,
+};
+
+static void _store_padding(Ref<FileAccess> f) {
+	uint64_t pos = f->get_position();
+
+	while (pos % MDRES_BLOB_ALIGNMENT != 0) {
+		f->store_8(0);
+		++pos;
+	}
+}
+
+static void _skip_padding(Ref<FileAccess> f) {
+	uint64_t pos = f->get_position();
+
+	if (pos % MDRES_BLOB_ALIGNMENT != 0) {
+		f->seek(pos + MDRES_BLOB_ALIGNMENT - pos % MDRES_BLOB_ALIGNMENT);
+	}
+}
+
+//Blobs are little endian on disk, every element is swapped component by component on big endian hosts
+template <class T>
+struct MDResBlobComponent {
+	static const int size = sizeof(T);
+};
+
+template <>
+struct MDResBlobComponent<Vector2> {
+	static const int size = sizeof(real_t);
+};
+
+template <>
+struct MDResBlobComponent<Vector3> {
+	static const int size = sizeof(real_t);
+};
+
+template <>
+struct MDResBlobComponent<Color> {
+	static const int size = sizeof(float);
+};
+
+#ifdef BIG_ENDIAN_ENABLED
+static void _swap_components(uint8_t *p_data, const uint64_t p_len, const int p_component_size) {
+	if (p_component_size == 1) {
+		return;
+	}
+
+	for (uint64_t i = 0; i + p_component_size <= p_len; i += p_component_size) {
+		for (int j = 0; j < p_component_size / 2; ++j) {
+			SWAP(p_data[i + j], p_data[i + p_component_size - 1 - j]);
+		}
+	}
+}
+#endif
+
+template <class T>
+static void _store_blob(Ref<FileAccess> f, const Vector<T> &p_data) {
+	if (p_data.size() == 0) {
+		return;
+	}
+
+	_store_padding(f);
+
+	uint64_t len = p_data.size() * sizeof(T);
+
+#ifdef BIG_ENDIAN_ENABLED
+	Vector<uint8_t> buf;
+	buf.resize(len);
+	memcpy(buf.ptrw(), p_data.ptr(), len);
+	_swap_components(buf.ptrw(), len, MDResBlobComponent<T>::size);
+
+	f->store_buffer(buf.ptr(), len);
+#else
+	f->store_buffer(reinterpret_cast<const uint8_t *>(p_data.ptr()), len);
+#endif
+}
+
+template <class T>
+static Error _load_blob(Ref<FileAccess> f, Vector<T> &r_data, const int p_count) {
+	r_data.clear();
+
+	if (p_count == 0) {
+		return OK;
+	}
+
+	_skip_padding(f);
+
+	ERR_FAIL_COND_V(r_data.resize(p_count) != OK, ERR_OUT_OF_MEMORY);
+
+	uint64_t len = p_count * sizeof(T);
+
+	ERR_FAIL_COND_V(f->get_buffer(reinterpret_cast<uint8_t *>(r_data.ptrw()), len) != len, ERR_FILE_CORRUPT);
+
+#ifdef BIG_ENDIAN_ENABLED
+	_swap_components(reinterpret_cast<uint8_t *>(r_data.ptrw()), len, MDResBlobComponent<T>::size);
+#endif
+
+	return OK;
+}
+
+static void _store_transform(Ref<FileAccess> f, const Transform &p_transform) {
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			f->store_float(p_transform.basis.rows[i][j]);
+		}
+	}
+
+	f->store_float(p_transform.origin.x);
+	f->store_float(p_transform.origin.y);
+	f->store_float(p_transform.origin.z);
+}
+
+static void _store_rect2(Ref<FileAccess> f, const Rect2 &p_rect) {
+	f->store_float(p_rect.position.x);
+	f->store_float(p_rect.position.y);
+	f->store_float(p_rect.size.x);
+	f->store_float(p_rect.size.y);
+}
+
+static Rect2 _load_rect2(Ref<FileAccess> f) {
+	Rect2 r;
+
+	r.position.x = f->get_float();
+	r.position.y = f->get_float();
+	r.size.x = f->get_float();
+	r.size.y = f->get_float();
+
+	return r;
+}
+
+static Transform _load_transform(Ref<FileAccess> f) {
+	Transform t;
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			t.basis.rows[i][j] = f->get_float();
+		}
+	}
+
+	t.origin.x = f->get_float();
+	t.origin.y = f->get_float();
+	t.origin.z = f->get_float();
+
+	return t;
+}
+
+static Error _store_sub_resource(Ref<FileAccess> f, const Ref<Resource> &p_resource) {
+	if (p_resource.is_valid() && p_resource->get_path().is_resource_file()) {
+		f->store_32(MDRES_STORAGE_EXTERNAL);
+		f->store_pascal_string(p_resource->get_path());
+		return OK;
+	}
+
+	f->store_32(MDRES_STORAGE_EMBEDDED);
+
+	int len;
+	Error err = encode_variant(p_resource, nullptr, len, true);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	Vector<uint8_t> buf;
+	buf.resize(len);
+	encode_variant(p_resource, buf.ptrw(), len, true);
+
+	f->store_32(len);
+	f->store_buffer(buf.ptr(), len);
+
+	return OK;
+}
+
+static Error _load_sub_resource(Ref<FileAccess> f, Ref<Resource> &r_resource) {
+	uint32_t storage = f->get_32();
+
+	if (storage == MDRES_STORAGE_EXTERNAL) {
+		r_resource = ResourceLoader::load(f->get_pascal_string());
+		return OK;
+	}
+
+	uint32_t len = f->get_32();
+
+	Vector<uint8_t> buf;
+	buf.resize(len);
+	ERR_FAIL_COND_V(f->get_buffer(buf.ptrw(), len) != len, ERR_FILE_CORRUPT);
+
+	Variant v;
+	Error err = decode_variant(v, buf.ptr(), len, nullptr, true);
+	ERR_FAIL_COND_V(err != OK, ERR_FILE_CORRUPT);
+
+	r_resource = v;
+
+	return OK;
+}
+
+//Reads a sub resource without loading it. The external paths are collected into r_paths (if set),
+//and the reference is written into fw (if set), with its path remapped by p_map.
+static Error _copy_sub_resource(Ref<FileAccess> f, Ref<FileAccess> fw, const HashMap<String, String> *p_map, List<String> *r_paths, const bool p_add_types) {
+	uint32_t storage = f->get_32();
+
+	if (fw.is_valid()) {
+		fw->store_32(storage);
+	}
+
+	if (storage == MDRES_STORAGE_EXTERNAL) {
+		String path = f->get_pascal_string();
+
+		if (r_paths) {
+			r_paths->push_back(p_add_types ? path + "::" + ResourceLoader::get_resource_type(path) : path);
+		}
+
+		if (fw.is_valid()) {
+			if (p_map && p_map->has(path)) {
+				path = (*p_map)[path];
+			}
+
+			fw->store_pascal_string(path);
+		}
+
+		return OK;
+	}
+
+	uint32_t len = f->get_32();
+
+	if (!fw.is_valid()) {
+		f->seek(f->get_position() + len);
+		return OK;
+	}
+
+	Vector<uint8_t> buf;
+	buf.resize(len);
+	ERR_FAIL_COND_V(f->get_buffer(buf.ptrw(), len) != len, ERR_FILE_CORRUPT);
+
+	fw->store_32(len);
+	fw->store_buffer(buf.ptr(), len);
+
+	return OK;
+}
+
+static bool _check_magic(Ref<FileAccess> f, const char *p_magic) {
+	uint8_t magic[4];
+	f->get_buffer(magic, 4);
+
+	return magic[0] == p_magic[0] && magic[1] == p_magic[1] && magic[2] == p_magic[2] && magic[3] == p_magic[3];
+}
+
+Ref<Resource> ResourceFormatLoaderMDRes::load(const String &p_path, const String &p_original_path, Error *r_error, bool p_use_sub_threads, float *r_progress, CacheMode p_cache_mode) {
+	if (r_error) {
+		*r_error = ERR_FILE_CANT_OPEN;
+	}
+
+	Error err;
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::READ, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, Ref<Resource>(), "Cannot open file '" + p_path + "'.");
+
+	if (_check_magic(f, "MDRC")) {
+		Ref<Resource> coll = _load_collection(f, p_path, err);
+
+		if (r_error) {
+			*r_error = err;
+		}
+
+		return coll;
+	}
+
+	f->seek(0);
+
+	Ref<MeshDataResource> mdr;
+	mdr.instantiate();
+
+	MDResHeader header;
+	err = _load_header(f, p_path, header);
+
+	if (err == ERR_FILE_UNRECOGNIZED) {
+		//Probably saved with the generic binary format, let the next loader handle it
+		if (r_error) {
+			*r_error = err;
+		}
+
+		return Ref<Resource>();
+	}
+
+	if (err == OK) {
+		mdr->_aabb = header.aabb;
+		mdr->_index_format = static_cast<MeshDataResource::IndexFormat>(header.index_format);
+		mdr->_quantization = header.quantization;
+
+		err = _load_collision_shapes(f, mdr.ptr(), header);
+	}
+
+	if (err == OK) {
+		if (GLOBAL_GET("mesh_data_resource/lazy_load_geometry")) {
+			//Only the header and the collision shapes are needed for now, geometry gets loaded on first access
+			mdr->_set_geometry_unloaded(p_path, header.vertex_count, header.index_count);
+		} else {
+			err = _load_payload(f, mdr.ptr(), header);
+			mdr->_set_geometry_loaded(p_path);
+		}
+	}
+
+	if (r_error) {
+		*r_error = err;
+	}
+
+	ERR_FAIL_COND_V_MSG(err != OK, Ref<Resource>(), "Failed to load MeshDataResource from '" + p_path + "'.");
+
+	return mdr;
+}
+
+void ResourceFormatLoaderMDRes::get_recognized_extensions(List<String> *p_extensions) const {
+	p_extensions->push_back("mdres");
+}
+
+bool ResourceFormatLoaderMDRes::handles_type(const String &p_type) const {
+	return ClassDB::is_parent_class("MeshDataResource", p_type) || ClassDB::is_parent_class("MeshDataResourceCollection", p_type);
+}
+
+String ResourceFormatLoaderMDRes::get_resource_type(const String &p_path) const {
+	if (p_path.get_extension().to_lower() != "mdres") {
+		return "";
+	}
+
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::READ);
+
+	if (f.is_valid() && _check_magic(f, "MDRC")) {
+		return "MeshDataResourceCollection";
+	}
+
+	return "MeshDataResource";
+}
+
+void ResourceFormatLoaderMDRes::get_dependencies(const String &p_path, List<String> *p_dependencies, bool p_add_types) {
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::READ);
+
+	ERR_FAIL_COND_MSG(f.is_null(), "Cannot open file '" + p_path + "'.");
+
+	//Only externally stored meshes and collision shapes are dependencies, everything else is in the file itself
+	if (_check_magic(f, "MDRC")) {
+		f->get_32();
+		uint32_t count = f->get_32();
+
+		for (uint32_t i = 0; i < count; ++i) {
+			ERR_FAIL_COND(_copy_sub_resource(f, Ref<FileAccess>(), nullptr, p_dependencies, p_add_types) != OK);
+		}
+
+		return;
+	}
+
+	f->seek(0);
+
+	MDResHeader header;
+
+	if (_load_header(f, p_path, header) != OK) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < header.collision_shape_count; ++i) {
+		_load_transform(f);
+
+		ERR_FAIL_COND(_copy_sub_resource(f, Ref<FileAccess>(), nullptr, p_dependencies, p_add_types) != OK);
+	}
+}
+
+Error ResourceFormatLoaderMDRes::rename_dependencies(const String &p_path, const HashMap<String, String> &p_map) {
+	Error err;
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::READ, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, err, "Cannot open file '" + p_path + "'.");
+
+	String tmp_path = p_path + ".depren";
+	Ref<FileAccess> fw = FileAccess::open(tmp_path, FileAccess::WRITE, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, err, "Cannot create file '" + tmp_path + "'.");
+
+	if (_check_magic(f, "MDRC")) {
+		fw->store_buffer(reinterpret_cast<const uint8_t *>("MDRC"), 4);
+		fw->store_32(f->get_32());
+
+		uint32_t count = f->get_32();
+		fw->store_32(count);
+
+		for (uint32_t i = 0; i < count; ++i) {
+			err = _copy_sub_resource(f, fw, &p_map, nullptr, false);
+			ERR_FAIL_COND_V(err != OK, err);
+		}
+	} else {
+		f->seek(0);
+
+		MDResHeader header;
+		err = _load_header(f, p_path, header);
+		ERR_FAIL_COND_V(err != OK, err);
+
+		//The payload offset is the last field of the header
+		uint64_t header_size = f->get_position();
+
+		Vector<uint8_t> buf;
+		buf.resize(header_size);
+
+		f->seek(0);
+		f->get_buffer(buf.ptrw(), header_size);
+		fw->store_buffer(buf.ptr(), header_size);
+
+		for (uint32_t i = 0; i < header.collision_shape_count; ++i) {
+			_store_transform(fw, _load_transform(f));
+
+			err = _copy_sub_resource(f, fw, &p_map, nullptr, false);
+			ERR_FAIL_COND_V(err != OK, err);
+		}
+
+		//Both offsets are aligned, so the blobs stay aligned when the payload is copied as is
+		_store_padding(fw);
+
+		uint64_t payload_offset = fw->get_position();
+
+		f->seek(header.payload_offset);
+
+		uint64_t remaining = f->get_length() - header.payload_offset;
+
+		buf.resize(65536);
+
+		while (remaining > 0) {
+			uint64_t read = f->get_buffer(buf.ptrw(), MIN(remaining, (uint64_t)buf.size()));
+			ERR_FAIL_COND_V(read == 0, ERR_FILE_CORRUPT);
+
+			fw->store_buffer(buf.ptr(), read);
+			remaining -= read;
+		}
+
+		fw->seek(header_size - sizeof(uint64_t));
+		fw->store_64(payload_offset);
+	}
+
+	if (fw->get_error() != OK && fw->get_error() != ERR_FILE_EOF) {
+		return ERR_CANT_CREATE;
+	}
+
+	f.unref();
+	fw.unref();
+
+	Ref<DirAccess> da = DirAccess::create(DirAccess::ACCESS_RESOURCES);
+	da->remove(p_path);
+	da->rename(tmp_path, p_path);
+
+	return OK;
+}
+
+Error ResourceFormatLoaderMDRes::load_geometry(const String &p_path, MeshDataResource *mdr) {
+	ERR_FAIL_COND_V(!mdr, ERR_INVALID_PARAMETER);
+
+	Error err;
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::READ, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, err, "Cannot open file '" + p_path + "'.");
+
+	MDResHeader header;
+	err = _load_header(f, p_path, header);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	mdr->_index_format = static_cast<MeshDataResource::IndexFormat>(header.index_format);
+
+	return _load_payload(f, mdr, header);
+}
+
+Error ResourceFormatLoaderMDRes::_load_header(Ref<FileAccess> f, const String &p_path, MDResHeader &r_header) {
+	if (!_check_magic(f, "MDRS")) {
+		return ERR_FILE_UNRECOGNIZED;
+	}
+
+	uint32_t version = f->get_32();
+	ERR_FAIL_COND_V_MSG(version > MDRES_FORMAT_VERSION, ERR_FILE_UNRECOGNIZED, "Unsupported .mdres version in '" + p_path + "'.");
+
+	uint32_t flags = f->get_32();
+
+#ifdef REAL_T_IS_DOUBLE
+	ERR_FAIL_COND_V_MSG(!(flags & MDRES_FLAG_REAL_T_IS_DOUBLE), ERR_FILE_CORRUPT, "'" + p_path + "' was saved by a single precision build.");
+#else
+	ERR_FAIL_COND_V_MSG(flags & MDRES_FLAG_REAL_T_IS_DOUBLE, ERR_FILE_CORRUPT, "'" + p_path + "' was saved by a double precision build.");
+#endif
+
+	r_header.flags = flags;
+	r_header.attribute_mask = f->get_32();
+	r_header.vertex_count = f->get_32();
+	r_header.index_format = f->get_32();
+	r_header.index_count = f->get_32();
+	r_header.seam_count = f->get_32();
+
+	r_header.aabb.position.x = f->get_float();
+	r_header.aabb.position.y = f->get_float();
+	r_header.aabb.position.z = f->get_float();
+	r_header.aabb.size.x = f->get_float();
+	r_header.aabb.size.y = f->get_float();
+	r_header.aabb.size.z = f->get_float();
+
+	if (version >= 2) {
+		r_header.quantization = f->get_32();
+		r_header.stored_quantization = f->get_32();
+		r_header.uvs_range = _load_rect2(f);
+		r_header.uv2s_range = _load_rect2(f);
+	}
+
+	if (version >= 3) {
+		r_header.lod_count = f->get_32();
+	}
+
+	if (version >= 4) {
+		r_header.cluster_count = f->get_32();
+	}
+
+	r_header.collision_shape_count = f->get_32();
+	r_header.payload_offset = f->get_64();
+
+	return OK;
+}
+
+Error ResourceFormatLoaderMDRes::_load_collision_shapes(Ref<FileAccess> f, MeshDataResource *mdr, const MDResHeader &p_header) {
+	mdr->_collision_shapes.clear();
+
+	for (uint32_t i = 0; i < p_header.collision_shape_count; ++i) {
+		MeshDataResource::MDRData d;
+
+		d.transform = _load_transform(f);
+
+		Ref<Resource> shape;
+		Error err = _load_sub_resource(f, shape);
+		ERR_FAIL_COND_V(err != OK, err);
+
+		d.shape = shape;
+
+		mdr->_collision_shapes.push_back(d);
+	}
+
+	return OK;
+}
+
+Ref<Resource> ResourceFormatLoaderMDRes::_load_collection(Ref<FileAccess> f, const String &p_path, Error &r_error) {
+	uint32_t version = f->get_32();
+
+	r_error = ERR_FILE_UNRECOGNIZED;
+	ERR_FAIL_COND_V_MSG(version > MDRES_COLLECTION_FORMAT_VERSION, Ref<Resource>(), "Unsupported .mdres version in '" + p_path + "'.");
+
+	Ref<MeshDataResourceCollection> coll;
+	coll.instantiate();
+
+	uint32_t count = f->get_32();
+
+	for (uint32_t i = 0; i < count; ++i) {
+		Ref<Resource> mdr;
+		r_error = _load_sub_resource(f, mdr);
+
+		ERR_FAIL_COND_V_MSG(r_error != OK, Ref<Resource>(), "Failed to load MeshDataResourceCollection from '" + p_path + "'.");
+
+		coll->add_mdr(mdr);
+	}
+
+	r_error = OK;
+
+	return coll;
+}
+
+Error ResourceFormatLoaderMDRes::_load_payload(Ref<FileAccess> f, MeshDataResource *mdr, const MDResHeader &p_header) {
+	f->seek(p_header.payload_offset);
+
+	uint32_t mask = p_header.attribute_mask;
+	int vc = p_header.vertex_count;
+	Error err = OK;
+
+	if (p_header.flags & MDRES_FLAG_2D) {
+		err = _load_blob(f, mdr->_vertices_2d, (mask & (1 << Mesh::ARRAY_VERTEX)) ? vc : 0);
+		mdr->_vertices.clear();
+	} else {
+		err = _load_blob(f, mdr->_vertices, (mask & (1 << Mesh::ARRAY_VERTEX)) ? vc : 0);
+		mdr->_vertices_2d.clear();
+	}
+	ERR_FAIL_COND_V(err != OK, err);
+
+	//Every attribute is either in its full or in its quantized buffer, the other one stays empty
+	uint32_t q = p_header.stored_quantization;
+	bool uvs_q = q & (MeshDataResource::QUANTIZATION_UVS_HALF | MeshDataResource::QUANTIZATION_UVS_UNORM16);
+
+	int normal_count = (mask & (1 << Mesh::ARRAY_NORMAL)) ? vc : 0;
+	int tangent_count = (mask & (1 << Mesh::ARRAY_TANGENT)) ? vc : 0;
+	int color_count = (mask & (1 << Mesh::ARRAY_COLOR)) ? vc : 0;
+	int uv_count = (mask & (1 << Mesh::ARRAY_TEX_UV)) ? vc : 0;
+	int uv2_count = (mask & (1 << Mesh::ARRAY_TEX_UV2)) ? vc : 0;
+	int bone_count = (mask & (1 << Mesh::ARRAY_BONES)) ? vc * 4 : 0;
+	int weight_count = (mask & (1 << Mesh::ARRAY_WEIGHTS)) ? vc * 4 : 0;
+
+	bool normals_q = q & MeshDataResource::QUANTIZATION_NORMALS_OCTAHEDRAL;
+
+	err = _load_blob(f, mdr->_normals, normals_q ? 0 : normal_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_normals_q, normals_q ? normal_count : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_tangents, normals_q ? 0 : tangent_count * 4);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_tangents_q, normals_q ? tangent_count : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	bool colors_q = q & MeshDataResource::QUANTIZATION_COLORS_UNORM8;
+
+	err = _load_blob(f, mdr->_colors, colors_q ? 0 : color_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_colors_q, colors_q ? color_count * 4 : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	err = _load_blob(f, mdr->_uvs, uvs_q ? 0 : uv_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_uvs_q, uvs_q ? uv_count * 2 : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_uv2s, uvs_q ? 0 : uv2_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_uv2s_q, uvs_q ? uv2_count * 2 : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	mdr->_uvs_range = p_header.uvs_range;
+	mdr->_uv2s_range = p_header.uv2s_range;
+
+	bool bones_q = q & MeshDataResource::QUANTIZATION_BONES_UINT8;
+
+	err = _load_blob(f, mdr->_bones, bones_q ? 0 : bone_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_bones_q, bones_q ? bone_count : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	bool weights_q = q & MeshDataResource::QUANTIZATION_WEIGHTS_UNORM8;
+
+	err = _load_blob(f, mdr->_weights, weights_q ? 0 : weight_count);
+	ERR_FAIL_COND_V(err != OK, err);
+	err = _load_blob(f, mdr->_weights_q, weights_q ? weight_count : 0);
+	ERR_FAIL_COND_V(err != OK, err);
+
+	if (mdr->_index_format == MeshDataResource::INDEX_FORMAT_16_BIT) {
+		mdr->_indices_32.clear();
+		mdr->_seams_32.clear();
+
+		err = _load_blob(f, mdr->_indices_16, p_header.index_count);
+		ERR_FAIL_COND_V(err != OK, err);
+		err = _load_blob(f, mdr->_seams_16, p_header.seam_count);
+		ERR_FAIL_COND_V(err != OK, err);
+	} else {
+		mdr->_indices_16.clear();
+		mdr->_seams_16.clear();
+
+		err = _load_blob(f, mdr->_indices_32, p_header.index_count);
+		ERR_FAIL_COND_V(err != OK, err);
+		err = _load_blob(f, mdr->_seams_32, p_header.seam_count);
+		ERR_FAIL_COND_V(err != OK, err);
+	}
+
+	mdr->_lods.clear();
+
+	for (uint32_t i = 0; i < p_header.lod_count; ++i) {
+		MeshDataResource::MDRLod lod;
+
+		lod.error = f->get_float();
+		uint32_t lod_index_count = f->get_32();
+
+		if (mdr->_index_format == MeshDataResource::INDEX_FORMAT_16_BIT) {
+			err = _load_blob(f, lod.indices_16, lod_index_count);
+		} else {
+			err = _load_blob(f, lod.indices_32, lod_index_count);
+		}
+		ERR_FAIL_COND_V(err != OK, err);
+
+		mdr->_lods.push_back(lod);
+	}
+
+	mdr->_clusters.resize(p_header.cluster_count);
+	MDRCluster *cw = mdr->_clusters.ptrw();
+
+	for (uint32_t i = 0; i < p_header.cluster_count; ++i) {
+		MDRCluster &c = cw[i];
+
+		c.triangle_offset = f->get_32();
+		c.triangle_count = f->get_32();
+		c.center.x = f->get_float();
+		c.center.y = f->get_float();
+		c.center.z = f->get_float();
+		c.radius = f->get_float();
+		c.cone_axis.x = f->get_float();
+		c.cone_axis.y = f->get_float();
+		c.cone_axis.z = f->get_float();
+		c.cone_cutoff = f->get_float();
+	}
+
+	return OK;
+}
+
+ResourceFormatLoaderMDRes::ResourceFormatLoaderMDRes() {
+}
+
+ResourceFormatLoaderMDRes::~ResourceFormatLoaderMDRes() {
+}
+
+Error ResourceFormatSaverMDRes::save(const Ref<Resource> &p_resource, const String &p_path, uint32_t p_flags) {
+	Ref<MeshDataResourceCollection> coll = p_resource;
+
+	if (coll.is_valid()) {
+		return _save_collection(coll, p_path, p_flags);
+	}
+
+	Ref<MeshDataResource> mdr = p_resource;
+
+	ERR_FAIL_COND_V(!mdr.is_valid(), ERR_INVALID_PARAMETER);
+
+	mdr->_ensure_geometry();
+
+	Error err;
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::WRITE, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, err, "Cannot save MeshDataResource to file '" + p_path + "'.");
+
+	uint32_t flags = 0;
+
+	if (mdr->is_2d()) {
+		flags |= MDRES_FLAG_2D;
+	}
+
+#ifdef REAL_T_IS_DOUBLE
+	flags |= MDRES_FLAG_REAL_T_IS_DOUBLE;
+#endif
+
+	uint32_t mask = 0;
+
+	if (mdr->get_vertex_count() > 0) {
+		mask |= 1 << Mesh::ARRAY_VERTEX;
+	}
+
+	if (mdr->_normals.size() > 0 || mdr->_normals_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_NORMAL;
+	}
+
+	if (mdr->_tangents.size() > 0 || mdr->_tangents_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_TANGENT;
+	}
+
+	if (mdr->_colors.size() > 0 || mdr->_colors_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_COLOR;
+	}
+
+	if (mdr->_uvs.size() > 0 || mdr->_uvs_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_TEX_UV;
+	}
+
+	if (mdr->_uv2s.size() > 0 || mdr->_uv2s_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_TEX_UV2;
+	}
+
+	if (mdr->_bones.size() > 0 || mdr->_bones_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_BONES;
+	}
+
+	if (mdr->_weights.size() > 0 || mdr->_weights_q.size() > 0) {
+		mask |= 1 << Mesh::ARRAY_WEIGHTS;
+	}
+
+	if (mdr->get_index_count() > 0) {
+		mask |= 1 << Mesh::ARRAY_INDEX;
+	}
+
+	bool is_16_bit = mdr->_index_format == MeshDataResource::INDEX_FORMAT_16_BIT;
+
+	f->store_buffer(reinterpret_cast<const uint8_t *>("MDRS"), 4);
+	f->store_32(MDRES_FORMAT_VERSION);
+	f->store_32(flags);
+	f->store_32(mask);
+	f->store_32(mdr->get_vertex_count());
+	f->store_32(mdr->_index_format);
+	f->store_32(mdr->get_index_count());
+	f->store_32(is_16_bit ? mdr->_seams_16.size() : mdr->_seams_32.size());
+
+	f->store_float(mdr->_aabb.position.x);
+	f->store_float(mdr->_aabb.position.y);
+	f->store_float(mdr->_aabb.position.z);
+	f->store_float(mdr->_aabb.size.x);
+	f->store_float(mdr->_aabb.size.y);
+	f->store_float(mdr->_aabb.size.z);
+
+	f->store_32(mdr->_quantization);
+	f->store_32(mdr->_get_stored_quantization());
+	_store_rect2(f, mdr->_uvs_range);
+	_store_rect2(f, mdr->_uv2s_range);
+
+	f->store_32(mdr->_lods.size());
+	f->store_32(mdr->_clusters.size());
+
+	f->store_32(mdr->_collision_shapes.size());
+
+	//Payload offset, patched once the collision shape table is written
+	uint64_t payload_offset_pos = f->get_position();
+	f->store_64(0);
+
+	for (int i = 0; i < mdr->_collision_shapes.size(); ++i) {
+		const MeshDataResource::MDRData &d = mdr->_collision_shapes[i];
+
+		_store_transform(f, d.transform);
+
+		err = _store_sub_resource(f, d.shape);
+		ERR_FAIL_COND_V(err != OK, err);
+	}
+
+	_store_padding(f);
+
+	uint64_t payload_offset = f->get_position();
+
+	if (mdr->is_2d()) {
+		_store_blob(f, mdr->_vertices_2d);
+	} else {
+		_store_blob(f, mdr->_vertices);
+	}
+
+	//Only one of the full and quantized buffers is ever filled, so this is the order the loader expects
+	_store_blob(f, mdr->_normals);
+	_store_blob(f, mdr->_normals_q);
+	_store_blob(f, mdr->_tangents);
+	_store_blob(f, mdr->_tangents_q);
+	_store_blob(f, mdr->_colors);
+	_store_blob(f, mdr->_colors_q);
+	_store_blob(f, mdr->_uvs);
+	_store_blob(f, mdr->_uvs_q);
+	_store_blob(f, mdr->_uv2s);
+	_store_blob(f, mdr->_uv2s_q);
+	_store_blob(f, mdr->_bones);
+	_store_blob(f, mdr->_bones_q);
+	_store_blob(f, mdr->_weights);
+	_store_blob(f, mdr->_weights_q);
+
+	if (is_16_bit) {
+		_store_blob(f, mdr->_indices_16);
+		_store_blob(f, mdr->_seams_16);
+	} else {
+		_store_blob(f, mdr->_indices_32);
+		_store_blob(f, mdr->_seams_32);
+	}
+
+	for (int i = 0; i < mdr->_lods.size(); ++i) {
+		const MeshDataResource::MDRLod &lod = mdr->_lods[i];
+
+		f->store_float(lod.error);
+
+		if (is_16_bit) {
+			f->store_32(lod.indices_16.size());
+			_store_blob(f, lod.indices_16);
+		} else {
+			f->store_32(lod.indices_32.size());
+			_store_blob(f, lod.indices_32);
+		}
+	}
+
+	for (int i = 0; i < mdr->_clusters.size(); ++i) {
+		const MDRCluster &c = mdr->_clusters[i];
+
+		f->store_32(c.triangle_offset);
+		f->store_32(c.triangle_count);
+		f->store_float(c.center.x);
+		f->store_float(c.center.y);
+		f->store_float(c.center.z);
+		f->store_float(c.radius);
+		f->store_float(c.cone_axis.x);
+		f->store_float(c.cone_axis.y);
+		f->store_float(c.cone_axis.z);
+		f->store_float(c.cone_cutoff);
+	}
+
+	f->seek(payload_offset_pos);
+	f->store_64(payload_offset);
+
+	if (f->get_error() != OK && f->get_error() != ERR_FILE_EOF) {
+		return ERR_CANT_CREATE;
+	}
+
+	//The file now holds the exact same geometry, so it can be evicted and reloaded from here
+	mdr->_set_geometry_loaded(p_path);
+
+	if (p_flags & ResourceSaver::FLAG_CHANGE_PATH) {
+		mdr->set_path(p_path);
+	}
+
+	return OK;
+}
+
+bool ResourceFormatSaverMDRes::recognize(const Ref<Resource> &p_resource) const {
+	return Object::cast_to<MeshDataResource>(*p_resource) != nullptr || Object::cast_to<MeshDataResourceCollection>(*p_resource) != nullptr;
+}
+
+void ResourceFormatSaverMDRes::get_recognized_extensions(const Ref<Resource> &p_resource, List<String> *p_extensions) const {
+	if (recognize(p_resource)) {
+		p_extensions->push_back("mdres");
+	}
+}
+
+//The meshes are referenced by their paths, the ones without a file of their own are embedded
+Error ResourceFormatSaverMDRes::_save_collection(const Ref<MeshDataResourceCollection> &p_coll, const String &p_path, uint32_t p_flags) {
+	Error err;
+	Ref<FileAccess> f = FileAccess::open(p_path, FileAccess::WRITE, &err);
+
+	ERR_FAIL_COND_V_MSG(err != OK, err, "Cannot save MeshDataResourceCollection to file '" + p_path + "'.");
+
+	Vector<Variant> mdrs = p_coll->get_mdrs();
+
+	f->store_buffer(reinterpret_cast<const uint8_t *>("MDRC"), 4);
+	f->store_32(MDRES_COLLECTION_FORMAT_VERSION);
+	f->store_32(mdrs.size());
+
+	for (int i = 0; i < mdrs.size(); ++i) {
+		Ref<Resource> mdr = mdrs[i];
+
+		err = _store_sub_resource(f, mdr);
+		ERR_FAIL_COND_V(err != OK, err);
+	}
+
+	if (f->get_error() != OK && f->get_error() != ERR_FILE_EOF) {
+		return ERR_CANT_CREATE;
+	}
+
+	if (p_flags & ResourceSaver::FLAG_CHANGE_PATH) {
+		p_coll->set_path(p_path);
+	}
+
+	return OK;
+}
+
+ResourceFormatSaverMDRes::ResourceFormatSaverMDRes() {
+}
+
+ResourceFormatSaverMDRes::~ResourceFormatSaverMDRes() {
+}
@@ -0,0 +1,122 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RESOURCE_FORMAT_MDRES_H
+#define RESOURCE_FORMAT_MDRES_H
+
+#include "core/io/file_access.h"
+#include "core/io/resource_loader.h"
+#include "core/io/resource_saver.h"
+
+class MeshDataResource;
+class MeshDataResourceCollection;
+
+// .mdres layout (little endian, every blob starts on a 16 byte boundary):
+//
+// "MDRS", version, flags, attribute mask, vertex count, index format, index count, seam count,
+// aabb (6 floats), quantization, stored quantization, uv range, uv2 range (4 floats each, version 2+),
+// lod count (version 3+), cluster count (version 4+), collision shape count, payload offset (uint64),
+// collision shape table,
+// raw attribute blobs in Mesh::ArrayType order, then indices and seams,
+// then every lod as error (float), index count, indices,
+// then every cluster as triangle offset, triangle count, center, radius, cone axis, cone cutoff.
+//
+// MeshDataResourceCollections are saved as "MDRC", version, mesh count, then every mesh as a path,
+// or embedded if it doesn't have a file of its own, the same way as the collision shapes.
+//
+// The blobs are stored exactly as MeshDataResource holds them in memory (quantized attributes in their
+// compact form), so loading them is a straight read into the destination buffers. Big endian hosts
+// swap every element on save and load.
+
+class ResourceFormatLoaderMDRes : public ResourceFormatLoader {
+	GDCLASS(ResourceFormatLoaderMDRes, ResourceFormatLoader);
+
+public:
+	virtual Ref<Resource> load(const String &p_path, const String &p_original_path = "", Error *r_error = nullptr, bool p_use_sub_threads = false, float *r_progress = nullptr, CacheMode p_cache_mode = CACHE_MODE_REUSE) override;
+	virtual void get_recognized_extensions(List<String> *p_extensions) const override;
+	virtual bool handles_type(const String &p_type) const override;
+	virtual String get_resource_type(const String &p_path) const override;
+	virtual void get_dependencies(const String &p_path, List<String> *p_dependencies, bool p_add_types = false) override;
+	virtual Error rename_dependencies(const String &p_path, const HashMap<String, String> &p_map) override;
+
+	struct MDResHeader {
+		uint32_t flags;
+		uint32_t attribute_mask;
+		uint32_t vertex_count;
+		uint32_t index_format;
+		uint32_t index_count;
+		uint32_t seam_count;
+		uint32_t collision_shape_count;
+		uint64_t payload_offset;
+		AABB aabb;
+		uint32_t quantization;
+		uint32_t stored_quantization;
+		uint32_t lod_count;
+		uint32_t cluster_count;
+		Rect2 uvs_range;
+		Rect2 uv2s_range;
+
+		MDResHeader() {
+			flags = 0;
+			attribute_mask = 0;
+			vertex_count = 0;
+			index_format = 0;
+			index_count = 0;
+			seam_count = 0;
+			collision_shape_count = 0;
+			payload_offset = 0;
+			quantization = 0;
+			stored_quantization = 0;
+			lod_count = 0;
+			cluster_count = 0;
+		}
+	};
+
+	//Used by MeshDataResources that were loaded without their geometry
+	static Error load_geometry(const String &p_path, MeshDataResource *mdr);
+
+	ResourceFormatLoaderMDRes();
+	~ResourceFormatLoaderMDRes();
+
+protected:
+	static Error _load_header(Ref<FileAccess> f, const String &p_path, MDResHeader &r_header);
+	static Error _load_collision_shapes(Ref<FileAccess> f, MeshDataResource *mdr, const MDResHeader &p_header);
+	static Ref<Resource> _load_collection(Ref<FileAccess> f, const String &p_path, Error &r_error);
+	static Error _load_payload(Ref<FileAccess> f, MeshDataResource *mdr, const MDResHeader &p_header);
+};
+
+class ResourceFormatSaverMDRes : public ResourceFormatSaver {
+	GDCLASS(ResourceFormatSaverMDRes, ResourceFormatSaver);
+
+public:
+	virtual Error save(const Ref<Resource> &p_resource, const String &p_path, uint32_t p_flags = 0) override;
+	virtual bool recognize(const Ref<Resource> &p_resource) const override;
+	virtual void get_recognized_extensions(const Ref<Resource> &p_resource, List<String> *p_extensions) const override;
+
+	ResourceFormatSaverMDRes();
+	~ResourceFormatSaverMDRes();
+
+protected:
+	Error _save_collection(const Ref<MeshDataResourceCollection> &p_coll, const String &p_path, uint32_t p_flags);
+};
+
+#endif
@@ -22,8 +22,17 @@ SOFTWARE.
 
 #include "mesh_data_resource.h"
 
+#include "core/os/thread.h"
 #include "core/version.h"
 
+#include "io/resource_format_mdres.h"
+#include "servers/rendering_server.h"
+#include "utils/mdr_bounds.h"
+#include "utils/mdr_mesh_optimizer.h"
+#include "utils/mdr_mesh_uploader.h"
+#include "utils/mdr_quantization.h"
+#include "utils/mdr_simplifier.h"
+
 #if VERSION_MAJOR >= 4
 #include "core/variant/variant.h"
 
@@ -39,19 +48,215 @@ SOFTWARE.
 #define PoolVector2Array PackedVector2Array
 
 const String MeshDataResource::BINDING_STRING_COLLIDER_TYPE = "None,Trimesh Collision Shape,Single Convex Collision Shape,Multiple Convex Collision Shapes,Approximated Box,Approximated Capsule,Approximated Cylinder,Approximated Sphere";
+const String MeshDataResource::BINDING_STRING_QUANTIZATION_FLAGS = "Octahedral Normals And Tangents,Half Float UVs,Unorm16 UVs,Unorm8 Weights,Unorm8 Colors,Uint8 Bones";
 
 Array MeshDataResource::get_array() {
-	return _arrays;
+	return get_array_const();
 }
 void MeshDataResource::set_array(const Array &p_arrays) {
-	_arrays = p_arrays;
+	_set_arrays(p_arrays);
 
 	recompute_aabb();
+	_quantize();
 
-	emit_changed();
+	_geometry_changed();
 }
 Array MeshDataResource::get_array_const() const {
-	return _arrays;
+	_ensure_geometry();
+
+	Array arr;
+
+	if (_vertices.size() == 0 && _vertices_2d.size() == 0) {
+		return arr;
+	}
+
+	//Only builds a view, Vectors are copy on write, so no vertex data gets copied here (except for decoding quantized attributes)
+	arr.resize(Mesh::ARRAY_MAX);
+
+	if (_vertices_2d.size() > 0) {
+		arr[Mesh::ARRAY_VERTEX] = _vertices_2d;
+	} else {
+		arr[Mesh::ARRAY_VERTEX] = _vertices;
+	}
+
+	if (_normals.size() > 0 || _normals_q.size() > 0) {
+		arr[Mesh::ARRAY_NORMAL] = get_normals();
+	}
+
+	if (_tangents.size() > 0 || _tangents_q.size() > 0) {
+		arr[Mesh::ARRAY_TANGENT] = get_tangents();
+	}
+
+	if (_colors.size() > 0 || _colors_q.size() > 0) {
+		arr[Mesh::ARRAY_COLOR] = get_colors();
+	}
+
+	if (_uvs.size() > 0 || _uvs_q.size() > 0) {
+		arr[Mesh::ARRAY_TEX_UV] = get_uvs();
+	}
+
+	if (_uv2s.size() > 0 || _uv2s_q.size() > 0) {
+		arr[Mesh::ARRAY_TEX_UV2] = get_uv2s();
+	}
+
+	if (_bones.size() > 0 || _bones_q.size() > 0) {
+		arr[Mesh::ARRAY_BONES] = get_bones();
+	}
+
+	if (_weights.size() > 0 || _weights_q.size() > 0) {
+		arr[Mesh::ARRAY_WEIGHTS] = get_weights();
+	}
+
+	if (get_index_count() > 0) {
+		arr[Mesh::ARRAY_INDEX] = get_indices();
+	}
+
+	return arr;
+}
+
+int MeshDataResource::get_vertex_count() const {
+	if (!_geometry_loaded.is_set()) {
+		return _unloaded_vertex_count;
+	}
+
+	if (_vertices_2d.size() > 0) {
+		return _vertices_2d.size();
+	}
+
+	return _vertices.size();
+}
+bool MeshDataResource::is_2d() const {
+	_ensure_geometry();
+
+	return _vertices_2d.size() > 0;
+}
+
+const Vector<Vector3> &MeshDataResource::get_vertices() const {
+	_ensure_geometry();
+
+	return _vertices;
+}
+const Vector<Vector2> &MeshDataResource::get_vertices_2d() const {
+	_ensure_geometry();
+
+	return _vertices_2d;
+}
+Vector<Vector3> MeshDataResource::get_normals() const {
+	_ensure_geometry();
+
+	if (_normals_q.size() > 0) {
+		return MDRQuantization::decode_normals_octahedral(_normals_q);
+	}
+
+	return _normals;
+}
+Vector<float> MeshDataResource::get_tangents() const {
+	_ensure_geometry();
+
+	if (_tangents_q.size() > 0) {
+		return MDRQuantization::decode_tangents_octahedral(_tangents_q);
+	}
+
+	return _tangents;
+}
+Vector<Color> MeshDataResource::get_colors() const {
+	_ensure_geometry();
+
+	if (_colors_q.size() > 0) {
+		return MDRQuantization::decode_colors_unorm8(_colors_q);
+	}
+
+	return _colors;
+}
+Vector<Vector2> MeshDataResource::get_uvs() const {
+	_ensure_geometry();
+
+	if (_uvs_q.size() > 0) {
+		if (_quantization & QUANTIZATION_UVS_UNORM16) {
+			return MDRQuantization::decode_unorm16_2(_uvs_q, _uvs_range);
+		}
+
+		return MDRQuantization::decode_half2(_uvs_q);
+	}
+
+	return _uvs;
+}
+Vector<Vector2> MeshDataResource::get_uv2s() const {
+	_ensure_geometry();
+
+	if (_uv2s_q.size() > 0) {
+		if (_quantization & QUANTIZATION_UVS_UNORM16) {
+			return MDRQuantization::decode_unorm16_2(_uv2s_q, _uv2s_range);
+		}
+
+		return MDRQuantization::decode_half2(_uv2s_q);
+	}
+
+	return _uv2s;
+}
+Vector<int> MeshDataResource::get_bones() const {
+	_ensure_geometry();
+
+	if (_bones_q.size() > 0) {
+		return MDRQuantization::decode_bones_uint8(_bones_q);
+	}
+
+	return _bones;
+}
+Vector<float> MeshDataResource::get_weights() const {
+	_ensure_geometry();
+
+	if (_weights_q.size() > 0) {
+		return MDRQuantization::decode_weights_unorm8(_weights_q);
+	}
+
+	return _weights;
+}
+
+const Vector3 *MeshDataResource::get_vertices_ptr() const {
+	_ensure_geometry();
+
+	return _vertices.ptr();
+}
+
+MeshDataResource::IndexFormat MeshDataResource::get_index_format() const {
+	return _index_format;
+}
+int MeshDataResource::get_index_count() const {
+	if (!_geometry_loaded.is_set()) {
+		return _unloaded_index_count;
+	}
+
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		return _indices_16.size();
+	}
+
+	return _indices_32.size();
+}
+const Vector<uint16_t> &MeshDataResource::get_indices_16() const {
+	_ensure_geometry();
+
+	return _indices_16;
+}
+const Vector<uint32_t> &MeshDataResource::get_indices_32() const {
+	_ensure_geometry();
+
+	return _indices_32;
+}
+Vector<int> MeshDataResource::get_indices() const {
+	_ensure_geometry();
+
+	Vector<int> indices;
+
+	int count = get_index_count();
+	indices.resize(count);
+	int *w = indices.ptrw();
+
+	for (int i = 0; i < count; ++i) {
+		w[i] = get_index(i);
+	}
+
+	return indices;
 }
 
 AABB MeshDataResource::get_aabb() const {
@@ -117,13 +322,33 @@ void MeshDataResource::set_collision_shapes(const Vector<Variant> &p_arrays) {
 }
 
 PoolIntArray MeshDataResource::get_seams() {
-	return _seams;
+	_ensure_geometry();
+
+	PoolIntArray seams;
+
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		seams.resize(_seams_16.size());
+
+		for (int i = 0; i < _seams_16.size(); ++i) {
+			seams.set(i, _seams_16[i]);
+		}
+	} else {
+		seams.resize(_seams_32.size());
+
+		for (int i = 0; i < _seams_32.size(); ++i) {
+			seams.set(i, _seams_32[i]);
+		}
+	}
+
+	return seams;
 }
 
 void MeshDataResource::set_seams(const PoolIntArray &array) {
-	_seams = array;
+	_ensure_geometry();
 
-	emit_changed();
+	_set_seams(array);
+
+	_geometry_changed();
 }
 
 void MeshDataResource::append_arrays(const Array &p_arrays) {
@@ -131,248 +356,1683 @@ void MeshDataResource::append_arrays(const Array &p_arrays) {
 		return;
 	}
 
-	if (_arrays.size() != Mesh::ARRAY_MAX) {
-		_arrays = p_arrays;
+	_ensure_geometry();
+
+	if (get_vertex_count() == 0) {
+		_set_arrays(p_arrays);
+		recompute_aabb();
+		_quantize();
+		_geometry_changed();
 		return;
 	}
 
-	PoolVector3Array vertices = _arrays[Mesh::ARRAY_VERTEX];
+	int ovc = get_vertex_count();
+	uint32_t staged = _get_quantized_format();
+
+	if (is_2d()) {
+		PoolVector2Array merge_vertices = p_arrays[Mesh::ARRAY_VERTEX];
+		_vertices_2d.append_array(merge_vertices);
+	} else {
+		PoolVector3Array merge_vertices = p_arrays[Mesh::ARRAY_VERTEX];
+		_vertices.append_array(merge_vertices);
+	}
+
+	int merge_vertex_count = get_vertex_count() - ovc;
 
-	if (vertices.size() == 0) {
-		_arrays = p_arrays;
+	if (merge_vertex_count == 0) {
 		return;
 	}
 
-	PoolVector3Array normals = _arrays[Mesh::ARRAY_NORMAL];
-	PoolRealArray tangents = _arrays[Mesh::ARRAY_TANGENT];
-	PoolColorArray colors = _arrays[Mesh::ARRAY_COLOR];
-	PoolVector2Array uv = _arrays[Mesh::ARRAY_TEX_UV];
-	PoolVector2Array uv2 = _arrays[Mesh::ARRAY_TEX_UV2];
-	PoolRealArray bones = _arrays[Mesh::ARRAY_BONES];
-	PoolRealArray weights = _arrays[Mesh::ARRAY_WEIGHTS];
-	PoolIntArray indices = _arrays[Mesh::ARRAY_INDEX];
-
-	PoolVector3Array merge_vertices = p_arrays[Mesh::ARRAY_VERTEX];
-	PoolVector3Array merge_normals = p_arrays[Mesh::ARRAY_NORMAL];
-	PoolRealArray merge_tangents = p_arrays[Mesh::ARRAY_TANGENT];
-	PoolColorArray merge_colors = p_arrays[Mesh::ARRAY_COLOR];
-	PoolVector2Array merge_uv = p_arrays[Mesh::ARRAY_TEX_UV];
-	PoolVector2Array merge_uv2 = p_arrays[Mesh::ARRAY_TEX_UV2];
-	PoolRealArray merge_bones = p_arrays[Mesh::ARRAY_BONES];
-	PoolRealArray merge_weights = p_arrays[Mesh::ARRAY_WEIGHTS];
-	PoolIntArray merge_indices = p_arrays[Mesh::ARRAY_INDEX];
-
-	//merge
-
-	int ovc = vertices.size();
-	vertices.append_array(merge_vertices);
-
-	if (_arrays[Mesh::ARRAY_NORMAL] != Variant()) {
-		if (merge_vertices.size() != merge_normals.size()) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				normals.append(Vector3());
-			}
-		} else {
-			normals.append_array(merge_normals);
-		}
+	//The lods and clusters wouldn't contain the appended triangles
+	_lods.clear();
+	_clusters.clear();
+
+	//merge, quantized attributes only get the appended range staged in their float buffers
+
+	_append_attribute(_normals, Vector<Vector3>(p_arrays[Mesh::ARRAY_NORMAL]), merge_vertex_count, 1, staged & Mesh::ARRAY_FORMAT_NORMAL);
+	_append_attribute(_tangents, Vector<float>(p_arrays[Mesh::ARRAY_TANGENT]), merge_vertex_count, 4, staged & Mesh::ARRAY_FORMAT_TANGENT);
+	_append_attribute(_colors, Vector<Color>(p_arrays[Mesh::ARRAY_COLOR]), merge_vertex_count, 1, staged & Mesh::ARRAY_FORMAT_COLOR);
+	_append_attribute(_uvs, Vector<Vector2>(p_arrays[Mesh::ARRAY_TEX_UV]), merge_vertex_count, 1, staged & Mesh::ARRAY_FORMAT_TEX_UV);
+	_append_attribute(_uv2s, Vector<Vector2>(p_arrays[Mesh::ARRAY_TEX_UV2]), merge_vertex_count, 1, staged & Mesh::ARRAY_FORMAT_TEX_UV2);
+	_append_attribute(_bones, Vector<int>(p_arrays[Mesh::ARRAY_BONES]), merge_vertex_count, 4, staged & Mesh::ARRAY_FORMAT_BONES);
+	_append_attribute(_weights, Vector<float>(p_arrays[Mesh::ARRAY_WEIGHTS]), merge_vertex_count, 4, staged & Mesh::ARRAY_FORMAT_WEIGHTS);
+
+	if (_index_format == INDEX_FORMAT_16_BIT && get_vertex_count() >= INDEX_FORMAT_16_BIT_MAX_VERTEX_COUNT) {
+		_widen_indices();
 	}
 
-	if (_arrays[Mesh::ARRAY_TANGENT] != Variant()) {
-		if (merge_vertices.size() != merge_tangents.size() * 4) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				merge_tangents.append(0);
-				merge_tangents.append(0);
-				merge_tangents.append(0);
-				merge_tangents.append(0);
+	_append_indices(p_arrays[Mesh::ARRAY_INDEX], ovc);
+
+	_expand_aabb(ovc, merge_vertex_count);
+	_encode_appended(staged);
+
+	_geometry_changed();
+}
+
+void MeshDataResource::append_arrays_bulk(const Array &p_arrays, const Array &p_transforms) {
+	ERR_FAIL_COND(p_transforms.size() != 0 && p_transforms.size() != p_arrays.size());
+
+	_ensure_geometry();
+
+	bool has_transforms = p_transforms.size() > 0;
+	bool format_set_up = false;
+	int start = 0;
+
+	if (get_vertex_count() == 0) {
+		//Same as append_arrays, the first usable array sets up the format
+		for (; start < p_arrays.size(); ++start) {
+			Array arr = p_arrays[start];
+
+			if (arr.size() == Mesh::ARRAY_MAX) {
+				_set_arrays(arr);
+
+				if (has_transforms) {
+					_transform_vertex_range(0, get_vertex_count(), p_transforms[start]);
+				}
+
+				format_set_up = true;
+				++start;
+				break;
 			}
-		} else {
-			tangents.append_array(merge_tangents);
 		}
-	}
 
-	if (_arrays[Mesh::ARRAY_COLOR] != Variant()) {
-		if (merge_vertices.size() != merge_colors.size()) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				colors.append(Color());
+		if (get_vertex_count() == 0) {
+			if (format_set_up) {
+				_geometry_changed();
 			}
-		} else {
-			colors.append_array(merge_colors);
+
+			return;
 		}
 	}
 
-	if (_arrays[Mesh::ARRAY_TEX_UV] != Variant()) {
-		if (merge_vertices.size() != merge_uv.size()) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				uv.append(Vector2());
-			}
-		} else {
-			uv.append_array(merge_uv);
+	bool is_2d_mesh = is_2d();
+	int ovc = get_vertex_count();
+	int oic = get_index_count();
+
+	//Size everything first, so every buffer only gets allocated once
+	int total_vertex_count = ovc;
+	int total_index_count = oic;
+
+	for (int i = start; i < p_arrays.size(); ++i) {
+		Array arr = p_arrays[i];
+
+		if (arr.size() != Mesh::ARRAY_MAX) {
+			continue;
 		}
-	}
 
-	if (_arrays[Mesh::ARRAY_TEX_UV2] != Variant()) {
-		if (merge_vertices.size() != merge_uv2.size()) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				uv2.append(Vector2());
-			}
+		int vc;
+
+		if (is_2d_mesh) {
+			vc = Vector<Vector2>(arr[Mesh::ARRAY_VERTEX]).size();
 		} else {
-			uv2.append_array(merge_uv2);
+			vc = Vector<Vector3>(arr[Mesh::ARRAY_VERTEX]).size();
 		}
-	}
 
-	if (_arrays[Mesh::ARRAY_BONES] != Variant()) {
-		if (merge_vertices.size() != merge_bones.size() * 4) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				bones.append(0);
-				bones.append(0);
-				bones.append(0);
-				bones.append(0);
-			}
-		} else {
-			bones.append_array(merge_bones);
+		if (vc == 0) {
+			continue;
 		}
+
+		total_vertex_count += vc;
+		total_index_count += Vector<int>(arr[Mesh::ARRAY_INDEX]).size();
 	}
 
-	if (_arrays[Mesh::ARRAY_WEIGHTS] != Variant()) {
-		if (merge_vertices.size() != merge_weights.size() * 4) {
-			for (int i = 0; i < merge_vertices.size(); ++i) {
-				weights.append(0);
-				weights.append(0);
-				weights.append(0);
-				weights.append(0);
-			}
-		} else {
-			weights.append_array(merge_weights);
+	if (total_vertex_count == ovc) {
+		if (format_set_up) {
+			recompute_aabb();
+			_quantize();
+			_geometry_changed();
 		}
+
+		return;
 	}
 
-	for (int i = 0; i < merge_indices.size(); ++i) {
-		merge_indices.set(i, merge_indices[i] + ovc);
+	//The lods and clusters wouldn't contain the appended triangles
+	_lods.clear();
+	_clusters.clear();
+
+	if (_index_format == INDEX_FORMAT_16_BIT && total_vertex_count >= INDEX_FORMAT_16_BIT_MAX_VERTEX_COUNT) {
+		_widen_indices();
 	}
 
-	indices.append_array(merge_indices);
+	if (is_2d_mesh) {
+		_vertices_2d.resize(total_vertex_count);
+	} else {
+		_vertices.resize(total_vertex_count);
+	}
 
-	//write back
+	//Quantized attributes only get the appended range staged in their float buffers, these start at ovc
+	uint32_t staged = _get_quantized_format();
+
+	//Attributes that the current mesh doesn't have are dropped, just like with append_arrays
+	bool has_normals = _normals.size() > 0 || (staged & Mesh::ARRAY_FORMAT_NORMAL);
+	bool has_tangents = _tangents.size() > 0 || (staged & Mesh::ARRAY_FORMAT_TANGENT);
+	bool has_colors = _colors.size() > 0 || (staged & Mesh::ARRAY_FORMAT_COLOR);
+	bool has_uvs = _uvs.size() > 0 || (staged & Mesh::ARRAY_FORMAT_TEX_UV);
+	bool has_uv2s = _uv2s.size() > 0 || (staged & Mesh::ARRAY_FORMAT_TEX_UV2);
+	bool has_bones = _bones.size() > 0 || (staged & Mesh::ARRAY_FORMAT_BONES);
+	bool has_weights = _weights.size() > 0 || (staged & Mesh::ARRAY_FORMAT_WEIGHTS);
+
+	//Normals and tangents are quantized together
+	int normals_from = (staged & (Mesh::ARRAY_FORMAT_NORMAL | Mesh::ARRAY_FORMAT_TANGENT)) ? ovc : 0;
+	int colors_from = (staged & Mesh::ARRAY_FORMAT_COLOR) ? ovc : 0;
+	int uvs_from = (staged & Mesh::ARRAY_FORMAT_TEX_UV) ? ovc : 0;
+	int uv2s_from = (staged & Mesh::ARRAY_FORMAT_TEX_UV2) ? ovc : 0;
+	int bones_from = (staged & Mesh::ARRAY_FORMAT_BONES) ? ovc : 0;
+	int weights_from = (staged & Mesh::ARRAY_FORMAT_WEIGHTS) ? ovc : 0;
+
+	if (has_normals) {
+		_normals.resize(total_vertex_count - normals_from);
+	}
 
-	_arrays[Mesh::ARRAY_VERTEX] = vertices;
+	if (has_tangents) {
+		_tangents.resize((total_vertex_count - normals_from) * 4);
+	}
 
-	if (_arrays[Mesh::ARRAY_NORMAL] != Variant()) {
-		_arrays[Mesh::ARRAY_NORMAL] = normals;
+	if (has_colors) {
+		_colors.resize(total_vertex_count - colors_from);
 	}
 
-	if (_arrays[Mesh::ARRAY_TANGENT] != Variant()) {
-		_arrays[Mesh::ARRAY_TANGENT] = tangents;
+	if (has_uvs) {
+		_uvs.resize(total_vertex_count - uvs_from);
 	}
 
-	if (_arrays[Mesh::ARRAY_COLOR] != Variant()) {
-		_arrays[Mesh::ARRAY_COLOR] = colors;
+	if (has_uv2s) {
+		_uv2s.resize(total_vertex_count - uv2s_from);
 	}
 
-	if (_arrays[Mesh::ARRAY_TEX_UV] != Variant()) {
-		_arrays[Mesh::ARRAY_TEX_UV] = uv;
+	if (has_bones) {
+		_bones.resize((total_vertex_count - bones_from) * 4);
 	}
 
-	if (_arrays[Mesh::ARRAY_TEX_UV2] != Variant()) {
-		_arrays[Mesh::ARRAY_TEX_UV2] = uv2;
+	if (has_weights) {
+		_weights.resize((total_vertex_count - weights_from) * 4);
 	}
 
-	if (_arrays[Mesh::ARRAY_BONES] != Variant()) {
-		_arrays[Mesh::ARRAY_BONES] = bones;
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		_indices_16.resize(total_index_count);
+	} else {
+		_indices_32.resize(total_index_count);
 	}
 
-	if (_arrays[Mesh::ARRAY_WEIGHTS] != Variant()) {
-		_arrays[Mesh::ARRAY_WEIGHTS] = weights;
+	int vertex_offset = ovc;
+	int index_offset = oic;
+
+	for (int i = start; i < p_arrays.size(); ++i) {
+		Array arr = p_arrays[i];
+
+		if (arr.size() != Mesh::ARRAY_MAX) {
+			continue;
+		}
+
+		int vc;
+
+		if (is_2d_mesh) {
+			Vector<Vector2> merge_vertices = arr[Mesh::ARRAY_VERTEX];
+			vc = merge_vertices.size();
+			_copy_attribute(_vertices_2d.ptrw() + vertex_offset, merge_vertices, vc);
+		} else {
+			Vector<Vector3> merge_vertices = arr[Mesh::ARRAY_VERTEX];
+			vc = merge_vertices.size();
+			_copy_attribute(_vertices.ptrw() + vertex_offset, merge_vertices, vc);
+		}
+
+		if (vc == 0) {
+			continue;
+		}
+
+		if (has_normals) {
+			_copy_attribute(_normals.ptrw() + vertex_offset - normals_from, Vector<Vector3>(arr[Mesh::ARRAY_NORMAL]), vc);
+		}
+
+		if (has_tangents) {
+			_copy_attribute(_tangents.ptrw() + (vertex_offset - normals_from) * 4, Vector<float>(arr[Mesh::ARRAY_TANGENT]), vc * 4);
+		}
+
+		if (has_colors) {
+			_copy_attribute(_colors.ptrw() + vertex_offset - colors_from, Vector<Color>(arr[Mesh::ARRAY_COLOR]), vc);
+		}
+
+		if (has_uvs) {
+			_copy_attribute(_uvs.ptrw() + vertex_offset - uvs_from, Vector<Vector2>(arr[Mesh::ARRAY_TEX_UV]), vc);
+		}
+
+		if (has_uv2s) {
+			_copy_attribute(_uv2s.ptrw() + vertex_offset - uv2s_from, Vector<Vector2>(arr[Mesh::ARRAY_TEX_UV2]), vc);
+		}
+
+		if (has_bones) {
+			_copy_attribute(_bones.ptrw() + (vertex_offset - bones_from) * 4, Vector<int>(arr[Mesh::ARRAY_BONES]), vc * 4);
+		}
+
+		if (has_weights) {
+			_copy_attribute(_weights.ptrw() + (vertex_offset - weights_from) * 4, Vector<float>(arr[Mesh::ARRAY_WEIGHTS]), vc * 4);
+		}
+
+		Vector<int> merge_indices = arr[Mesh::ARRAY_INDEX];
+		const int *ir = merge_indices.ptr();
+		int ic = merge_indices.size();
+
+		if (_index_format == INDEX_FORMAT_16_BIT) {
+			uint16_t *iw = _indices_16.ptrw() + index_offset;
+
+			for (int j = 0; j < ic; ++j) {
+				iw[j] = ir[j] + vertex_offset;
+			}
+		} else {
+			uint32_t *iw = _indices_32.ptrw() + index_offset;
+
+			for (int j = 0; j < ic; ++j) {
+				iw[j] = ir[j] + vertex_offset;
+			}
+		}
+
+		if (has_transforms) {
+			_transform_vertex_range(vertex_offset, vc, p_transforms[i], normals_from);
+		}
+
+		vertex_offset += vc;
+		index_offset += ic;
 	}
 
-	_arrays[Mesh::ARRAY_INDEX] = indices;
+	if (format_set_up) {
+		recompute_aabb();
+		_quantize();
+	} else {
+		_expand_aabb(ovc, total_vertex_count - ovc);
+		_encode_appended(staged);
+	}
 
-	emit_changed();
+	_geometry_changed();
 }
 
 void MeshDataResource::recompute_aabb() {
-	if (_arrays.size() == 0) {
+	_ensure_geometry();
+
+	if (_vertices_2d.size() > 0) {
+		_aabb = MDRBounds::compute_aabb_2d(_vertices_2d.ptr(), _vertices_2d.size());
 		return;
 	}
 
-	Variant arr = _arrays[Mesh::ARRAY_VERTEX];
-
-	PoolVector<Vector2> vertices_2d = arr;
+	if (_vertices.size() == 0) {
+		return;
+	}
 
-	if (vertices_2d.size() > 0) {
-		AABB aabb;
+	_aabb = MDRBounds::compute_aabb(_vertices.ptr(), _vertices.size());
+}
 
-#if VERSION_MAJOR < 4
-		PoolVector<Vector2>::Read r = vertices_2d.read();
-		const Vector2 *vtx = r.ptr();
-#else
-		const Vector2 *vtx = vertices_2d.ptr();
-#endif
-		int len = vertices_2d.size();
-		aabb.position = Vector3(vtx[0].x, vtx[0].y, 0);
+void MeshDataResource::optimize_vertex_cache() {
+	_ensure_geometry();
 
-		for (int i = 0; i < len; i++) {
-			aabb.expand_to(Vector3(vtx[i].x, vtx[i].y, 0));
-		}
+	int index_count = get_index_count();
 
-		_aabb = aabb;
+	if (index_count < 3) {
 		return;
 	}
 
-	PoolVector<Vector3> vertices = arr;
-	int len = vertices.size();
+	Vector<uint32_t> indices = _get_indices_widened();
+	MDRMeshOptimizer::optimize_vertex_cache(indices.ptrw(), index_count, get_vertex_count());
+	_store_indices(indices);
+	_clusters.clear();
+
+	_geometry_changed();
+}
+
+void MeshDataResource::optimize_vertex_fetch() {
+	_ensure_geometry();
 
-	if (len == 0) {
+	int vertex_count = get_vertex_count();
+	int index_count = get_index_count();
+
+	if (vertex_count == 0 || index_count == 0) {
 		return;
 	}
 
-#if VERSION_MAJOR < 4
-	PoolVector<Vector3>::Read r = vertices.read();
-	const Vector3 *vtx = r.ptr();
-#else
-	const Vector3 *vtx = vertices.ptr();
-#endif
+	Vector<uint32_t> indices = _get_indices_widened();
+	Vector<uint32_t> remap = MDRMeshOptimizer::get_vertex_fetch_remap(indices.ptr(), index_count, vertex_count);
+
+	ERR_FAIL_COND(remap.size() != vertex_count);
+
+	//Remapping happens on the decoded data
+	_dequantize();
+
+	_remap_attribute(_vertices, remap, 1);
+	_remap_attribute(_vertices_2d, remap, 1);
+	_remap_attribute(_normals, remap, 1);
+	_remap_attribute(_tangents, remap, 4);
+	_remap_attribute(_colors, remap, 1);
+	_remap_attribute(_uvs, remap, 1);
+	_remap_attribute(_uv2s, remap, 1);
+	_remap_attribute(_bones, remap, 4);
+	_remap_attribute(_weights, remap, 4);
+
+	const uint32_t *rr = remap.ptr();
+	uint32_t *iw = indices.ptrw();
 
-	AABB aabb;
-	for (int i = 0; i < len; i++) {
-		if (i == 0)
-			aabb.position = vtx[i];
-		else
-			aabb.expand_to(vtx[i]);
+	for (int i = 0; i < index_count; ++i) {
+		iw[i] = rr[iw[i]];
 	}
 
-	_aabb = aabb;
+	_store_indices(indices);
+	_remap_seams(remap);
+
+	for (int i = 0; i < _lods.size(); ++i) {
+		MDRLod &lod = _lods.write[i];
+
+		Vector<uint32_t> lod_indices = _get_lod_indices_widened(lod);
+		uint32_t *lw = lod_indices.ptrw();
+
+		for (int j = 0; j < lod_indices.size(); ++j) {
+			lw[j] = rr[lw[j]];
+		}
+
+		_store_lod_indices(lod, lod_indices);
+	}
+
+	_quantize();
+
+	_geometry_changed();
 }
 
-MeshDataResource::MeshDataResource() {
+void MeshDataResource::optimize_overdraw(const float p_threshold) {
+	_ensure_geometry();
+
+	ERR_FAIL_COND_MSG(is_2d(), "Overdraw optimization only works on 3D meshes!");
+
+	int index_count = get_index_count();
+
+	if (index_count < 3) {
+		return;
+	}
+
+	Vector<uint32_t> indices = _get_indices_widened();
+	MDRMeshOptimizer::optimize_overdraw(indices.ptrw(), index_count, _vertices.ptr(), _vertices.size(), p_threshold);
+	_store_indices(indices);
+	_clusters.clear();
+
+	_geometry_changed();
 }
 
-MeshDataResource::~MeshDataResource() {
-	_arrays.clear();
-	_collision_shapes.clear();
+float MeshDataResource::calculate_acmr(const int p_cache_size) const {
+	_ensure_geometry();
+
+	Vector<uint32_t> indices = _get_indices_widened();
+
+	return MDRMeshOptimizer::calculate_acmr(indices.ptr(), indices.size(), get_vertex_count(), p_cache_size);
 }
 
-void MeshDataResource::_bind_methods() {
-	ClassDB::bind_method(D_METHOD("get_array"), &MeshDataResource::get_array);
-	ClassDB::bind_method(D_METHOD("set_array", "array"), &MeshDataResource::set_array);
-	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "array"), "set_array", "get_array");
+int MeshDataResource::get_lod_count() const {
+	_ensure_geometry();
 
-	ClassDB::bind_method(D_METHOD("get_aabb"), &MeshDataResource::get_aabb);
-	ClassDB::bind_method(D_METHOD("set_aabb", "array"), &MeshDataResource::set_aabb);
-	ADD_PROPERTY(PropertyInfo(Variant::AABB, "aabb"), "set_aabb", "get_aabb");
+	return _lods.size();
+}
+float MeshDataResource::get_lod_error(const int p_index) const {
+	_ensure_geometry();
 
-	ClassDB::bind_method(D_METHOD("get_collision_shapes"), &MeshDataResource::get_collision_shapes);
-	ClassDB::bind_method(D_METHOD("set_collision_shapes", "array"), &MeshDataResource::set_collision_shapes);
-	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "collision_shapes"), "set_collision_shapes", "get_collision_shapes");
+	ERR_FAIL_INDEX_V(p_index, _lods.size(), 0);
 
-	ClassDB::bind_method(D_METHOD("get_seams"), &MeshDataResource::get_seams);
-	ClassDB::bind_method(D_METHOD("set_seams", "array"), &MeshDataResource::set_seams);
-	ADD_PROPERTY(PropertyInfo(Variant::POOL_INT_ARRAY, "seams"), "set_seams", "get_seams");
+	return _lods[p_index].error;
+}
+PoolIntArray MeshDataResource::get_lod_indices(const int p_index) const {
+	_ensure_geometry();
 
-	ClassDB::bind_method(D_METHOD("add_collision_shape", "shape"), &MeshDataResource::add_collision_shape);
-	ClassDB::bind_method(D_METHOD("get_collision_shape", "index"), &MeshDataResource::get_collision_shape);
-	ClassDB::bind_method(D_METHOD("get_collision_shape_count"), &MeshDataResource::get_collision_shape_count);
+	PoolIntArray indices;
 
-	ClassDB::bind_method(D_METHOD("append_arrays", "array"), &MeshDataResource::append_arrays);
+	ERR_FAIL_INDEX_V(p_index, _lods.size(), indices);
 
-	ClassDB::bind_method(D_METHOD("recompute_aabb"), &MeshDataResource::recompute_aabb);
+	Vector<uint32_t> lod_indices = _get_lod_indices_widened(_lods[p_index]);
+
+	indices.resize(lod_indices.size());
+	int *w = indices.ptrw();
+
+	for (int i = 0; i < lod_indices.size(); ++i) {
+		w[i] = lod_indices[i];
+	}
+
+	return indices;
+}
+void MeshDataResource::add_lod(const PoolIntArray &p_indices, const float p_error) {
+	_ensure_geometry();
+
+	MDRLod lod;
+
+	if (!_make_lod(p_indices, p_error, lod)) {
+		return;
+	}
+
+	_lods.push_back(lod);
+
+	_geometry_changed();
+}
+void MeshDataResource::clear_lods() {
+	_ensure_geometry();
+
+	_lods.clear();
+
+	_geometry_changed();
+}
+
+void MeshDataResource::generate_lods(const int p_max_lod_count, const float p_max_error) {
+	_ensure_geometry();
+
+	ERR_FAIL_COND_MSG(is_2d(), "Lods can only be generated for 3D meshes!");
+
+	_lods.clear();
+
+	int index_count = get_index_count();
+	Vector<uint32_t> indices = _get_indices_widened();
+
+	float max_error = p_max_error * _aabb.get_longest_axis_size();
+	float last_error = 0;
+	int last_index_count = index_count;
+
+	for (int i = 0; i < p_max_lod_count; ++i) {
+		int target_index_count = (index_count >> (i + 1)) / 3 * 3;
+
+		if (target_index_count < 3) {
+			break;
+		}
+
+		float error = 0;
+		Vector<uint32_t> lod_indices = MDRSimplifier::simplify(indices.ptr(), index_count, _vertices.ptr(), _vertices.size(), target_index_count, max_error, &error);
+
+		//Stop once the simplifier can't make meaningful progress within the error limit
+		if (lod_indices.size() == 0 || lod_indices.size() > last_index_count * 0.9) {
+			break;
+		}
+
+		MDRMeshOptimizer::optimize_vertex_cache(lod_indices.ptrw(), lod_indices.size(), _vertices.size());
+
+		MDRLod lod;
+		lod.error = MAX(error, last_error);
+		_store_lod_indices(lod, lod_indices);
+
+		_lods.push_back(lod);
+
+		last_error = lod.error;
+		last_index_count = lod_indices.size();
+	}
+
+	_geometry_changed();
+}
+
+Dictionary MeshDataResource::get_surface_lods() const {
+	_ensure_geometry();
+
+	Dictionary lods;
+	float last_key = 0;
+
+	for (int i = 0; i < _lods.size(); ++i) {
+		//The RenderingServer skips lods with 0 error
+		float key = MAX(_lods[i].error, static_cast<float>(CMP_EPSILON));
+
+		//Keys have to be strictly increasing, lods with the same error would overwrite each other
+		if (key <= last_key) {
+			key = last_key * (1 + static_cast<float>(CMP_EPSILON));
+		}
+
+		lods[key] = get_lod_indices(i);
+		last_key = key;
+	}
+
+	return lods;
+}
+
+Array MeshDataResource::get_lods() const {
+	_ensure_geometry();
+
+	Array lods;
+
+	for (int i = 0; i < _lods.size(); ++i) {
+		Array lod;
+		lod.push_back(_lods[i].error);
+		lod.push_back(get_lod_indices(i));
+
+		lods.push_back(lod);
+	}
+
+	return lods;
+}
+void MeshDataResource::set_lods(const Array &p_lods) {
+	_ensure_geometry();
+
+	_lods.clear();
+
+	//Filled directly, so changed only gets emitted once
+	for (int i = 0; i < p_lods.size(); ++i) {
+		Array lod = p_lods[i];
+
+		ERR_CONTINUE(lod.size() != 2);
+
+		MDRLod l;
+
+		if (_make_lod(lod[1], lod[0], l)) {
+			_lods.push_back(l);
+		}
+	}
+
+	_geometry_changed();
+}
+
+void MeshDataResource::build_clusters(const int p_max_vertices, const int p_max_triangles) {
+	_ensure_geometry();
+
+	ERR_FAIL_COND_MSG(is_2d(), "Clusters can only be built for 3D meshes!");
+
+	Vector<uint32_t> indices = _get_indices_widened();
+	_clusters = MDRClusterBuilder::build(indices.ptr(), indices.size(), _vertices.ptr(), _vertices.size(), p_max_vertices, p_max_triangles);
+
+	_geometry_changed();
+}
+void MeshDataResource::clear_clusters() {
+	_ensure_geometry();
+
+	_clusters.clear();
+
+	_geometry_changed();
+}
+int MeshDataResource::get_cluster_count() const {
+	_ensure_geometry();
+
+	return _clusters.size();
+}
+const Vector<MDRCluster> &MeshDataResource::get_clusters() const {
+	_ensure_geometry();
+
+	return _clusters;
+}
+
+PoolRealArray MeshDataResource::get_cluster_data() const {
+	_ensure_geometry();
+
+	//triangle count, center, radius, cone axis, cone cutoff. The offsets follow from the counts.
+	PoolRealArray data;
+	data.resize(_clusters.size() * 9);
+	float *w = data.ptrw();
+
+	for (int i = 0; i < _clusters.size(); ++i) {
+		const MDRCluster &c = _clusters[i];
+		float *cw = w + i * 9;
+
+		cw[0] = c.triangle_count;
+		cw[1] = c.center.x;
+		cw[2] = c.center.y;
+		cw[3] = c.center.z;
+		cw[4] = c.radius;
+		cw[5] = c.cone_axis.x;
+		cw[6] = c.cone_axis.y;
+		cw[7] = c.cone_axis.z;
+		cw[8] = c.cone_cutoff;
+	}
+
+	return data;
+}
+void MeshDataResource::set_cluster_data(const PoolRealArray &p_data) {
+	_ensure_geometry();
+
+	ERR_FAIL_COND(p_data.size() % 9 != 0);
+
+	Vector<MDRCluster> clusters;
+
+	const float *r = p_data.ptr();
+	uint32_t triangle_offset = 0;
+
+	for (int i = 0; i < p_data.size() / 9; ++i) {
+		const float *cr = r + i * 9;
+
+		MDRCluster c;
+		c.triangle_offset = triangle_offset;
+		c.triangle_count = cr[0];
+		c.center = Vector3(cr[1], cr[2], cr[3]);
+		c.radius = cr[4];
+		c.cone_axis = Vector3(cr[5], cr[6], cr[7]);
+		c.cone_cutoff = cr[8];
+
+		triangle_offset += c.triangle_count;
+
+		clusters.push_back(c);
+	}
+
+	ERR_FAIL_COND_MSG(static_cast<int>(triangle_offset) * 3 > get_index_count(), "Cluster data doesn't match the indices!");
+
+	_clusters = clusters;
+
+	_geometry_changed();
+}
+
+int MeshDataResource::get_quantization() const {
+	return _quantization;
+}
+void MeshDataResource::set_quantization(const int p_flags) {
+	if (_quantization == p_flags) {
+		return;
+	}
+
+	_ensure_geometry();
+
+	_dequantize();
+	_quantization = p_flags;
+	_quantize();
+
+	_geometry_changed();
+}
+
+Vector<Face3> MeshDataResource::get_faces() const {
+	if (unlikely(!_faces_built.is_set())) {
+		_build_faces();
+	}
+
+	return _faces;
+}
+
+RID MeshDataResource::acquire_mesh_rid() {
+	MutexLock lock(_mesh_rid_mutex);
+
+	if (_mesh_rid == RID()) {
+		_mesh_rid = RS::get_singleton()->mesh_create();
+		_mesh_rid_dirty = true;
+	}
+
+	++_mesh_rid_users;
+
+	if (_mesh_rid_dirty) {
+		_update_mesh_rid();
+	}
+
+	return _mesh_rid;
+}
+void MeshDataResource::release_mesh_rid() {
+	MutexLock lock(_mesh_rid_mutex);
+
+	ERR_FAIL_COND(_mesh_rid_users <= 0);
+
+	--_mesh_rid_users;
+
+	if (_mesh_rid_users == 0) {
+		RS::get_singleton()->free(_mesh_rid);
+		_mesh_rid = RID();
+	}
+}
+RID MeshDataResource::get_mesh_rid() {
+	MutexLock lock(_mesh_rid_mutex);
+
+	//Every user refreshes on changed, only the first one has to upload
+	if (_mesh_rid_dirty && _mesh_rid != RID()) {
+		_update_mesh_rid();
+	}
+
+	return _mesh_rid;
+}
+
+const MDRBVH &MeshDataResource::get_bvh() const {
+	if (unlikely(!_bvh_built.is_set())) {
+		_build_bvh();
+	}
+
+	return _bvh;
+}
+
+Dictionary MeshDataResource::intersect_ray(const Vector3 &p_from, const Vector3 &p_direction, const real_t p_max_distance) const {
+	ERR_FAIL_COND_V_MSG(is_2d(), Dictionary(), "Only 3D meshes can be queried!");
+
+	MDRBVH::Hit hit;
+
+	if (!get_bvh().intersect_ray(p_from, p_direction, p_max_distance, hit)) {
+		return Dictionary();
+	}
+
+	return _hit_to_dict(hit);
+}
+Dictionary MeshDataResource::intersect_segment(const Vector3 &p_from, const Vector3 &p_to) const {
+	ERR_FAIL_COND_V_MSG(is_2d(), Dictionary(), "Only 3D meshes can be queried!");
+
+	MDRBVH::Hit hit;
+
+	if (!get_bvh().intersect_segment(p_from, p_to, hit)) {
+		return Dictionary();
+	}
+
+	return _hit_to_dict(hit);
+}
+Dictionary MeshDataResource::get_closest_point(const Vector3 &p_point) const {
+	ERR_FAIL_COND_V_MSG(is_2d(), Dictionary(), "Only 3D meshes can be queried!");
+
+	MDRBVH::Hit hit;
+
+	if (!get_bvh().get_closest_point(p_point, hit)) {
+		return Dictionary();
+	}
+
+	return _hit_to_dict(hit);
+}
+
+int MeshDataResource::get_geometry_memory_usage() const {
+	_ensure_geometry();
+
+	int size = 0;
+
+	size += _vertices.size() * sizeof(Vector3);
+	size += _vertices_2d.size() * sizeof(Vector2);
+	size += _normals.size() * sizeof(Vector3);
+	size += _tangents.size() * sizeof(float);
+	size += _colors.size() * sizeof(Color);
+	size += _uvs.size() * sizeof(Vector2);
+	size += _uv2s.size() * sizeof(Vector2);
+	size += _bones.size() * sizeof(int);
+	size += _weights.size() * sizeof(float);
+
+	size += _normals_q.size() * sizeof(uint32_t);
+	size += _tangents_q.size() * sizeof(uint32_t);
+	size += _colors_q.size() * sizeof(uint8_t);
+	size += _uvs_q.size() * sizeof(uint16_t);
+	size += _uv2s_q.size() * sizeof(uint16_t);
+	size += _bones_q.size() * sizeof(uint8_t);
+	size += _weights_q.size() * sizeof(uint8_t);
+
+	size += _indices_16.size() * sizeof(uint16_t);
+	size += _indices_32.size() * sizeof(uint32_t);
+	size += _seams_16.size() * sizeof(uint16_t);
+	size += _seams_32.size() * sizeof(uint32_t);
+
+	for (int i = 0; i < _lods.size(); ++i) {
+		size += _lods[i].indices_16.size() * sizeof(uint16_t);
+		size += _lods[i].indices_32.size() * sizeof(uint32_t);
+	}
+
+	return size;
+}
+
+bool MeshDataResource::is_geometry_loaded() const {
+	return _geometry_loaded.is_set();
+}
+
+void MeshDataResource::unload_geometry() {
+	ERR_FAIL_COND_MSG(_geometry_path.is_empty(), "Only the geometry of MeshDataResources that match their .mdres file can be unloaded!");
+	ERR_FAIL_COND_MSG(!Thread::is_main_thread(), "The geometry of MeshDataResources can only be unloaded on the main thread!");
+
+	MutexLock lock(_geometry_mutex);
+
+	if (!_geometry_loaded.is_set()) {
+		return;
+	}
+
+	_unloaded_vertex_count = get_vertex_count();
+	_unloaded_index_count = get_index_count();
+
+	_clear_geometry();
+
+	_geometry_loaded.clear();
+}
+
+MeshDataResource::MeshDataResource() {
+	_index_format = INDEX_FORMAT_16_BIT;
+	_quantization = QUANTIZATION_NONE;
+
+	_geometry_loaded.set();
+	_unloaded_vertex_count = 0;
+	_unloaded_index_count = 0;
+
+	_mesh_rid_users = 0;
+	_mesh_rid_dirty = false;
+	_mesh_rid_version = 0;
+}
+
+MeshDataResource::~MeshDataResource() {
+	_collision_shapes.clear();
+
+	if (_mesh_rid != RID() && RS::get_singleton()) {
+		RS::get_singleton()->free(_mesh_rid);
+	}
+}
+
+void MeshDataResource::_set_arrays(const Array &p_arrays) {
+	//The vertex count might change the index format, so seams need to be re-stored
+	Vector<int> seams = get_seams();
+
+	_vertices.clear();
+	_vertices_2d.clear();
+	_normals.clear();
+	_tangents.clear();
+	_colors.clear();
+	_uvs.clear();
+	_uv2s.clear();
+	_bones.clear();
+	_weights.clear();
+	_indices_16.clear();
+	_indices_32.clear();
+	_lods.clear();
+	_clusters.clear();
+
+	_normals_q.clear();
+	_tangents_q.clear();
+	_colors_q.clear();
+	_uvs_q.clear();
+	_uv2s_q.clear();
+	_bones_q.clear();
+	_weights_q.clear();
+
+	if (p_arrays.size() != Mesh::ARRAY_MAX) {
+		_set_seams(seams);
+		return;
+	}
+
+	//Vectors are copy on write, so these are only refcount increments
+	if (p_arrays[Mesh::ARRAY_VERTEX].get_type() == Variant::PACKED_VECTOR2_ARRAY) {
+		_vertices_2d = p_arrays[Mesh::ARRAY_VERTEX];
+	} else {
+		_vertices = p_arrays[Mesh::ARRAY_VERTEX];
+	}
+
+	_normals = p_arrays[Mesh::ARRAY_NORMAL];
+	_tangents = p_arrays[Mesh::ARRAY_TANGENT];
+	_colors = p_arrays[Mesh::ARRAY_COLOR];
+	_uvs = p_arrays[Mesh::ARRAY_TEX_UV];
+	_uv2s = p_arrays[Mesh::ARRAY_TEX_UV2];
+	_bones = p_arrays[Mesh::ARRAY_BONES];
+	_weights = p_arrays[Mesh::ARRAY_WEIGHTS];
+
+	_set_indices(p_arrays[Mesh::ARRAY_INDEX]);
+	_set_seams(seams);
+}
+
+void MeshDataResource::_geometry_changed() {
+	//The geometry no longer matches the file it was loaded from, so it can't be evicted anymore
+	_geometry_path = String();
+
+	_clear_caches();
+
+	{
+		MutexLock lock(_mesh_rid_mutex);
+		_mesh_rid_dirty = true;
+		//Surfaces that are still being prepared from the old geometry get dropped
+		++_mesh_rid_version;
+	}
+
+	emit_changed();
+}
+
+void MeshDataResource::_update_mesh_rid() {
+	_mesh_rid_dirty = false;
+
+	if (get_vertex_count() == 0) {
+		RS::get_singleton()->mesh_clear(_mesh_rid);
+		return;
+	}
+
+	//The RenderingServer selects the lod based on the screen space error
+	Array arrays = get_array_const();
+	Dictionary lods = get_surface_lods();
+
+	if (MDRMeshUploader::queue(Ref<MeshDataResource>(this), arrays, lods, _mesh_rid_version)) {
+		return;
+	}
+
+	RS::get_singleton()->mesh_clear(_mesh_rid);
+	RS::get_singleton()->mesh_add_surface_from_arrays(_mesh_rid, RS::PRIMITIVE_TRIANGLES, arrays, Array(), lods);
+}
+
+bool MeshDataResource::_commit_mesh_surface(const uint64_t p_version, const RS::SurfaceData &p_surface) {
+	{
+		MutexLock lock(_mesh_rid_mutex);
+
+		//Released, or the geometry changed since the surface was prepared
+		if (_mesh_rid == RID() || p_version != _mesh_rid_version) {
+			return false;
+		}
+
+		RS::get_singleton()->mesh_clear(_mesh_rid);
+		RS::get_singleton()->mesh_add_surface(_mesh_rid, p_surface);
+	}
+
+	//Per instance surface materials set while the mesh had no surfaces got dropped, users have to set them again
+	emit_signal("mesh_rid_updated");
+
+	return true;
+}
+
+void MeshDataResource::_build_faces() const {
+	_ensure_geometry();
+
+	MutexLock lock(_cache_mutex);
+
+	if (_faces_built.is_set()) {
+		return;
+	}
+
+	_faces.clear();
+
+	if (!is_2d()) {
+		int ts = get_index_count() / 3;
+		_faces.resize(ts);
+
+		Face3 *w = _faces.ptrw();
+		const Vector3 *rv = _vertices.ptr();
+
+		for (int i = 0; i < ts; i++) {
+			int im3 = (i * 3);
+
+			for (int j = 0; j < 3; j++) {
+				w[i].vertex[j] = rv[get_index(im3 + j)];
+			}
+		}
+	}
+
+	_faces_built.set();
+}
+
+void MeshDataResource::_build_bvh() const {
+	_ensure_geometry();
+
+	MutexLock lock(_cache_mutex);
+
+	//An other thread could have built it while this one was waiting
+	if (_bvh_built.is_set()) {
+		return;
+	}
+
+	if (!is_2d()) {
+		Vector<uint32_t> indices = _get_indices_widened();
+		_bvh.build(indices.ptr(), indices.size(), _vertices.ptr(), _vertices.size());
+	}
+
+	_bvh_built.set();
+}
+
+void MeshDataResource::_clear_caches() {
+	MutexLock lock(_cache_mutex);
+
+	_faces.clear();
+	_faces_built.clear();
+	_bvh.clear();
+	_bvh_built.clear();
+}
+
+Dictionary MeshDataResource::_hit_to_dict(const MDRBVH::Hit &p_hit) {
+	Dictionary d;
+
+	d["position"] = p_hit.position;
+	d["normal"] = p_hit.normal;
+	d["face_index"] = p_hit.triangle;
+	d["distance"] = p_hit.distance;
+
+	return d;
+}
+
+void MeshDataResource::_quantize() {
+	if (_quantization & QUANTIZATION_NORMALS_OCTAHEDRAL) {
+		if (_normals.size() > 0) {
+			_normals_q = MDRQuantization::encode_normals_octahedral(_normals);
+			_normals.clear();
+		}
+
+		if (_tangents.size() > 0) {
+			_tangents_q = MDRQuantization::encode_tangents_octahedral(_tangents);
+			_tangents.clear();
+		}
+	}
+
+	if (_quantization & QUANTIZATION_UVS_UNORM16) {
+		if (_uvs.size() > 0) {
+			_uvs_q = MDRQuantization::encode_unorm16_2(_uvs, _uvs_range);
+			_uvs.clear();
+		}
+
+		if (_uv2s.size() > 0) {
+			_uv2s_q = MDRQuantization::encode_unorm16_2(_uv2s, _uv2s_range);
+			_uv2s.clear();
+		}
+	} else if (_quantization & QUANTIZATION_UVS_HALF) {
+		if (_uvs.size() > 0) {
+			_uvs_q = MDRQuantization::encode_half2(_uvs);
+			_uvs.clear();
+		}
+
+		if (_uv2s.size() > 0) {
+			_uv2s_q = MDRQuantization::encode_half2(_uv2s);
+			_uv2s.clear();
+		}
+	}
+
+	if ((_quantization & QUANTIZATION_WEIGHTS_UNORM8) && _weights.size() > 0) {
+		_weights_q = MDRQuantization::encode_weights_unorm8(_weights);
+		_weights.clear();
+	}
+
+	if ((_quantization & QUANTIZATION_COLORS_UNORM8) && _colors.size() > 0) {
+		_colors_q = MDRQuantization::encode_colors_unorm8(_colors);
+		_colors.clear();
+	}
+
+	//Meshes with more than 256 bones keep the full width indices
+	if ((_quantization & QUANTIZATION_BONES_UINT8) && _bones.size() > 0) {
+		if (MDRQuantization::encode_bones_uint8(_bones, _bones_q)) {
+			_bones.clear();
+		}
+	}
+}
+
+void MeshDataResource::_dequantize() {
+	//The getters know which of the formats were used
+	if (_normals_q.size() > 0) {
+		_normals = get_normals();
+		_normals_q.clear();
+	}
+
+	if (_tangents_q.size() > 0) {
+		_tangents = get_tangents();
+		_tangents_q.clear();
+	}
+
+	if (_colors_q.size() > 0) {
+		_colors = get_colors();
+		_colors_q.clear();
+	}
+
+	if (_uvs_q.size() > 0) {
+		_uvs = get_uvs();
+		_uvs_q.clear();
+	}
+
+	if (_uv2s_q.size() > 0) {
+		_uv2s = get_uv2s();
+		_uv2s_q.clear();
+	}
+
+	if (_bones_q.size() > 0) {
+		_bones = get_bones();
+		_bones_q.clear();
+	}
+
+	if (_weights_q.size() > 0) {
+		_weights = get_weights();
+		_weights_q.clear();
+	}
+}
+
+int MeshDataResource::_get_stored_quantization() const {
+	int flags = QUANTIZATION_NONE;
+
+	if (_normals_q.size() > 0 || _tangents_q.size() > 0) {
+		flags |= QUANTIZATION_NORMALS_OCTAHEDRAL;
+	}
+
+	if (_uvs_q.size() > 0 || _uv2s_q.size() > 0) {
+		flags |= (_quantization & QUANTIZATION_UVS_UNORM16) ? QUANTIZATION_UVS_UNORM16 : QUANTIZATION_UVS_HALF;
+	}
+
+	if (_weights_q.size() > 0) {
+		flags |= QUANTIZATION_WEIGHTS_UNORM8;
+	}
+
+	if (_colors_q.size() > 0) {
+		flags |= QUANTIZATION_COLORS_UNORM8;
+	}
+
+	if (_bones_q.size() > 0) {
+		flags |= QUANTIZATION_BONES_UINT8;
+	}
+
+	return flags;
+}
+
+uint32_t MeshDataResource::_get_quantized_format() const {
+	uint32_t format = 0;
+
+	if (_normals_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_NORMAL;
+	}
+
+	if (_tangents_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_TANGENT;
+	}
+
+	if (_colors_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_COLOR;
+	}
+
+	if (_uvs_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_TEX_UV;
+	}
+
+	if (_uv2s_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_TEX_UV2;
+	}
+
+	if (_bones_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_BONES;
+	}
+
+	if (_weights_q.size() > 0) {
+		format |= Mesh::ARRAY_FORMAT_WEIGHTS;
+	}
+
+	return format;
+}
+
+void MeshDataResource::_encode_appended(const uint32_t p_staged) {
+	if (p_staged & Mesh::ARRAY_FORMAT_NORMAL) {
+		_normals_q.append_array(MDRQuantization::encode_normals_octahedral(_normals));
+		_normals.clear();
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_TANGENT) {
+		_tangents_q.append_array(MDRQuantization::encode_tangents_octahedral(_tangents));
+		_tangents.clear();
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_COLOR) {
+		_colors_q.append_array(MDRQuantization::encode_colors_unorm8(_colors));
+		_colors.clear();
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_TEX_UV) {
+		_encode_appended_uvs(_uvs, _uvs_q, _uvs_range);
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_TEX_UV2) {
+		_encode_appended_uvs(_uv2s, _uv2s_q, _uv2s_range);
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_BONES) {
+		Vector<uint8_t> encoded;
+
+		if (MDRQuantization::encode_bones_uint8(_bones, encoded)) {
+			_bones_q.append_array(encoded);
+			_bones.clear();
+		} else {
+			//Same as _quantize(), these keep the full width indices from now on
+			Vector<int> bones = MDRQuantization::decode_bones_uint8(_bones_q);
+			bones.append_array(_bones);
+			_bones = bones;
+			_bones_q.clear();
+		}
+	}
+
+	if (p_staged & Mesh::ARRAY_FORMAT_WEIGHTS) {
+		_weights_q.append_array(MDRQuantization::encode_weights_unorm8(_weights));
+		_weights.clear();
+	}
+}
+
+void MeshDataResource::_encode_appended_uvs(Vector<Vector2> &r_uvs, Vector<uint16_t> &r_uvs_q, Rect2 &r_range) {
+	if (!(_quantization & QUANTIZATION_UVS_UNORM16)) {
+		r_uvs_q.append_array(MDRQuantization::encode_half2(r_uvs));
+		r_uvs.clear();
+		return;
+	}
+
+	Vector<uint16_t> encoded;
+
+	if (MDRQuantization::encode_unorm16_2_in_range(r_uvs, r_range, encoded)) {
+		r_uvs_q.append_array(encoded);
+		r_uvs.clear();
+		return;
+	}
+
+	//Doesn't fit, the whole attribute gets encoded again with the grown range
+	Vector<Vector2> uvs = MDRQuantization::decode_unorm16_2(r_uvs_q, r_range);
+	uvs.append_array(r_uvs);
+
+	r_uvs_q = MDRQuantization::encode_unorm16_2(uvs, r_range);
+	r_uvs.clear();
+}
+
+void MeshDataResource::_expand_aabb(const int p_from, const int p_count) {
+	if (p_count <= 0) {
+		return;
+	}
+
+	//Only the appended range needs to be looked at
+	if (_vertices_2d.size() > 0) {
+		_aabb.merge_with(MDRBounds::compute_aabb_2d(_vertices_2d.ptr() + p_from, p_count));
+	} else {
+		_aabb.merge_with(MDRBounds::compute_aabb(_vertices.ptr() + p_from, p_count));
+	}
+}
+
+void MeshDataResource::_clear_geometry() {
+	_vertices.clear();
+	_vertices_2d.clear();
+	_normals.clear();
+	_tangents.clear();
+	_colors.clear();
+	_uvs.clear();
+	_uv2s.clear();
+	_bones.clear();
+	_weights.clear();
+	_indices_16.clear();
+	_indices_32.clear();
+	_seams_16.clear();
+	_seams_32.clear();
+	_lods.clear();
+	_clusters.clear();
+
+	_normals_q.clear();
+	_tangents_q.clear();
+	_colors_q.clear();
+	_uvs_q.clear();
+	_uv2s_q.clear();
+	_bones_q.clear();
+	_weights_q.clear();
+
+	_clear_caches();
+}
+
+void MeshDataResource::_load_geometry() const {
+	MutexLock lock(_geometry_mutex);
+
+	if (_geometry_loaded.is_set()) {
+		return;
+	}
+
+	MeshDataResource *self = const_cast<MeshDataResource *>(this);
+
+	Error err = ResourceFormatLoaderMDRes::load_geometry(_geometry_path, self);
+
+	if (err != OK) {
+		//Leave an empty, loaded resource behind, so the accessors don't keep retrying with half filled buffers
+		ERR_PRINT("Failed to load the geometry of a MeshDataResource from '" + _geometry_path + "'.");
+
+		self->_clear_geometry();
+		self->_unloaded_vertex_count = 0;
+		self->_unloaded_index_count = 0;
+		self->_geometry_path = String();
+	}
+
+	_geometry_loaded.set();
+}
+
+void MeshDataResource::_set_geometry_loaded(const String &p_path) {
+	_geometry_path = p_path;
+	_geometry_loaded.set();
+}
+
+void MeshDataResource::_set_geometry_unloaded(const String &p_path, const int p_vertex_count, const int p_index_count) {
+	_geometry_path = p_path;
+	_unloaded_vertex_count = p_vertex_count;
+	_unloaded_index_count = p_index_count;
+	_geometry_loaded.clear();
+}
+
+void MeshDataResource::_set_indices(const Vector<int> &p_indices) {
+	_indices_16.clear();
+	_indices_32.clear();
+
+	_index_format = get_vertex_count() < INDEX_FORMAT_16_BIT_MAX_VERTEX_COUNT ? INDEX_FORMAT_16_BIT : INDEX_FORMAT_32_BIT;
+
+	_append_indices(p_indices, 0);
+}
+
+void MeshDataResource::_set_seams(const Vector<int> &p_seams) {
+	_seams_16.clear();
+	_seams_32.clear();
+
+	const int *r = p_seams.ptr();
+
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		_seams_16.resize(p_seams.size());
+		uint16_t *w = _seams_16.ptrw();
+
+		for (int i = 0; i < p_seams.size(); ++i) {
+			w[i] = r[i];
+		}
+	} else {
+		_seams_32.resize(p_seams.size());
+		uint32_t *w = _seams_32.ptrw();
+
+		for (int i = 0; i < p_seams.size(); ++i) {
+			w[i] = r[i];
+		}
+	}
+}
+
+void MeshDataResource::_widen_indices() {
+	if (_index_format == INDEX_FORMAT_32_BIT) {
+		return;
+	}
+
+	_indices_32.resize(_indices_16.size());
+	uint32_t *iw = _indices_32.ptrw();
+
+	for (int i = 0; i < _indices_16.size(); ++i) {
+		iw[i] = _indices_16[i];
+	}
+
+	_seams_32.resize(_seams_16.size());
+	uint32_t *sw = _seams_32.ptrw();
+
+	for (int i = 0; i < _seams_16.size(); ++i) {
+		sw[i] = _seams_16[i];
+	}
+
+	_indices_16.clear();
+	_seams_16.clear();
+
+	for (int i = 0; i < _lods.size(); ++i) {
+		MDRLod &lod = _lods.write[i];
+
+		lod.indices_32.resize(lod.indices_16.size());
+		uint32_t *lw = lod.indices_32.ptrw();
+
+		for (int j = 0; j < lod.indices_16.size(); ++j) {
+			lw[j] = lod.indices_16[j];
+		}
+
+		lod.indices_16.clear();
+	}
+
+	_index_format = INDEX_FORMAT_32_BIT;
+}
+
+void MeshDataResource::_append_indices(const Vector<int> &p_indices, const int p_offset) {
+	const int *r = p_indices.ptr();
+	int count = p_indices.size();
+
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		int oic = _indices_16.size();
+		_indices_16.resize(oic + count);
+		uint16_t *w = _indices_16.ptrw() + oic;
+
+		for (int i = 0; i < count; ++i) {
+			w[i] = r[i] + p_offset;
+		}
+	} else {
+		int oic = _indices_32.size();
+		_indices_32.resize(oic + count);
+		uint32_t *w = _indices_32.ptrw() + oic;
+
+		for (int i = 0; i < count; ++i) {
+			w[i] = r[i] + p_offset;
+		}
+	}
+}
+
+Vector<uint32_t> MeshDataResource::_get_indices_widened() const {
+	if (_index_format == INDEX_FORMAT_32_BIT) {
+		return _indices_32;
+	}
+
+	Vector<uint32_t> indices;
+	indices.resize(_indices_16.size());
+	uint32_t *w = indices.ptrw();
+
+	for (int i = 0; i < _indices_16.size(); ++i) {
+		w[i] = _indices_16[i];
+	}
+
+	return indices;
+}
+
+void MeshDataResource::_store_indices(const Vector<uint32_t> &p_indices) {
+	//Keeps the current index format
+	if (_index_format == INDEX_FORMAT_32_BIT) {
+		_indices_32 = p_indices;
+		return;
+	}
+
+	_indices_16.resize(p_indices.size());
+	uint16_t *w = _indices_16.ptrw();
+
+	for (int i = 0; i < p_indices.size(); ++i) {
+		w[i] = p_indices[i];
+	}
+}
+
+void MeshDataResource::_remap_seams(const Vector<uint32_t> &p_remap) {
+	const uint32_t *r = p_remap.ptr();
+	uint32_t remap_size = p_remap.size();
+
+	if (_index_format == INDEX_FORMAT_16_BIT) {
+		uint16_t *w = _seams_16.ptrw();
+
+		for (int i = 0; i < _seams_16.size(); ++i) {
+			if (w[i] < remap_size) {
+				w[i] = r[w[i]];
+			}
+		}
+	} else {
+		uint32_t *w = _seams_32.ptrw();
+
+		for (int i = 0; i < _seams_32.size(); ++i) {
+			if (w[i] < remap_size) {
+				w[i] = r[w[i]];
+			}
+		}
+	}
+}
+
+bool MeshDataResource::_make_lod(const Vector<int> &p_indices, const float p_error, MDRLod &r_lod) const {
+	int vertex_count = get_vertex_count();
+
+	Vector<uint32_t> indices;
+	indices.resize(p_indices.size());
+	uint32_t *w = indices.ptrw();
+
+	for (int i = 0; i < p_indices.size(); ++i) {
+		ERR_FAIL_INDEX_V(p_indices[i], vertex_count, false);
+
+		w[i] = p_indices[i];
+	}
+
+	r_lod.error = p_error;
+	_store_lod_indices(r_lod, indices);
+
+	return true;
+}
+
+Vector<uint32_t> MeshDataResource::_get_lod_indices_widened(const MDRLod &p_lod) const {
+	if (_index_format == INDEX_FORMAT_32_BIT) {
+		return p_lod.indices_32;
+	}
+
+	Vector<uint32_t> indices;
+	indices.resize(p_lod.indices_16.size());
+	uint32_t *w = indices.ptrw();
+
+	for (int i = 0; i < p_lod.indices_16.size(); ++i) {
+		w[i] = p_lod.indices_16[i];
+	}
+
+	return indices;
+}
+
+void MeshDataResource::_store_lod_indices(MDRLod &r_lod, const Vector<uint32_t> &p_indices) const {
+	r_lod.indices_16.clear();
+	r_lod.indices_32.clear();
+
+	if (_index_format == INDEX_FORMAT_32_BIT) {
+		r_lod.indices_32 = p_indices;
+		return;
+	}
+
+	r_lod.indices_16.resize(p_indices.size());
+	uint16_t *w = r_lod.indices_16.ptrw();
+
+	for (int i = 0; i < p_indices.size(); ++i) {
+		w[i] = p_indices[i];
+	}
+}
+
+void MeshDataResource::_transform_vertex_range(const int p_from, const int p_count, const Transform &p_transform, const int p_normals_from) {
+	if (p_count == 0) {
+		return;
+	}
+
+	if (is_2d()) {
+		Vector2 *vw = _vertices_2d.ptrw() + p_from;
+
+		for (int i = 0; i < p_count; ++i) {
+			Vector3 v = p_transform.xform(Vector3(vw[i].x, vw[i].y, 0));
+			vw[i] = Vector2(v.x, v.y);
+		}
+
+		return;
+	}
+
+	Vector3 *vw = _vertices.ptrw() + p_from;
+
+	for (int i = 0; i < p_count; ++i) {
+		vw[i] = p_transform.xform(vw[i]);
+	}
+
+	if (_normals.size() > 0) {
+		Basis normal_basis = p_transform.basis.inverse().transposed();
+		Vector3 *nw = _normals.ptrw() + p_from - p_normals_from;
+
+		for (int i = 0; i < p_count; ++i) {
+			nw[i] = normal_basis.xform(nw[i]).normalized();
+		}
+	}
+
+	if (_tangents.size() > 0) {
+		float *tw = _tangents.ptrw() + (p_from - p_normals_from) * 4;
+
+		for (int i = 0; i < p_count; ++i) {
+			float *t = tw + i * 4;
+			Vector3 tangent = p_transform.basis.xform(Vector3(t[0], t[1], t[2])).normalized();
+
+			t[0] = tangent.x;
+			t[1] = tangent.y;
+			t[2] = tangent.z;
+		}
+	}
+}
+
+template <class T>
+void MeshDataResource::_copy_attribute(T *r_dst, const Vector<T> &p_src, const int p_count) {
+	if (p_src.size() == p_count) {
+		memcpy(r_dst, p_src.ptr(), sizeof(T) * p_count);
+	} else {
+		//Missing from the merged mesh, pad it
+		for (int i = 0; i < p_count; ++i) {
+			r_dst[i] = T();
+		}
+	}
+}
+
+template <class T>
+void MeshDataResource::_remap_attribute(Vector<T> &r_data, const Vector<uint32_t> &p_remap, const int p_components) {
+	if (r_data.size() != p_remap.size() * p_components) {
+		return;
+	}
+
+	Vector<T> remapped;
+	remapped.resize(r_data.size());
+
+	const T *r = r_data.ptr();
+	T *w = remapped.ptrw();
+
+	for (int i = 0; i < p_remap.size(); ++i) {
+		const T *src = r + i * p_components;
+		T *dst = w + p_remap[i] * p_components;
+
+		for (int j = 0; j < p_components; ++j) {
+			dst[j] = src[j];
+		}
+	}
+
+	r_data = remapped;
+}
+
+template <class T>
+void MeshDataResource::_append_attribute(Vector<T> &r_dst, const Vector<T> &p_src, const int p_vertex_count, const int p_components, const bool p_staged) {
+	//Attributes that the current mesh doesn't have are dropped, just like with Mesh::ARRAY_* flags
+	if (r_dst.size() == 0 && !p_staged) {
+		return;
+	}
+
+	int osize = r_dst.size();
+	int count = p_vertex_count * p_components;
+
+	r_dst.resize(osize + count);
+	T *w = r_dst.ptrw() + osize;
+
+	if (p_src.size() == count) {
+		memcpy(w, p_src.ptr(), sizeof(T) * count);
+	} else {
+		//Missing from the merged mesh, pad it
+		for (int i = 0; i < count; ++i) {
+			w[i] = T();
+		}
+	}
+}
+
+void MeshDataResource::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_array"), &MeshDataResource::get_array);
+	ClassDB::bind_method(D_METHOD("set_array", "array"), &MeshDataResource::set_array);
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "array"), "set_array", "get_array");
+
+	ClassDB::bind_method(D_METHOD("get_aabb"), &MeshDataResource::get_aabb);
+	ClassDB::bind_method(D_METHOD("set_aabb", "array"), &MeshDataResource::set_aabb);
+	ADD_PROPERTY(PropertyInfo(Variant::AABB, "aabb"), "set_aabb", "get_aabb");
+
+	ClassDB::bind_method(D_METHOD("get_collision_shapes"), &MeshDataResource::get_collision_shapes);
+	ClassDB::bind_method(D_METHOD("set_collision_shapes", "array"), &MeshDataResource::set_collision_shapes);
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "collision_shapes"), "set_collision_shapes", "get_collision_shapes");
+
+	ClassDB::bind_method(D_METHOD("get_seams"), &MeshDataResource::get_seams);
+	ClassDB::bind_method(D_METHOD("set_seams", "array"), &MeshDataResource::set_seams);
+	ADD_PROPERTY(PropertyInfo(Variant::POOL_INT_ARRAY, "seams"), "set_seams", "get_seams");
+
+	ClassDB::bind_method(D_METHOD("add_collision_shape", "shape"), &MeshDataResource::add_collision_shape);
+	ClassDB::bind_method(D_METHOD("get_collision_shape", "index"), &MeshDataResource::get_collision_shape);
+	ClassDB::bind_method(D_METHOD("get_collision_shape_count"), &MeshDataResource::get_collision_shape_count);
+
+	ClassDB::bind_method(D_METHOD("append_arrays", "array"), &MeshDataResource::append_arrays);
+	ClassDB::bind_method(D_METHOD("append_arrays_bulk", "arrays", "transforms"), &MeshDataResource::append_arrays_bulk, DEFVAL(Array()));
+
+	ClassDB::bind_method(D_METHOD("recompute_aabb"), &MeshDataResource::recompute_aabb);
+
+	ClassDB::bind_method(D_METHOD("optimize_vertex_cache"), &MeshDataResource::optimize_vertex_cache);
+	ClassDB::bind_method(D_METHOD("optimize_vertex_fetch"), &MeshDataResource::optimize_vertex_fetch);
+	ClassDB::bind_method(D_METHOD("optimize_overdraw", "threshold"), &MeshDataResource::optimize_overdraw, DEFVAL(1.05));
+	ClassDB::bind_method(D_METHOD("calculate_acmr", "cache_size"), &MeshDataResource::calculate_acmr, DEFVAL(16));
+
+	ClassDB::bind_method(D_METHOD("get_lods"), &MeshDataResource::get_lods);
+	ClassDB::bind_method(D_METHOD("set_lods", "lods"), &MeshDataResource::set_lods);
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "lods"), "set_lods", "get_lods");
+
+	ClassDB::bind_method(D_METHOD("get_lod_count"), &MeshDataResource::get_lod_count);
+	ClassDB::bind_method(D_METHOD("get_lod_error", "index"), &MeshDataResource::get_lod_error);
+	ClassDB::bind_method(D_METHOD("get_lod_indices", "index"), &MeshDataResource::get_lod_indices);
+	ClassDB::bind_method(D_METHOD("add_lod", "indices", "error"), &MeshDataResource::add_lod);
+	ClassDB::bind_method(D_METHOD("clear_lods"), &MeshDataResource::clear_lods);
+	ClassDB::bind_method(D_METHOD("generate_lods", "max_lod_count", "max_error"), &MeshDataResource::generate_lods, DEFVAL(4), DEFVAL(0.05));
+	ClassDB::bind_method(D_METHOD("get_surface_lods"), &MeshDataResource::get_surface_lods);
+
+	ClassDB::bind_method(D_METHOD("get_cluster_data"), &MeshDataResource::get_cluster_data);
+	ClassDB::bind_method(D_METHOD("set_cluster_data", "data"), &MeshDataResource::set_cluster_data);
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "cluster_data", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NO_EDITOR), "set_cluster_data", "get_cluster_data");
+
+	ClassDB::bind_method(D_METHOD("build_clusters", "max_vertices", "max_triangles"), &MeshDataResource::build_clusters, DEFVAL(MDRClusterBuilder::DEFAULT_MAX_VERTICES), DEFVAL(MDRClusterBuilder::DEFAULT_MAX_TRIANGLES));
+	ClassDB::bind_method(D_METHOD("clear_clusters"), &MeshDataResource::clear_clusters);
+	ClassDB::bind_method(D_METHOD("get_cluster_count"), &MeshDataResource::get_cluster_count);
+
+	ClassDB::bind_method(D_METHOD("intersect_ray", "from", "direction", "max_distance"), &MeshDataResource::intersect_ray, DEFVAL(1e20));
+	ClassDB::bind_method(D_METHOD("intersect_segment", "from", "to"), &MeshDataResource::intersect_segment);
+	ClassDB::bind_method(D_METHOD("get_closest_point", "point"), &MeshDataResource::get_closest_point);
+
+	ClassDB::bind_method(D_METHOD("get_quantization"), &MeshDataResource::get_quantization);
+	ClassDB::bind_method(D_METHOD("set_quantization", "flags"), &MeshDataResource::set_quantization);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "quantization", PROPERTY_HINT_FLAGS, BINDING_STRING_QUANTIZATION_FLAGS), "set_quantization", "get_quantization");
+
+	ClassDB::bind_method(D_METHOD("get_geometry_memory_usage"), &MeshDataResource::get_geometry_memory_usage);
+
+	ClassDB::bind_method(D_METHOD("is_geometry_loaded"), &MeshDataResource::is_geometry_loaded);
+	ClassDB::bind_method(D_METHOD("unload_geometry"), &MeshDataResource::unload_geometry);
+
+	ClassDB::bind_method(D_METHOD("get_index_format"), &MeshDataResource::get_index_format);
+	ClassDB::bind_method(D_METHOD("get_index_count"), &MeshDataResource::get_index_count);
+
+	ADD_SIGNAL(MethodInfo("mesh_rid_updated"));
+
+	BIND_ENUM_CONSTANT(INDEX_FORMAT_16_BIT);
+	BIND_ENUM_CONSTANT(INDEX_FORMAT_32_BIT);
+
+	BIND_ENUM_CONSTANT(QUANTIZATION_NONE);
+	BIND_ENUM_CONSTANT(QUANTIZATION_NORMALS_OCTAHEDRAL);
+	BIND_ENUM_CONSTANT(QUANTIZATION_UVS_HALF);
+	BIND_ENUM_CONSTANT(QUANTIZATION_UVS_UNORM16);
+	BIND_ENUM_CONSTANT(QUANTIZATION_WEIGHTS_UNORM8);
+	BIND_ENUM_CONSTANT(QUANTIZATION_COLORS_UNORM8);
+	BIND_ENUM_CONSTANT(QUANTIZATION_BONES_UINT8);
 }
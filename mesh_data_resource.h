@@ -34,7 +34,8 @@ SOFTWARE.
 #include "core/math/transform_3d.h"
 typedef class Transform3D Transform;
 
-#define PoolIntArray PackedInt64Array
+#define PoolIntArray PackedInt32Array
+#define PoolRealArray PackedFloat32Array
 
 #else
 #include "core/resource.h"
@@ -43,9 +44,15 @@ typedef class Transform3D Transform;
 #include "core/pool_vector.h"
 #endif
 
+#include "core/os/mutex.h"
+#include "core/templates/safe_refcount.h"
 #include "core/version.h"
+#include "core/math/face3.h"
 #include "scene/resources/mesh.h"
 
+#include "utils/mdr_bvh.h"
+#include "utils/mdr_cluster_builder.h"
+
 #if VERSION_MAJOR < 4
 #include "scene/resources/shape.h"
 #else
@@ -58,6 +65,11 @@ class MeshDataResource : public Resource {
 	GDCLASS(MeshDataResource, Resource);
 	RES_BASE_EXTENSION("mdres");
 
+	friend class ResourceFormatLoaderMDRes;
+	friend class ResourceFormatSaverMDRes;
+	friend class MDRMeshUploader;
+	friend class MDRImportPluginBase;
+
 public:
 	static const String BINDING_STRING_COLLIDER_TYPE;
 
@@ -72,11 +84,68 @@ public:
 		COLLIDER_TYPE_APPROXIMATED_SPHERE,
 	};
 
+	//Indices (and seams) are stored in the narrowest width that can address every vertex
+	enum IndexFormat {
+		INDEX_FORMAT_16_BIT = 0,
+		INDEX_FORMAT_32_BIT,
+	};
+
+	static const int INDEX_FORMAT_16_BIT_MAX_VERTEX_COUNT = 65536;
+
+	static const String BINDING_STRING_QUANTIZATION_FLAGS;
+
+	//Compact storage formats for vertex attributes, decoded by the accessors
+	enum QuantizationFlags {
+		QUANTIZATION_NONE = 0,
+		QUANTIZATION_NORMALS_OCTAHEDRAL = 1 << 0, //normals and tangents
+		QUANTIZATION_UVS_HALF = 1 << 1,
+		QUANTIZATION_UVS_UNORM16 = 1 << 2, //takes precedence over half
+		QUANTIZATION_WEIGHTS_UNORM8 = 1 << 3,
+		QUANTIZATION_COLORS_UNORM8 = 1 << 4,
+		QUANTIZATION_BONES_UINT8 = 1 << 5, //only applied if every bone index fits
+	};
+
 public:
 	Array get_array();
 	void set_array(const Array &p_arrays);
 	Array get_array_const() const;
 
+	//Typed access to the vertex data, for c++ users
+	int get_vertex_count() const;
+	bool is_2d() const;
+
+	//The references (and get_vertices_ptr(), get_bvh()) stay valid until the geometry changes or gets unloaded.
+	//Both only happen on the main thread, so worker tasks that the main thread waits for can read them.
+	const Vector<Vector3> &get_vertices() const;
+	const Vector<Vector2> &get_vertices_2d() const;
+
+	//These decode the attribute if it's quantized
+	Vector<Vector3> get_normals() const;
+	Vector<float> get_tangents() const;
+	Vector<Color> get_colors() const;
+	Vector<Vector2> get_uvs() const;
+	Vector<Vector2> get_uv2s() const;
+	Vector<int> get_bones() const;
+	Vector<float> get_weights() const;
+
+	const Vector3 *get_vertices_ptr() const;
+
+	IndexFormat get_index_format() const;
+	int get_index_count() const;
+	_FORCE_INLINE_ uint32_t get_index(const int p_index) const {
+		_ensure_geometry();
+
+		if (_index_format == INDEX_FORMAT_16_BIT) {
+			return _indices_16[p_index];
+		}
+
+		return _indices_32[p_index];
+	}
+
+	const Vector<uint16_t> &get_indices_16() const;
+	const Vector<uint32_t> &get_indices_32() const;
+	Vector<int> get_indices() const;
+
 	AABB get_aabb() const;
 	void set_aabb(const AABB &aabb);
 
@@ -92,9 +161,75 @@ public:
 	void set_seams(const PoolIntArray &array);
 
 	void append_arrays(const Array &p_arrays);
+	void append_arrays_bulk(const Array &p_arrays, const Array &p_transforms = Array());
 
 	void recompute_aabb();
 
+	//Reorders the triangles for the post transform vertex cache
+	void optimize_vertex_cache();
+	//Reorders the vertices into the order the indices first use them
+	void optimize_vertex_fetch();
+	//Sorts triangle clusters so outward facing ones get drawn first, 3D only.
+	//p_threshold is how much worse the vertex cache efficiency is allowed to get.
+	void optimize_overdraw(const float p_threshold = 1.05);
+	float calculate_acmr(const int p_cache_size = 16) const;
+
+	//Index buffers over the same vertices, from the most to the least detailed one.
+	//Their error is the largest distance the simplified surface gets from the original.
+	int get_lod_count() const;
+	float get_lod_error(const int p_index) const;
+	PoolIntArray get_lod_indices(const int p_index) const;
+	void add_lod(const PoolIntArray &p_indices, const float p_error);
+	void clear_lods();
+
+	//Every level targets half the triangles of the previous one, p_max_error is relative to the aabb's longest axis
+	void generate_lods(const int p_max_lod_count = 4, const float p_max_error = 0.05);
+
+	//In the format RenderingServer::mesh_add_surface_from_arrays() expects
+	Dictionary get_surface_lods() const;
+
+	Array get_lods() const;
+	void set_lods(const Array &p_lods);
+
+	//Splits the triangles into clusters with bounds and normal cones, for cpu side culling.
+	//Changing the indices clears them.
+	void build_clusters(const int p_max_vertices = MDRClusterBuilder::DEFAULT_MAX_VERTICES, const int p_max_triangles = MDRClusterBuilder::DEFAULT_MAX_TRIANGLES);
+	void clear_clusters();
+	int get_cluster_count() const;
+	const Vector<MDRCluster> &get_clusters() const;
+
+	PoolRealArray get_cluster_data() const;
+	void set_cluster_data(const PoolRealArray &p_data);
+
+	//Built on first use, and shared until the geometry changes. Empty for 2D meshes.
+	Vector<Face3> get_faces() const;
+
+	//RenderingServer mesh shared by every user that draws this resource as is. Reference counted,
+	//freed when the last user releases it, and re-uploaded on first access after the geometry changes.
+	//The upload happens in the background, the surface shows up once it's committed.
+	RID acquire_mesh_rid();
+	void release_mesh_rid();
+	RID get_mesh_rid();
+
+	//Triangle bvh for ray and closest point queries, 3D only. Built on first use, and rebuilt after the geometry changes.
+	const MDRBVH &get_bvh() const;
+
+	//These return an empty Dictionary, or position, normal, face_index and distance
+	Dictionary intersect_ray(const Vector3 &p_from, const Vector3 &p_direction, const real_t p_max_distance = 1e20) const;
+	Dictionary intersect_segment(const Vector3 &p_from, const Vector3 &p_to) const;
+	Dictionary get_closest_point(const Vector3 &p_point) const;
+
+	int get_quantization() const;
+	void set_quantization(const int p_flags);
+
+	//Bytes used by the vertex, index and seam buffers
+	int get_geometry_memory_usage() const;
+
+	//Geometry of resources loaded from .mdres files can be evicted, and it gets reloaded on first access.
+	//Main thread only, as the accessors above hand out references without locking.
+	bool is_geometry_loaded() const;
+	void unload_geometry();
+
 	MeshDataResource();
 	~MeshDataResource();
 
@@ -104,16 +239,126 @@ protected:
 		Transform transform;
 	};
 
+	struct MDRLod {
+		float error;
+		Vector<uint16_t> indices_16;
+		Vector<uint32_t> indices_32;
+
+		MDRLod() {
+			error = 0;
+		}
+	};
+
 protected:
 	static void _bind_methods();
 
+	void _set_arrays(const Array &p_arrays);
+	void _geometry_changed();
+	void _quantize();
+	void _dequantize();
+	int _get_stored_quantization() const;
+	uint32_t _get_quantized_format() const;
+	void _encode_appended(const uint32_t p_staged);
+	void _encode_appended_uvs(Vector<Vector2> &r_uvs, Vector<uint16_t> &r_uvs_q, Rect2 &r_range);
+	void _expand_aabb(const int p_from, const int p_count);
+
+	_FORCE_INLINE_ void _ensure_geometry() const {
+		if (unlikely(!_geometry_loaded.is_set())) {
+			_load_geometry();
+		}
+	}
+
+	void _load_geometry() const;
+	void _clear_geometry();
+	void _update_mesh_rid();
+	bool _commit_mesh_surface(const uint64_t p_version, const RS::SurfaceData &p_surface);
+	void _build_faces() const;
+	void _build_bvh() const;
+	void _clear_caches();
+	static Dictionary _hit_to_dict(const MDRBVH::Hit &p_hit);
+	void _set_geometry_loaded(const String &p_path);
+	void _set_geometry_unloaded(const String &p_path, const int p_vertex_count, const int p_index_count);
+
+	void _set_indices(const Vector<int> &p_indices);
+	void _set_seams(const Vector<int> &p_seams);
+	void _widen_indices();
+	void _append_indices(const Vector<int> &p_indices, const int p_offset);
+	Vector<uint32_t> _get_indices_widened() const;
+	void _store_indices(const Vector<uint32_t> &p_indices);
+	void _remap_seams(const Vector<uint32_t> &p_remap);
+	Vector<uint32_t> _get_lod_indices_widened(const MDRLod &p_lod) const;
+	void _store_lod_indices(MDRLod &r_lod, const Vector<uint32_t> &p_indices) const;
+	//Returns false, if an index is out of range
+	bool _make_lod(const Vector<int> &p_indices, const float p_error, MDRLod &r_lod) const;
+
+	//Staged normals and tangents start at p_normals_from
+	void _transform_vertex_range(const int p_from, const int p_count, const Transform &p_transform, const int p_normals_from = 0);
+
+	template <class T>
+	static void _copy_attribute(T *r_dst, const Vector<T> &p_src, const int p_count);
+
+	template <class T>
+	static void _remap_attribute(Vector<T> &r_data, const Vector<uint32_t> &p_remap, const int p_components);
+
+	template <class T>
+	static void _append_attribute(Vector<T> &r_dst, const Vector<T> &p_src, const int p_vertex_count, const int p_components, const bool p_staged);
+
 private:
-	Array _arrays;
+	Vector<Vector3> _vertices;
+	Vector<Vector2> _vertices_2d;
+	Vector<Vector3> _normals;
+	Vector<float> _tangents;
+	Vector<Color> _colors;
+	Vector<Vector2> _uvs;
+	Vector<Vector2> _uv2s;
+	Vector<int> _bones;
+	Vector<float> _weights;
+
+	IndexFormat _index_format;
+	Vector<uint16_t> _indices_16;
+	Vector<uint32_t> _indices_32;
+	Vector<uint16_t> _seams_16;
+	Vector<uint32_t> _seams_32;
+
+	Vector<MDRLod> _lods;
+	Vector<MDRCluster> _clusters;
+
+	RID _mesh_rid;
+	int _mesh_rid_users;
+	bool _mesh_rid_dirty;
+	uint64_t _mesh_rid_version;
+	Mutex _mesh_rid_mutex;
+
+	//Derived from the geometry, built on demand
+	mutable Vector<Face3> _faces;
+	mutable SafeFlag _faces_built;
+	mutable MDRBVH _bvh;
+	mutable SafeFlag _bvh_built;
+	mutable Mutex _cache_mutex;
+
+	int _quantization;
+	Vector<uint32_t> _normals_q;
+	Vector<uint32_t> _tangents_q;
+	Vector<uint8_t> _colors_q;
+	Vector<uint16_t> _uvs_q;
+	Vector<uint16_t> _uv2s_q;
+	Rect2 _uvs_range;
+	Rect2 _uv2s_range;
+	Vector<uint8_t> _bones_q;
+	Vector<uint8_t> _weights_q;
+
 	AABB _aabb;
 	Vector<MDRData> _collision_shapes;
-	PoolIntArray _seams;
+
+	String _geometry_path;
+	mutable SafeFlag _geometry_loaded;
+	mutable Mutex _geometry_mutex;
+	int _unloaded_vertex_count;
+	int _unloaded_index_count;
 };
 
 VARIANT_ENUM_CAST(MeshDataResource::ColliderType);
+VARIANT_ENUM_CAST(MeshDataResource::IndexFormat);
+VARIANT_ENUM_CAST(MeshDataResource::QuantizationFlags);
 
 #endif
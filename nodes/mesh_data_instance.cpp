@@ -19,7 +19,12 @@
 #include "../../texture_packer/texture_resource/packer_image_resource.h"
 #endif
 
+#include "../utils/mdr_material_cache.h"
+#include "../utils/mdr_texture_cache.h"
+#include "mesh_data_static_batch.h"
+#include "scene/3d/camera_3d.h"
 #include "scene/3d/mesh_instance_3d.h"
+#include "scene/main/viewport.h"
 
 bool MeshDataInstance::get_snap_to_mesh() const {
 	return _snap_to_mesh;
@@ -40,15 +45,15 @@ Ref<MeshDataResource> MeshDataInstance::get_mesh_data() {
 }
 void MeshDataInstance::set_mesh_data(const Ref<MeshDataResource> &mesh) {
 	if (_mesh.is_valid()) {
-		_mesh->disconnect("changed", Callable(this, "refresh"));
+		_mesh->disconnect("changed", Callable(this, "queue_refresh"));
 	}
 
 	_mesh = mesh;
 
-	refresh();
+	queue_refresh();
 
 	if (_mesh.is_valid()) {
-		_mesh->connect("changed", Callable(this, "refresh"));
+		_mesh->connect("changed", Callable(this, "queue_refresh"));
 	}
 
 	emit_signal("mesh_data_resource_changed", _mesh);
@@ -61,7 +66,7 @@ void MeshDataInstance::set_texture(const Ref<Texture> &texture) {
 	_texture = texture;
 
 	setup_material_texture();
-	refresh();
+	queue_refresh();
 }
 
 Ref<Material> MeshDataInstance::get_material() {
@@ -71,7 +76,17 @@ void MeshDataInstance::set_material(const Ref<Material> &mat) {
 	_material = mat;
 
 	setup_material_texture();
-	refresh();
+	queue_refresh();
+}
+
+bool MeshDataInstance::get_cluster_culling() const {
+	return _cluster_culling;
+}
+void MeshDataInstance::set_cluster_culling(const bool value) {
+	_cluster_culling = value;
+
+	set_process_internal(_cluster_culling);
+	queue_refresh();
 }
 
 AABB MeshDataInstance::get_aabb() const {
@@ -83,46 +98,169 @@ AABB MeshDataInstance::get_aabb() const {
 }
 
 Vector<Face3> MeshDataInstance::get_faces(uint32_t p_usage_flags) const {
-	Vector<Face3> faces;
+	if (!(p_usage_flags & (FACES_SOLID | FACES_ENCLOSING))) {
+		return Vector<Face3>();
+	}
 
-	if (_mesh.is_valid()) {
-		Array arrs = _mesh->get_array_const();
+	if (!_mesh.is_valid()) {
+		return Vector<Face3>();
+	}
 
-		if (arrs.size() != Mesh::ARRAY_MAX) {
-			return faces;
-		}
+	//Cached by the resource, so this only copies a reference
+	return _mesh->get_faces();
+}
 
-		Vector<Vector3> vertices = arrs[Mesh::ARRAY_VERTEX];
-		Vector<int> indices = arrs[Mesh::ARRAY_INDEX];
+static Vector<MDRSnap::Target> _make_snap_targets(const Array &p_targets) {
+	Vector<MDRSnap::Target> targets;
 
-		int ts = indices.size() / 3;
-		faces.resize(ts);
+	for (int i = 0; i < p_targets.size(); ++i) {
+		MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(p_targets[i]);
 
-		Face3 *w = faces.ptrw();
-		const Vector3 *rv = vertices.ptr();
-		//const int *ri = indices.ptr();
+		ERR_CONTINUE(!mdi || !mdi->is_inside_tree());
 
-		for (int i = 0; i < ts; i++) {
-			int im3 = (i * 3);
+		Ref<MeshDataResource> mesh = mdi->get_mesh_data();
 
-			for (int j = 0; j < 3; j++) {
-				w[i].vertex[j] = rv[indices[im3 + j]];
-			}
+		if (mesh.is_valid()) {
+			targets.push_back(MDRSnap::make_target(mesh, mdi->get_global_transform()));
 		}
 	}
 
-	return faces;
+	return targets;
+}
+
+HashMap<ObjectID, Vector<ObjectID>> MeshDataInstance::_pending_snaps;
+bool MeshDataInstance::_pending_snaps_queued = false;
+
+void MeshDataInstance::snap() {
+	if (!is_inside_tree()) {
+		return;
+	}
+
+	Node *parent = get_parent();
+
+	if (!parent) {
+		return;
+	}
+
+	Vector<MDRSnap::Target> targets = _get_sibling_snap_targets(parent, this);
+
+	if (targets.size() == 0) {
+		return;
+	}
+
+	Transform t = get_global_transform();
+	Vector3 point;
+
+	if (MDRSnap::snap_point(targets, t.origin, _get_global_snap_axis(), point)) {
+		t.origin = point;
+		set_global_transform(t);
+	}
+}
+
+int MeshDataInstance::snap_instances(const Array &p_instances, const Array &p_targets) {
+	Vector<MeshDataInstance *> instances;
+
+	for (int i = 0; i < p_instances.size(); ++i) {
+		MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(p_instances[i]);
+
+		ERR_CONTINUE(!mdi || !mdi->is_inside_tree());
+
+		instances.push_back(mdi);
+	}
+
+	return _snap_instances(instances, _make_snap_targets(p_targets));
+}
+
+Array MeshDataInstance::snap_transforms(const Array &p_transforms, const Vector3 &p_axis, const Array &p_targets) {
+	Vector<MDRSnap::Target> targets = _make_snap_targets(p_targets);
+
+	Vector<Vector3> points;
+	Vector<Vector3> axes;
+	points.resize(p_transforms.size());
+	axes.resize(p_transforms.size());
+
+	Vector3 *pw = points.ptrw();
+	Vector3 *aw = axes.ptrw();
+
+	for (int i = 0; i < p_transforms.size(); ++i) {
+		Transform t = p_transforms[i];
+
+		pw[i] = t.origin;
+		aw[i] = p_axis;
+	}
+
+	MDRSnap::snap_points(targets, pw, axes.ptr(), points.size());
+
+	Array transforms;
+	transforms.resize(p_transforms.size());
+
+	for (int i = 0; i < p_transforms.size(); ++i) {
+		Transform t = p_transforms[i];
+		t.origin = pw[i];
+
+		transforms[i] = t;
+	}
+
+	return transforms;
+}
+
+void MeshDataInstance::queue_refresh() {
+	//Entering the tree refreshes anyway
+	if (_dirty || !is_inside_tree()) {
+		return;
+	}
+
+	_dirty = true;
+
+	callable_mp(this, &MeshDataInstance::_flush_refresh).call_deferred();
 }
 
 void MeshDataInstance::refresh() {
+	_dirty = false;
+
 	if (!is_inside_tree()) {
 		return;
 	}
 
+	_cluster_surface = RS::SurfaceData();
+	_cluster_visibility.clear();
+	_cluster_submitted_triangle_count = 0;
+
+	if (_static_batch) {
+		free_meshes();
+
+		_static_batch->update_instance(this, true);
+		return;
+	}
+
+	//Unless the surface has to change per instance, the resource's mesh is used
+	if (_mesh.is_valid() && !(_cluster_culling && _mesh->get_cluster_count() > 0)) {
+		if (_shared_mesh != _mesh) {
+			free_meshes();
+
+			_shared_mesh = _mesh;
+			_mesh_rid = _shared_mesh->acquire_mesh_rid();
+			_shared_mesh->connect("mesh_rid_updated", callable_mp(this, &MeshDataInstance::_apply_shared_material));
+
+			RS::get_singleton()->instance_set_base(get_instance(), _mesh_rid);
+		} else {
+			_shared_mesh->get_mesh_rid();
+		}
+
+		_apply_shared_material();
+
+		return;
+	}
+
+	if (_shared_mesh.is_valid()) {
+		free_meshes();
+	}
+
 	if (_mesh_rid == RID()) {
 		_mesh_rid = RS::get_singleton()->mesh_create();
 
 		RS::get_singleton()->instance_set_base(get_instance(), _mesh_rid);
+		RS::get_singleton()->instance_set_surface_override_material(get_instance(), 0, RID());
 	}
 
 	RS::get_singleton()->mesh_clear(_mesh_rid);
@@ -131,76 +269,323 @@ void MeshDataInstance::refresh() {
 		return;
 	}
 
-	Array arr = _mesh->get_array();
-
-	if (arr.size() != Mesh::ARRAY_MAX) {
+	if (_mesh->get_vertices().size() == 0) {
 		return;
 	}
 
-	Vector<Vector3> vertices = arr[Mesh::ARRAY_VERTEX];
+	RS::SurfaceData surface;
+
+	//The RenderingServer selects the lod based on the screen space error
+	Error err = RS::get_singleton()->mesh_create_surface_data_from_arrays(&surface, RS::PRIMITIVE_TRIANGLES, _mesh->get_array(), Array(), _mesh->get_surface_lods());
+	ERR_FAIL_COND(err != OK);
+
+	_add_surface(surface);
+
+	if (_cluster_culling && _mesh->get_cluster_count() > 0) {
+		//Kept around, so the surface can be rebuilt without encoding the vertices again
+		_cluster_surface = surface;
+		_cluster_submitted_triangle_count = _mesh->get_index_count() / 3;
+
+		_cluster_visibility.resize(_mesh->get_cluster_count());
+		_cluster_visibility.fill(1);
+	}
+}
 
-	if (vertices.size() == 0) {
+void MeshDataInstance::update_cluster_culling() {
+	if (!is_inside_tree() || _cluster_surface.index_count == 0 || _mesh_rid == RID() || _shared_mesh.is_valid()) {
 		return;
 	}
 
-	RS::get_singleton()->mesh_add_surface_from_arrays(_mesh_rid, RS::PRIMITIVE_TRIANGLES, arr);
+	Camera3D *camera = get_viewport()->get_camera_3d();
 
-	if (_material.is_valid()) {
-		RS::get_singleton()->mesh_surface_set_material(_mesh_rid, 0, _material->get_rid());
+	if (!camera) {
+		return;
 	}
-}
 
-void MeshDataInstance::setup_material_texture() {
-	if (!is_inside_tree()) {
+	const Vector<MDRCluster> &clusters = _mesh->get_clusters();
+
+	if (clusters.size() != _cluster_visibility.size()) {
 		return;
 	}
 
-	if (!_texture.is_valid()) {
-		if (_material.is_valid()) {
-			Ref<SpatialMaterial> sm = _material;
+	//The test is done in the mesh's space, this way it stays exact with non uniform scales too
+	Transform inverse = get_global_transform().affine_inverse();
 
-			if (!sm.is_valid()) {
-				return;
-			}
+	Vector<Plane> planes = camera->get_frustum();
+	Plane *pw = planes.ptrw();
+
+	for (int i = 0; i < planes.size(); ++i) {
+		pw[i] = inverse.xform(pw[i]);
+	}
+
+	Vector3 camera_position = inverse.xform(camera->get_global_transform().origin);
+	bool backface_test = camera->get_projection() == Camera3D::PROJECTION_PERSPECTIVE;
+
+	//Clusters that show up need a rebuild right away, hidden ones only cost some overdraw until
+	//enough of them pile up
+	bool rebuild = false;
+	int hidden_triangle_count = 0;
+	int visible_triangle_count = 0;
+	uint8_t *vw = _cluster_visibility.ptrw();
 
-			sm->set_texture(SpatialMaterial::TEXTURE_ALBEDO, _texture);
+	for (int i = 0; i < clusters.size(); ++i) {
+		const MDRCluster &c = clusters[i];
+
+		bool visible = MDRClusterBuilder::is_visible(c, planes.ptr(), planes.size(), camera_position, backface_test);
+		bool submitted = vw[i] & 1;
+
+		vw[i] = (submitted ? 1 : 0) | (visible ? 2 : 0);
+
+		if (visible) {
+			visible_triangle_count += c.triangle_count;
+
+			if (!submitted) {
+				rebuild = true;
+			}
+		} else if (submitted) {
+			hidden_triangle_count += c.triangle_count;
 		}
+	}
+
+	if (!rebuild && hidden_triangle_count * 100 <= _cluster_submitted_triangle_count * CLUSTER_CULLING_REBUILD_PERCENT) {
+		return;
+	}
+
+	for (int i = 0; i < clusters.size(); ++i) {
+		vw[i] >>= 1;
+	}
+
+	_cluster_submitted_triangle_count = visible_triangle_count;
+
+	RS::get_singleton()->mesh_clear(_mesh_rid);
 
+	if (visible_triangle_count == 0) {
 		return;
-	} else {
-		Ref<SpatialMaterial> sm = _material;
+	}
+
+	if (visible_triangle_count * 3 == _cluster_surface.index_count) {
+		_add_surface(_cluster_surface);
+		return;
+	}
 
-		if (!sm.is_valid()) {
-			return;
+	//The clusters own contiguous triangle ranges, so these get copied as is, in whatever width the RenderingServer picked
+	int index_size = _cluster_surface.index_data.size() / _cluster_surface.index_count;
+
+	Vector<uint8_t> index_data;
+	index_data.resize(visible_triangle_count * 3 * index_size);
+	uint8_t *iw = index_data.ptrw();
+	const uint8_t *ir = _cluster_surface.index_data.ptr();
+
+	for (int i = 0; i < clusters.size(); ++i) {
+		if (!vw[i]) {
+			continue;
 		}
 
-#if TEXTURE_PACKER_PRESENT
-		Ref<PackerImageResource> r = _texture;
+		const MDRCluster &c = clusters[i];
+		int size = c.triangle_count * 3 * index_size;
 
-		if (r.is_valid()) {
-			Ref<Image> i = r->get_data();
+		memcpy(iw, ir + c.triangle_offset * 3 * index_size, size);
+		iw += size;
+	}
 
-			Ref<ImageTexture> tex;
-			tex.instantiate();
-#if VERSION_MAJOR < 4
-			tex->create_from_image(i, 0);
-#else
-			tex->create_from_image(i);
-#endif
+	RS::SurfaceData surface = _cluster_surface;
+	surface.index_data = index_data;
+	surface.index_count = visible_triangle_count * 3;
+	//The lods index the whole mesh, so they can't be used with a partial index buffer
+	surface.lods.clear();
+
+	_add_surface(surface);
+}
+
+void MeshDataInstance::_flush_refresh() {
+	//Could have been refreshed directly since it was queued
+	if (_dirty) {
+		refresh();
+	}
+}
+
+//The shared mesh's surface can be uploaded later, which drops the override, so this runs again when that happens
+void MeshDataInstance::_apply_shared_material() {
+	RS::get_singleton()->instance_set_surface_override_material(get_instance(), 0, _material.is_valid() ? _material->get_rid() : RID());
+}
+
+MeshDataStaticBatch *MeshDataInstance::_find_static_batch() const {
+	for (Node *n = get_parent(); n; n = n->get_parent()) {
+		MeshDataStaticBatch *batch = Object::cast_to<MeshDataStaticBatch>(n);
+
+		if (batch) {
+			return batch;
+		}
+	}
+
+	return nullptr;
+}
+
+//Instances that snap themselves are not targets, this way the order they enter the tree in doesn't matter
+Vector<MDRSnap::Target> MeshDataInstance::_get_sibling_snap_targets(Node *p_parent, const MeshDataInstance *p_exclude) {
+	Vector<MDRSnap::Target> targets;
+
+	for (int i = 0; i < p_parent->get_child_count(); ++i) {
+		MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(p_parent->get_child(i));
+
+		if (!mdi || mdi == p_exclude || mdi->get_snap_to_mesh() || !mdi->is_inside_tree()) {
+			continue;
+		}
+
+		Ref<MeshDataResource> mesh = mdi->get_mesh_data();
+
+		if (mesh.is_valid()) {
+			targets.push_back(MDRSnap::make_target(mesh, mdi->get_global_transform()));
+		}
+	}
+
+	return targets;
+}
+
+int MeshDataInstance::_snap_instances(const Vector<MeshDataInstance *> &p_instances, const Vector<MDRSnap::Target> &p_targets) {
+	Vector<Vector3> points;
+	Vector<Vector3> axes;
 
-			if (sm.is_valid()) {
-				sm->set_texture(SpatialMaterial::TEXTURE_ALBEDO, tex);
+	for (int i = 0; i < p_instances.size(); ++i) {
+		points.push_back(p_instances[i]->get_global_transform().origin);
+		axes.push_back(p_instances[i]->_get_global_snap_axis());
+	}
+
+	int snapped_count = MDRSnap::snap_points(p_targets, points.ptrw(), axes.ptr(), points.size());
+
+	for (int i = 0; i < p_instances.size(); ++i) {
+		Transform t = p_instances[i]->get_global_transform();
+
+		if (t.origin != points[i]) {
+			t.origin = points[i];
+			p_instances[i]->set_global_transform(t);
+		}
+	}
+
+	return snapped_count;
+}
+
+void MeshDataInstance::_queue_snap() {
+	Node *parent = get_parent();
+
+	if (_snap_queued || !parent) {
+		return;
+	}
+
+	_snap_queued = true;
+	_pending_snaps[parent->get_instance_id()].push_back(get_instance_id());
+
+	if (!_pending_snaps_queued) {
+		_pending_snaps_queued = true;
+		callable_mp_static(&MeshDataInstance::_flush_pending_snaps).call_deferred();
+	}
+}
+
+//Every instance that entered the tree since the last flush is snapped in one batch per parent,
+//so the targets are only gathered once instead of once per instance
+void MeshDataInstance::_flush_pending_snaps() {
+	HashMap<ObjectID, Vector<ObjectID>> pending = _pending_snaps;
+
+	_pending_snaps.clear();
+	_pending_snaps_queued = false;
+
+	for (const KeyValue<ObjectID, Vector<ObjectID>> &E : pending) {
+		Node *parent = Object::cast_to<Node>(ObjectDB::get_instance(E.key));
+		Vector<MeshDataInstance *> instances;
+
+		for (int i = 0; i < E.value.size(); ++i) {
+			MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(ObjectDB::get_instance(E.value[i]));
+
+			if (!mdi) {
+				continue;
 			}
 
-			return;
+			mdi->_snap_queued = false;
+
+			if (parent && mdi->is_inside_tree() && mdi->get_parent() == parent && mdi->get_snap_to_mesh()) {
+				instances.push_back(mdi);
+			}
+		}
+
+		if (instances.size() == 0) {
+			continue;
+		}
+
+		Vector<MDRSnap::Target> targets = _get_sibling_snap_targets(parent, nullptr);
+
+		if (targets.size() > 0) {
+			_snap_instances(instances, targets);
 		}
+	}
+}
+
+Vector3 MeshDataInstance::_get_global_snap_axis() const {
+	//The axis is in the parent's space, same as the transform
+	Spatial *parent = get_parent_node_3d();
+
+	if (parent) {
+		return parent->get_global_transform().basis.xform(_snap_axis);
+	}
+
+	return _snap_axis;
+}
+
+void MeshDataInstance::_add_surface(const RS::SurfaceData &p_surface) {
+	RS::get_singleton()->mesh_add_surface(_mesh_rid, p_surface);
+
+	if (_material.is_valid()) {
+		RS::get_singleton()->mesh_surface_set_material(_mesh_rid, 0, _material->get_rid());
+	}
+}
+
+void MeshDataInstance::setup_material_texture() {
+	if (!is_inside_tree()) {
+		return;
+	}
+
+	if (!_material.is_valid()) {
+		return;
+	}
+
+	Ref<Texture> texture = _texture;
+
+#if TEXTURE_PACKER_PRESENT
+	Ref<PackerImageResource> r = _texture;
+
+	if (r.is_valid()) {
+		texture = MDRTextureCache::get_texture(r);
+	}
 #endif
 
-		sm->set_texture(SpatialMaterial::TEXTURE_ALBEDO, _texture);
+	//Cached materials are shared with every other prop, so the one for the new texture is used instead
+	Ref<Material> base;
+
+	if (MDRMaterialCache::get_cached_base(_material, base)) {
+		_material = MDRMaterialCache::get_material(texture, base);
+		return;
 	}
+
+	Ref<SpatialMaterial> sm = _material;
+
+	if (!sm.is_valid()) {
+		return;
+	}
+
+	sm->set_texture(SpatialMaterial::TEXTURE_ALBEDO, texture);
 }
 
 void MeshDataInstance::free_meshes() {
+	if (_shared_mesh.is_valid()) {
+		RS::get_singleton()->instance_set_base(get_instance(), RID());
+
+		_shared_mesh->disconnect("mesh_rid_updated", callable_mp(this, &MeshDataInstance::_apply_shared_material));
+		_shared_mesh->release_mesh_rid();
+		_shared_mesh.unref();
+		_mesh_rid = RID();
+
+		return;
+	}
+
 	if (_mesh_rid != RID()) {
 		RS::get_singleton()->free(_mesh_rid);
 		_mesh_rid = RID();
@@ -211,6 +596,10 @@ MeshDataInstance::MeshDataInstance() {
 	_dirty = false;
 	_snap_to_mesh = false;
 	_snap_axis = Vector3(0, -1, 0);
+	_snap_queued = false;
+	_cluster_culling = false;
+	_cluster_submitted_triangle_count = 0;
+	_static_batch = nullptr;
 
 #if VERSION_MINOR >= 4
 	set_portal_mode(PORTAL_MODE_GLOBAL);
@@ -226,15 +615,43 @@ MeshDataInstance::~MeshDataInstance() {
 void MeshDataInstance::_notification(int p_what) {
 	switch (p_what) {
 		case NOTIFICATION_ENTER_TREE: {
+			_static_batch = _find_static_batch();
+
+			if (_static_batch) {
+				_static_batch->add_instance(this);
+			}
+
 			setup_material_texture();
 			refresh();
 
+			//Deferred, so the targets spawned in the same batch are in the tree too
+			if (_snap_to_mesh) {
+				_queue_snap();
+			}
+
 			break;
 		}
 		case NOTIFICATION_EXIT_TREE: {
+			if (_static_batch) {
+				_static_batch->remove_instance(this);
+				_static_batch = nullptr;
+			}
+
 			free_meshes();
 			break;
 		}
+		case NOTIFICATION_INTERNAL_PROCESS: {
+			update_cluster_culling();
+			break;
+		}
+		case NOTIFICATION_TRANSFORM_CHANGED:
+		case NOTIFICATION_VISIBILITY_CHANGED: {
+			if (_static_batch) {
+				_static_batch->update_instance(this, false);
+			}
+
+			break;
+		}
 			/*
 		case NOTIFICATION_TRANSFORM_CHANGED: {
 			VisualServer *vs = VisualServer::get_singleton();
@@ -267,7 +684,17 @@ void MeshDataInstance::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_material", "value"), &MeshDataInstance::set_material);
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "material", PROPERTY_HINT_RESOURCE_TYPE, "Material"), "set_material", "get_material");
 
+	ClassDB::bind_method(D_METHOD("get_cluster_culling"), &MeshDataInstance::get_cluster_culling);
+	ClassDB::bind_method(D_METHOD("set_cluster_culling", "value"), &MeshDataInstance::set_cluster_culling);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "cluster_culling"), "set_cluster_culling", "get_cluster_culling");
+
+	ClassDB::bind_method(D_METHOD("snap"), &MeshDataInstance::snap);
+	ClassDB::bind_static_method("MeshDataInstance", D_METHOD("snap_instances", "instances", "targets"), &MeshDataInstance::snap_instances);
+	ClassDB::bind_static_method("MeshDataInstance", D_METHOD("snap_transforms", "transforms", "axis", "targets"), &MeshDataInstance::snap_transforms);
+
 	ClassDB::bind_method(D_METHOD("refresh"), &MeshDataInstance::refresh);
+	ClassDB::bind_method(D_METHOD("queue_refresh"), &MeshDataInstance::queue_refresh);
+	ClassDB::bind_method(D_METHOD("update_cluster_culling"), &MeshDataInstance::update_cluster_culling);
 
 	ADD_SIGNAL(MethodInfo("mesh_data_resource_changed", PropertyInfo(Variant::OBJECT, "mdr", PROPERTY_HINT_RESOURCE_TYPE, "MeshDataResource")));
 }
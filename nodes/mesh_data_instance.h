@@ -39,13 +39,18 @@ SOFTWARE.
 #include "core/math/vector3.h"
 
 #include "../mesh_data_resource.h"
+#include "../utils/mdr_snap.h"
 
 class PropInstance;
+class MeshDataStaticBatch;
 
 class MeshDataInstance : public GeometryInstance3D {
 	GDCLASS(MeshDataInstance, GeometryInstance3D);
 
 public:
+	//Hidden clusters stay submitted until they make up this percent of the submitted triangles
+	static const int CLUSTER_CULLING_REBUILD_PERCENT = 25;
+
 	bool get_snap_to_mesh() const;
 	void set_snap_to_mesh(const bool value);
 
@@ -61,12 +66,27 @@ public:
 	Ref<Material> get_material();
 	void set_material(const Ref<Material> &mat);
 
+	//Only submits the clusters of the mesh that can be visible from the current camera
+	bool get_cluster_culling() const;
+	void set_cluster_culling(const bool value);
+
 	AABB get_aabb() const;
 	Vector<Face3> get_faces(uint32_t p_usage_flags) const;
 
+	//Projects the instance along snap_axis onto the sibling MeshDataInstances that don't snap themselves
+	void snap();
+
+	//Batched versions, the targets are MeshDataInstances. Every instance is projected along its own snap_axis.
+	static int snap_instances(const Array &p_instances, const Array &p_targets);
+	//The transforms and p_axis are in global space
+	static Array snap_transforms(const Array &p_transforms, const Vector3 &p_axis, const Array &p_targets);
+
+	//Every change within a frame is applied with one deferred refresh
+	void queue_refresh();
 	void refresh();
 	void setup_material_texture();
 	void free_meshes();
+	void update_cluster_culling();
 
 	MeshDataInstance();
 	~MeshDataInstance();
@@ -75,15 +95,43 @@ protected:
 	void _notification(int p_what);
 	static void _bind_methods();
 
+	void _flush_refresh();
+	MeshDataStaticBatch *_find_static_batch() const;
+	void _apply_shared_material();
+	void _add_surface(const RS::SurfaceData &p_surface);
+	Vector3 _get_global_snap_axis() const;
+	void _queue_snap();
+
+	static Vector<MDRSnap::Target> _get_sibling_snap_targets(Node *p_parent, const MeshDataInstance *p_exclude);
+	static int _snap_instances(const Vector<MeshDataInstance *> &p_instances, const Vector<MDRSnap::Target> &p_targets);
+	static void _flush_pending_snaps();
+
+	//Parent id -> instances that snap once the current frame's instances are all in the tree
+	static HashMap<ObjectID, Vector<ObjectID>> _pending_snaps;
+	static bool _pending_snaps_queued;
+
 private:
 	bool _dirty;
 	bool _snap_to_mesh;
 	Vector3 _snap_axis;
+	bool _snap_queued;
 	Ref<MeshDataResource> _mesh;
 	Ref<Texture> _texture;
 	Ref<Material> _material;
 
+	bool _cluster_culling;
+	//The whole mesh, encoded once, only the index data gets replaced when the visible clusters change
+	RS::SurfaceData _cluster_surface;
+	//Bit 0: submitted, bit 1: visible in the last test
+	Vector<uint8_t> _cluster_visibility;
+	int _cluster_submitted_triangle_count;
+
+	//Set while _mesh_rid is the resource's shared mesh
+	Ref<MeshDataResource> _shared_mesh;
 	RID _mesh_rid;
+
+	//The closest ancestor batch, it draws the mesh instead while this is set
+	MeshDataStaticBatch *_static_batch;
 };
 
 #endif
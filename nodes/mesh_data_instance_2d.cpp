@@ -24,15 +24,15 @@ void MeshDataInstance2D::set_mesh_data(const Ref<MeshDataResource> &mesh) {
 	}
 
 	if (_mesh.is_valid()) {
-		_mesh->disconnect("changed", Callable(this, "refresh"));
+		_mesh->disconnect("changed", Callable(this, "queue_refresh"));
 	}
 
 	_mesh = mesh;
 
-	refresh();
+	queue_refresh();
 
 	if (_mesh.is_valid()) {
-		_mesh->connect("changed", Callable(this, "refresh"));
+		_mesh->connect("changed", Callable(this, "queue_refresh"));
 	}
 
 	emit_signal("mesh_data_resource_changed");
@@ -50,7 +50,8 @@ void MeshDataInstance2D::set_texture(const Ref<Texture> &texture) {
 
 	emit_signal("texture_changed");
 	//_change_notify("texture");
-	refresh();
+	//The texture is only used when drawing, the mesh doesn't need to change
+	queue_redraw();
 }
 
 Ref<Texture> MeshDataInstance2D::get_normal_map() {
@@ -63,35 +64,51 @@ void MeshDataInstance2D::set_normal_map(const Ref<Texture> &texture) {
 
 	_normal_map = texture;
 
-	refresh();
+	queue_redraw();
+}
+
+void MeshDataInstance2D::queue_refresh() {
+	//Entering the tree refreshes anyway
+	if (_dirty || !is_inside_tree()) {
+		return;
+	}
+
+	_dirty = true;
+
+	callable_mp(this, &MeshDataInstance2D::_flush_refresh).call_deferred();
 }
 
 void MeshDataInstance2D::refresh() {
+	_dirty = false;
+
 	if (!is_inside_tree()) {
 		return;
 	}
 
+	queue_redraw();
+
 	RenderingServer::get_singleton()->mesh_clear(_mesh_rid);
 
 	if (!_mesh.is_valid()) {
 		return;
 	}
 
-	Array arr = _mesh->get_array();
-
-	if (arr.size() != Mesh::ARRAY_MAX) {
+	if (_mesh->get_vertices_2d().size() == 0) {
 		return;
 	}
 
-	Vector<Vector2> vertices = arr[Mesh::ARRAY_VERTEX];
-
-	if (vertices.size() == 0) {
-		return;
-	}
+	Array arr = _mesh->get_array();
 
 	RenderingServer::get_singleton()->mesh_add_surface_from_arrays(_mesh_rid, RenderingServer::PRIMITIVE_TRIANGLES, arr);
 }
 
+void MeshDataInstance2D::_flush_refresh() {
+	//Could have been refreshed directly since it was queued
+	if (_dirty) {
+		refresh();
+	}
+}
+
 #ifdef TOOLS_ENABLED
 Rect2 MeshDataInstance2D::_edit_get_rect() const {
 	if (_mesh.is_valid()) {
@@ -108,6 +125,7 @@ bool MeshDataInstance2D::_edit_use_rect() const {
 #endif
 
 MeshDataInstance2D::MeshDataInstance2D() {
+	_dirty = false;
 	_mesh_rid = RenderingServer::get_singleton()->mesh_create();
 }
 MeshDataInstance2D::~MeshDataInstance2D() {
@@ -150,6 +168,7 @@ void MeshDataInstance2D::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "normal_map", PROPERTY_HINT_RESOURCE_TYPE, "Texture"), "set_normal_map", "get_normal_map");
 
 	ClassDB::bind_method(D_METHOD("refresh"), &MeshDataInstance2D::refresh);
+	ClassDB::bind_method(D_METHOD("queue_refresh"), &MeshDataInstance2D::queue_refresh);
 
 	ADD_SIGNAL(MethodInfo("mesh_data_resource_changed"));
 	ADD_SIGNAL(MethodInfo("texture_changed"));
@@ -47,6 +47,8 @@ public:
 	Ref<Texture> get_normal_map();
 	void set_normal_map(const Ref<Texture> &texture);
 
+	//Every change within a frame is applied with one deferred refresh
+	void queue_refresh();
 	void refresh();
 
 #ifdef TOOLS_ENABLED
@@ -61,7 +63,10 @@ protected:
 	void _notification(int p_what);
 	static void _bind_methods();
 
+	void _flush_refresh();
+
 private:
+	bool _dirty;
 	Ref<MeshDataResource> _mesh;
 	Ref<Texture> _texture;
 	Ref<Texture> _normal_map;
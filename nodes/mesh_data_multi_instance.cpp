@@ -0,0 +1,569 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mesh_data_multi_instance.h"
+
+#include "scene/resources/world_3d.h"
+#include "servers/physics_server_3d.h"
+
+Ref<MeshDataResource> MeshDataMultiInstance::get_mesh_data() {
+	return _mesh;
+}
+void MeshDataMultiInstance::set_mesh_data(const Ref<MeshDataResource> &mesh) {
+	if (_mesh.is_valid()) {
+		_mesh->disconnect("changed", Callable(this, "queue_refresh"));
+	}
+
+	_mesh = mesh;
+
+	queue_refresh();
+
+	if (_mesh.is_valid()) {
+		_mesh->connect("changed", Callable(this, "queue_refresh"));
+	}
+}
+
+bool MeshDataMultiInstance::get_use_colors() const {
+	return _use_colors;
+}
+void MeshDataMultiInstance::set_use_colors(const bool value) {
+	if (_use_colors == value) {
+		return;
+	}
+
+	bool old_use_colors = _use_colors;
+	_use_colors = value;
+	_resize_buffer(_instance_count, old_use_colors, _use_custom_data);
+
+	queue_refresh();
+}
+
+bool MeshDataMultiInstance::get_use_custom_data() const {
+	return _use_custom_data;
+}
+void MeshDataMultiInstance::set_use_custom_data(const bool value) {
+	if (_use_custom_data == value) {
+		return;
+	}
+
+	bool old_use_custom_data = _use_custom_data;
+	_use_custom_data = value;
+	_resize_buffer(_instance_count, _use_colors, old_use_custom_data);
+
+	queue_refresh();
+}
+
+int MeshDataMultiInstance::get_instance_count() const {
+	return _instance_count;
+}
+void MeshDataMultiInstance::set_instance_count(const int value) {
+	ERR_FAIL_COND(value < 0);
+
+	_resize_buffer(value, _use_colors, _use_custom_data);
+
+	queue_refresh();
+}
+
+PoolRealArray MeshDataMultiInstance::get_transforms() const {
+	PoolRealArray transforms;
+	transforms.resize(_instance_count * TRANSFORM_STRIDE);
+
+	float *w = transforms.ptrw();
+	const float *r = _buffer.ptr();
+	int stride = _get_stride();
+
+	for (int i = 0; i < _instance_count; ++i) {
+		memcpy(w + i * TRANSFORM_STRIDE, r + i * stride, sizeof(float) * TRANSFORM_STRIDE);
+	}
+
+	return transforms;
+}
+void MeshDataMultiInstance::set_transforms(const PoolRealArray &p_transforms) {
+	ERR_FAIL_COND(p_transforms.size() % TRANSFORM_STRIDE != 0);
+
+	//Keeps the colors and custom data of the instances that remain
+	_resize_buffer(p_transforms.size() / TRANSFORM_STRIDE, _use_colors, _use_custom_data);
+
+	float *w = _buffer.ptrw();
+	const float *r = p_transforms.ptr();
+	int stride = _get_stride();
+
+	for (int i = 0; i < _instance_count; ++i) {
+		memcpy(w + i * stride, r + i * TRANSFORM_STRIDE, sizeof(float) * TRANSFORM_STRIDE);
+	}
+
+	queue_refresh();
+}
+
+Transform MeshDataMultiInstance::get_instance_transform(const int p_index) const {
+	ERR_FAIL_INDEX_V(p_index, _instance_count, Transform());
+
+	return _read_transform(_buffer.ptr() + p_index * _get_stride());
+}
+void MeshDataMultiInstance::set_instance_transform(const int p_index, const Transform &p_transform) {
+	ERR_FAIL_INDEX(p_index, _instance_count);
+
+	_write_transform(_buffer.ptrw() + p_index * _get_stride(), p_transform);
+
+	//A full refresh is pending anyway
+	if (_dirty || _multimesh == RID()) {
+		return;
+	}
+
+	RS::get_singleton()->multimesh_instance_set_transform(_multimesh, p_index, p_transform);
+
+	if (_mesh.is_valid()) {
+		_aabb.merge_with(p_transform.xform(_mesh->get_aabb()));
+		update_gizmos();
+	}
+
+	if (_body != RID()) {
+		int shape_count = _mesh->get_collision_shape_count();
+
+		for (int i = 0; i < shape_count; ++i) {
+			PhysicsServer3D::get_singleton()->body_set_shape_transform(_body, p_index * shape_count + i, p_transform * _mesh->get_collision_shape_offset(i));
+		}
+	}
+}
+
+Color MeshDataMultiInstance::get_instance_color(const int p_index) const {
+	ERR_FAIL_INDEX_V(p_index, _instance_count, Color());
+	ERR_FAIL_COND_V(!_use_colors, Color());
+
+	const float *r = _buffer.ptr() + p_index * _get_stride() + TRANSFORM_STRIDE;
+
+	return Color(r[0], r[1], r[2], r[3]);
+}
+void MeshDataMultiInstance::set_instance_color(const int p_index, const Color &p_color) {
+	ERR_FAIL_INDEX(p_index, _instance_count);
+	ERR_FAIL_COND_MSG(!_use_colors, "use_colors needs to be enabled!");
+
+	float *w = _buffer.ptrw() + p_index * _get_stride() + TRANSFORM_STRIDE;
+
+	for (int i = 0; i < 4; ++i) {
+		w[i] = p_color.components[i];
+	}
+
+	if (!_dirty && _multimesh != RID()) {
+		RS::get_singleton()->multimesh_instance_set_color(_multimesh, p_index, p_color);
+	}
+}
+
+Color MeshDataMultiInstance::get_instance_custom_data(const int p_index) const {
+	ERR_FAIL_INDEX_V(p_index, _instance_count, Color());
+	ERR_FAIL_COND_V(!_use_custom_data, Color());
+
+	const float *r = _buffer.ptr() + p_index * _get_stride() + TRANSFORM_STRIDE + (_use_colors ? 4 : 0);
+
+	return Color(r[0], r[1], r[2], r[3]);
+}
+void MeshDataMultiInstance::set_instance_custom_data(const int p_index, const Color &p_custom_data) {
+	ERR_FAIL_INDEX(p_index, _instance_count);
+	ERR_FAIL_COND_MSG(!_use_custom_data, "use_custom_data needs to be enabled!");
+
+	float *w = _buffer.ptrw() + p_index * _get_stride() + TRANSFORM_STRIDE + (_use_colors ? 4 : 0);
+
+	for (int i = 0; i < 4; ++i) {
+		w[i] = p_custom_data.components[i];
+	}
+
+	if (!_dirty && _multimesh != RID()) {
+		RS::get_singleton()->multimesh_instance_set_custom_data(_multimesh, p_index, p_custom_data);
+	}
+}
+
+PoolRealArray MeshDataMultiInstance::get_buffer() const {
+	return _buffer;
+}
+void MeshDataMultiInstance::set_buffer(const PoolRealArray &p_buffer) {
+	int stride = _get_stride();
+
+	ERR_FAIL_COND_MSG(p_buffer.size() % stride != 0, "The buffer's size doesn't match use_colors and use_custom_data!");
+
+	_buffer = p_buffer;
+	_instance_count = p_buffer.size() / stride;
+
+	queue_refresh();
+}
+
+bool MeshDataMultiInstance::get_generate_collision() const {
+	return _generate_collision;
+}
+void MeshDataMultiInstance::set_generate_collision(const bool value) {
+	_generate_collision = value;
+
+	queue_refresh();
+}
+
+uint32_t MeshDataMultiInstance::get_collision_layer() const {
+	return _collision_layer;
+}
+void MeshDataMultiInstance::set_collision_layer(const uint32_t value) {
+	_collision_layer = value;
+
+	if (_body != RID()) {
+		PhysicsServer3D::get_singleton()->body_set_collision_layer(_body, _collision_layer);
+	}
+}
+
+uint32_t MeshDataMultiInstance::get_collision_mask() const {
+	return _collision_mask;
+}
+void MeshDataMultiInstance::set_collision_mask(const uint32_t value) {
+	_collision_mask = value;
+
+	if (_body != RID()) {
+		PhysicsServer3D::get_singleton()->body_set_collision_mask(_body, _collision_mask);
+	}
+}
+
+AABB MeshDataMultiInstance::get_aabb() const {
+	return _aabb;
+}
+
+Vector<Face3> MeshDataMultiInstance::get_faces(uint32_t p_usage_flags) const {
+	if (!(p_usage_flags & (FACES_SOLID | FACES_ENCLOSING)) || !_mesh.is_valid()) {
+		return Vector<Face3>();
+	}
+
+	Vector<Face3> mesh_faces = _mesh->get_faces();
+
+	Vector<Face3> faces;
+	faces.resize(mesh_faces.size() * _instance_count);
+
+	Face3 *w = faces.ptrw();
+	const Face3 *r = mesh_faces.ptr();
+	int stride = _get_stride();
+
+	for (int i = 0; i < _instance_count; ++i) {
+		Transform t = _read_transform(_buffer.ptr() + i * stride);
+
+		for (int j = 0; j < mesh_faces.size(); ++j) {
+			for (int k = 0; k < 3; ++k) {
+				w->vertex[k] = t.xform(r[j].vertex[k]);
+			}
+
+			++w;
+		}
+	}
+
+	return faces;
+}
+
+void MeshDataMultiInstance::queue_refresh() {
+	//Entering the tree refreshes anyway
+	if (_dirty || !is_inside_tree()) {
+		return;
+	}
+
+	_dirty = true;
+
+	callable_mp(this, &MeshDataMultiInstance::_flush_refresh).call_deferred();
+}
+
+void MeshDataMultiInstance::refresh() {
+	_dirty = false;
+
+	_update_aabb();
+
+	if (!is_inside_tree()) {
+		return;
+	}
+
+	if (_multimesh == RID()) {
+		_multimesh = RS::get_singleton()->multimesh_create();
+
+		RS::get_singleton()->instance_set_base(get_instance(), _multimesh);
+	}
+
+	if (_shared_mesh != _mesh) {
+		if (_shared_mesh.is_valid()) {
+			_shared_mesh->release_mesh_rid();
+		}
+
+		_shared_mesh = _mesh;
+
+		RS::get_singleton()->multimesh_set_mesh(_multimesh, _shared_mesh.is_valid() ? _shared_mesh->acquire_mesh_rid() : RID());
+	} else if (_shared_mesh.is_valid()) {
+		//Re-uploads the mesh if it changed
+		_shared_mesh->get_mesh_rid();
+	}
+
+	RS::get_singleton()->multimesh_allocate_data(_multimesh, _instance_count, RS::MULTIMESH_TRANSFORM_3D, _use_colors, _use_custom_data);
+
+	if (_instance_count > 0) {
+		RS::get_singleton()->multimesh_set_buffer(_multimesh, _buffer);
+	}
+
+	_update_collision();
+
+	update_gizmos();
+}
+
+MeshDataMultiInstance::MeshDataMultiInstance() {
+	_dirty = false;
+	_use_colors = false;
+	_use_custom_data = false;
+	_instance_count = 0;
+
+	_generate_collision = false;
+	_collision_layer = 1;
+	_collision_mask = 1;
+
+	set_notify_transform(true);
+}
+MeshDataMultiInstance::~MeshDataMultiInstance() {
+	_mesh.unref();
+}
+
+void MeshDataMultiInstance::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_ENTER_TREE: {
+			refresh();
+			break;
+		}
+		case NOTIFICATION_EXIT_TREE: {
+			_free_collision();
+			_free_multimesh();
+			break;
+		}
+		case NOTIFICATION_TRANSFORM_CHANGED: {
+			if (_body != RID()) {
+				PhysicsServer3D::get_singleton()->body_set_state(_body, PhysicsServer3D::BODY_STATE_TRANSFORM, get_global_transform());
+			}
+
+			break;
+		}
+	}
+}
+
+void MeshDataMultiInstance::_flush_refresh() {
+	//Could have been refreshed directly since it was queued
+	if (_dirty) {
+		refresh();
+	}
+}
+
+int MeshDataMultiInstance::_get_stride() const {
+	return TRANSFORM_STRIDE + (_use_colors ? 4 : 0) + (_use_custom_data ? 4 : 0);
+}
+
+void MeshDataMultiInstance::_resize_buffer(const int p_instance_count, const bool p_old_use_colors, const bool p_old_use_custom_data) {
+	int stride = _get_stride();
+	int old_stride = TRANSFORM_STRIDE + (p_old_use_colors ? 4 : 0) + (p_old_use_custom_data ? 4 : 0);
+	int copy_count = MIN(p_instance_count, _instance_count);
+
+	PoolRealArray buffer;
+	buffer.resize(p_instance_count * stride);
+	float *w = buffer.ptrw();
+	const float *r = _buffer.ptr();
+
+	for (int i = 0; i < p_instance_count; ++i) {
+		float *iw = w + i * stride;
+		const float *ir = r + i * old_stride;
+		bool copy = i < copy_count;
+
+		if (copy) {
+			memcpy(iw, ir, sizeof(float) * TRANSFORM_STRIDE);
+		} else {
+			_write_transform(iw, Transform());
+		}
+
+		iw += TRANSFORM_STRIDE;
+		ir += TRANSFORM_STRIDE;
+
+		//New colors default to white, new custom data to zero, same as the RenderingServer
+		if (_use_colors) {
+			for (int j = 0; j < 4; ++j) {
+				iw[j] = (copy && p_old_use_colors) ? ir[j] : 1;
+			}
+
+			iw += 4;
+		}
+
+		if (p_old_use_colors) {
+			ir += 4;
+		}
+
+		if (_use_custom_data) {
+			for (int j = 0; j < 4; ++j) {
+				iw[j] = (copy && p_old_use_custom_data) ? ir[j] : 0;
+			}
+		}
+	}
+
+	_buffer = buffer;
+	_instance_count = p_instance_count;
+}
+
+void MeshDataMultiInstance::_update_aabb() {
+	_aabb = AABB();
+
+	if (!_mesh.is_valid() || _instance_count == 0) {
+		return;
+	}
+
+	AABB mesh_aabb = _mesh->get_aabb();
+	const float *r = _buffer.ptr();
+	int stride = _get_stride();
+
+	_aabb = _read_transform(r).xform(mesh_aabb);
+
+	for (int i = 1; i < _instance_count; ++i) {
+		_aabb.merge_with(_read_transform(r + i * stride).xform(mesh_aabb));
+	}
+}
+
+void MeshDataMultiInstance::_update_collision() {
+	_free_collision();
+
+	if (!_generate_collision || !_mesh.is_valid() || !is_inside_tree()) {
+		return;
+	}
+
+	int shape_count = _mesh->get_collision_shape_count();
+
+	if (shape_count == 0 || _instance_count == 0) {
+		return;
+	}
+
+	PhysicsServer3D *ps = PhysicsServer3D::get_singleton();
+
+	_body = ps->body_create();
+	ps->body_set_mode(_body, PhysicsServer3D::BODY_MODE_STATIC);
+	ps->body_attach_object_instance_id(_body, get_instance_id());
+	ps->body_set_collision_layer(_body, _collision_layer);
+	ps->body_set_collision_mask(_body, _collision_mask);
+	ps->body_set_state(_body, PhysicsServer3D::BODY_STATE_TRANSFORM, get_global_transform());
+
+	const float *r = _buffer.ptr();
+	int stride = _get_stride();
+
+	//Shape i of instance j is at j * shape_count + i
+	for (int i = 0; i < _instance_count; ++i) {
+		Transform t = _read_transform(r + i * stride);
+
+		for (int j = 0; j < shape_count; ++j) {
+			Ref<Shape> shape = _mesh->get_collision_shape(j);
+
+			ERR_CONTINUE(!shape.is_valid());
+
+			ps->body_add_shape(_body, shape->get_rid(), t * _mesh->get_collision_shape_offset(j));
+		}
+	}
+
+	ps->body_set_space(_body, get_world_3d()->get_space());
+}
+
+void MeshDataMultiInstance::_free_collision() {
+	if (_body != RID()) {
+		PhysicsServer3D::get_singleton()->free(_body);
+		_body = RID();
+	}
+}
+
+void MeshDataMultiInstance::_free_multimesh() {
+	if (_multimesh != RID()) {
+		RS::get_singleton()->instance_set_base(get_instance(), RID());
+		RS::get_singleton()->free(_multimesh);
+		_multimesh = RID();
+	}
+
+	if (_shared_mesh.is_valid()) {
+		_shared_mesh->release_mesh_rid();
+		_shared_mesh.unref();
+	}
+}
+
+Transform MeshDataMultiInstance::_read_transform(const float *p_data) {
+	Transform t;
+
+	for (int i = 0; i < 3; ++i) {
+		t.basis.rows[i] = Vector3(p_data[i * 4], p_data[i * 4 + 1], p_data[i * 4 + 2]);
+		t.origin[i] = p_data[i * 4 + 3];
+	}
+
+	return t;
+}
+
+void MeshDataMultiInstance::_write_transform(float *r_data, const Transform &p_transform) {
+	for (int i = 0; i < 3; ++i) {
+		r_data[i * 4] = p_transform.basis.rows[i].x;
+		r_data[i * 4 + 1] = p_transform.basis.rows[i].y;
+		r_data[i * 4 + 2] = p_transform.basis.rows[i].z;
+		r_data[i * 4 + 3] = p_transform.origin[i];
+	}
+}
+
+void MeshDataMultiInstance::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_mesh_data"), &MeshDataMultiInstance::get_mesh_data);
+	ClassDB::bind_method(D_METHOD("set_mesh_data", "value"), &MeshDataMultiInstance::set_mesh_data);
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "mesh_data", PROPERTY_HINT_RESOURCE_TYPE, "MeshDataResource"), "set_mesh_data", "get_mesh_data");
+
+	//These have to be set before the buffer, as they determine its layout
+	ClassDB::bind_method(D_METHOD("get_use_colors"), &MeshDataMultiInstance::get_use_colors);
+	ClassDB::bind_method(D_METHOD("set_use_colors", "value"), &MeshDataMultiInstance::set_use_colors);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_colors"), "set_use_colors", "get_use_colors");
+
+	ClassDB::bind_method(D_METHOD("get_use_custom_data"), &MeshDataMultiInstance::get_use_custom_data);
+	ClassDB::bind_method(D_METHOD("set_use_custom_data", "value"), &MeshDataMultiInstance::set_use_custom_data);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "use_custom_data"), "set_use_custom_data", "get_use_custom_data");
+
+	ClassDB::bind_method(D_METHOD("get_instance_count"), &MeshDataMultiInstance::get_instance_count);
+	ClassDB::bind_method(D_METHOD("set_instance_count", "value"), &MeshDataMultiInstance::set_instance_count);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "instance_count", PROPERTY_HINT_RANGE, "0,16384,1,or_greater", PROPERTY_USAGE_EDITOR), "set_instance_count", "get_instance_count");
+
+	ClassDB::bind_method(D_METHOD("get_buffer"), &MeshDataMultiInstance::get_buffer);
+	ClassDB::bind_method(D_METHOD("set_buffer", "buffer"), &MeshDataMultiInstance::set_buffer);
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_FLOAT32_ARRAY, "buffer", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NO_EDITOR), "set_buffer", "get_buffer");
+
+	ClassDB::bind_method(D_METHOD("get_transforms"), &MeshDataMultiInstance::get_transforms);
+	ClassDB::bind_method(D_METHOD("set_transforms", "transforms"), &MeshDataMultiInstance::set_transforms);
+
+	ClassDB::bind_method(D_METHOD("get_instance_transform", "index"), &MeshDataMultiInstance::get_instance_transform);
+	ClassDB::bind_method(D_METHOD("set_instance_transform", "index", "transform"), &MeshDataMultiInstance::set_instance_transform);
+
+	ClassDB::bind_method(D_METHOD("get_instance_color", "index"), &MeshDataMultiInstance::get_instance_color);
+	ClassDB::bind_method(D_METHOD("set_instance_color", "index", "color"), &MeshDataMultiInstance::set_instance_color);
+
+	ClassDB::bind_method(D_METHOD("get_instance_custom_data", "index"), &MeshDataMultiInstance::get_instance_custom_data);
+	ClassDB::bind_method(D_METHOD("set_instance_custom_data", "index", "custom_data"), &MeshDataMultiInstance::set_instance_custom_data);
+
+	ADD_GROUP("Collision", "");
+
+	ClassDB::bind_method(D_METHOD("get_generate_collision"), &MeshDataMultiInstance::get_generate_collision);
+	ClassDB::bind_method(D_METHOD("set_generate_collision", "value"), &MeshDataMultiInstance::set_generate_collision);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "generate_collision"), "set_generate_collision", "get_generate_collision");
+
+	ClassDB::bind_method(D_METHOD("get_collision_layer"), &MeshDataMultiInstance::get_collision_layer);
+	ClassDB::bind_method(D_METHOD("set_collision_layer", "value"), &MeshDataMultiInstance::set_collision_layer);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "collision_layer", PROPERTY_HINT_LAYERS_3D_PHYSICS), "set_collision_layer", "get_collision_layer");
+
+	ClassDB::bind_method(D_METHOD("get_collision_mask"), &MeshDataMultiInstance::get_collision_mask);
+	ClassDB::bind_method(D_METHOD("set_collision_mask", "value"), &MeshDataMultiInstance::set_collision_mask);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "collision_mask", PROPERTY_HINT_LAYERS_3D_PHYSICS), "set_collision_mask", "get_collision_mask");
+
+	ClassDB::bind_method(D_METHOD("refresh"), &MeshDataMultiInstance::refresh);
+	ClassDB::bind_method(D_METHOD("queue_refresh"), &MeshDataMultiInstance::queue_refresh);
+
+	BIND_CONSTANT(TRANSFORM_STRIDE);
+}
@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MESH_DATA_MULTI_INSTANCE_H
+#define MESH_DATA_MULTI_INSTANCE_H
+
+#include "core/version.h"
+
+#if VERSION_MAJOR < 4
+#include "scene/3d/visual_instance.h"
+#else
+#include "scene/3d/visual_instance_3d.h"
+#endif
+
+#include "../mesh_data_resource.h"
+
+//Draws a MeshDataResource many times with one RenderingServer multimesh
+class MeshDataMultiInstance : public GeometryInstance3D {
+	GDCLASS(MeshDataMultiInstance, GeometryInstance3D);
+
+public:
+	//Floats per instance transform in the buffers
+	static const int TRANSFORM_STRIDE = 12;
+
+	Ref<MeshDataResource> get_mesh_data();
+	void set_mesh_data(const Ref<MeshDataResource> &mesh);
+
+	bool get_use_colors() const;
+	void set_use_colors(const bool value);
+
+	bool get_use_custom_data() const;
+	void set_use_custom_data(const bool value);
+
+	int get_instance_count() const;
+	void set_instance_count(const int value);
+
+	//12 floats per instance: the basis' rows, each followed by a component of the origin
+	PoolRealArray get_transforms() const;
+	void set_transforms(const PoolRealArray &p_transforms);
+
+	Transform get_instance_transform(const int p_index) const;
+	void set_instance_transform(const int p_index, const Transform &p_transform);
+
+	Color get_instance_color(const int p_index) const;
+	void set_instance_color(const int p_index, const Color &p_color);
+
+	Color get_instance_custom_data(const int p_index) const;
+	void set_instance_custom_data(const int p_index, const Color &p_custom_data);
+
+	//Every instance's data, in the layout RenderingServer::multimesh_set_buffer() expects
+	PoolRealArray get_buffer() const;
+	void set_buffer(const PoolRealArray &p_buffer);
+
+	//A static body with the mesh's collision shapes at every instance
+	bool get_generate_collision() const;
+	void set_generate_collision(const bool value);
+
+	uint32_t get_collision_layer() const;
+	void set_collision_layer(const uint32_t value);
+
+	uint32_t get_collision_mask() const;
+	void set_collision_mask(const uint32_t value);
+
+	AABB get_aabb() const;
+	Vector<Face3> get_faces(uint32_t p_usage_flags) const;
+
+	void queue_refresh();
+	void refresh();
+
+	MeshDataMultiInstance();
+	~MeshDataMultiInstance();
+
+protected:
+	void _notification(int p_what);
+	static void _bind_methods();
+
+	void _flush_refresh();
+	int _get_stride() const;
+	void _resize_buffer(const int p_instance_count, const bool p_old_use_colors, const bool p_old_use_custom_data);
+	void _update_aabb();
+	void _update_collision();
+	void _free_collision();
+	void _free_multimesh();
+
+	static Transform _read_transform(const float *p_data);
+	static void _write_transform(float *r_data, const Transform &p_transform);
+
+private:
+	bool _dirty;
+	Ref<MeshDataResource> _mesh;
+	bool _use_colors;
+	bool _use_custom_data;
+	int _instance_count;
+	PoolRealArray _buffer;
+	AABB _aabb;
+
+	bool _generate_collision;
+	uint32_t _collision_layer;
+	uint32_t _collision_mask;
+
+	Ref<MeshDataResource> _shared_mesh;
+	RID _multimesh;
+	RID _body;
+};
+
+#endif
@@ -0,0 +1,532 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mesh_data_static_batch.h"
+
+#include "mesh_data_instance.h"
+
+#include "scene/resources/world_3d.h"
+#include "servers/rendering_server.h"
+
+real_t MeshDataStaticBatch::get_cell_size() const {
+	return _cell_size;
+}
+void MeshDataStaticBatch::set_cell_size(const real_t value) {
+	ERR_FAIL_COND(value <= 0);
+
+	_cell_size = value;
+
+	if (!is_inside_tree()) {
+		return;
+	}
+
+	//Every instance can end up in a different cell
+	for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+		_free_cell(E->value);
+	}
+
+	_cells.clear();
+
+	for (HashMap<ObjectID, InstanceEntry>::Iterator E = _instances.begin(); E; ++E) {
+		MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(ObjectDB::get_instance(E->key));
+
+		ERR_CONTINUE(!mdi);
+
+		E->value = _get_entry(mdi);
+		_add_entry(E->key, E->value);
+	}
+}
+
+int MeshDataStaticBatch::get_cell_count() const {
+	return _cells.size();
+}
+
+int MeshDataStaticBatch::get_batched_instance_count() const {
+	return _instances.size();
+}
+
+void MeshDataStaticBatch::rebuild() {
+	for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+		E->value.dirty = true;
+	}
+
+	_dirty = true;
+
+	_flush_rebuild();
+}
+
+void MeshDataStaticBatch::queue_rebuild() {
+	if (_dirty || !is_inside_tree()) {
+		return;
+	}
+
+	_dirty = true;
+
+	callable_mp(this, &MeshDataStaticBatch::_flush_rebuild).call_deferred();
+}
+
+void MeshDataStaticBatch::add_instance(MeshDataInstance *p_instance) {
+	ERR_FAIL_NULL(p_instance);
+
+	ObjectID id = p_instance->get_instance_id();
+
+	ERR_FAIL_COND(_instances.has(id));
+
+	InstanceEntry entry = _get_entry(p_instance);
+
+	_instances[id] = entry;
+	_add_entry(id, entry);
+}
+
+void MeshDataStaticBatch::update_instance(MeshDataInstance *p_instance, const bool p_geometry_changed) {
+	ERR_FAIL_NULL(p_instance);
+
+	ObjectID id = p_instance->get_instance_id();
+	InstanceEntry *old_entry = _instances.getptr(id);
+
+	if (!old_entry) {
+		add_instance(p_instance);
+		return;
+	}
+
+	InstanceEntry entry = _get_entry(p_instance);
+
+	//Moving the batch itself sends a transform notification to every instance, but that doesn't change anything here
+	if (!p_geometry_changed && entry.key == old_entry->key && entry.visible == old_entry->visible && entry.transform.is_equal_approx(old_entry->transform)) {
+		return;
+	}
+
+	if (entry.key == old_entry->key) {
+		_mark_dirty(entry.key);
+	} else {
+		_remove_entry(id, *old_entry);
+		_add_entry(id, entry);
+	}
+
+	*old_entry = entry;
+}
+
+void MeshDataStaticBatch::remove_instance(MeshDataInstance *p_instance) {
+	ERR_FAIL_NULL(p_instance);
+
+	ObjectID id = p_instance->get_instance_id();
+	InstanceEntry *entry = _instances.getptr(id);
+
+	if (!entry) {
+		return;
+	}
+
+	_remove_entry(id, *entry);
+	_instances.erase(id);
+}
+
+MeshDataStaticBatch::MeshDataStaticBatch() {
+	_dirty = false;
+	_cell_size = 32;
+
+	set_notify_transform(true);
+}
+MeshDataStaticBatch::~MeshDataStaticBatch() {
+	for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+		_free_cell(E->value);
+	}
+}
+
+void MeshDataStaticBatch::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_EXIT_TREE: {
+			//The instances have already removed themselves at this point
+			for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+				_free_cell(E->value);
+			}
+
+			_cells.clear();
+			_instances.clear();
+			break;
+		}
+		case NOTIFICATION_TRANSFORM_CHANGED: {
+			//The cells are in the batch's space
+			Transform t = get_global_transform();
+
+			for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+				if (E->value.instance != RID()) {
+					RS::get_singleton()->instance_set_transform(E->value.instance, t);
+				}
+			}
+
+			break;
+		}
+		case NOTIFICATION_VISIBILITY_CHANGED: {
+			bool visible = is_visible_in_tree();
+
+			for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+				if (E->value.instance != RID()) {
+					RS::get_singleton()->instance_set_visible(E->value.instance, visible);
+				}
+			}
+
+			break;
+		}
+	}
+}
+
+void MeshDataStaticBatch::_flush_rebuild() {
+	//Could have been rebuilt directly since it was queued
+	if (!_dirty) {
+		return;
+	}
+
+	_dirty = false;
+
+	if (!is_inside_tree()) {
+		return;
+	}
+
+	Vector<CellKey> empty_cells;
+
+	for (HashMap<CellKey, Cell, CellKeyHasher>::Iterator E = _cells.begin(); E; ++E) {
+		Cell &cell = E->value;
+
+		if (cell.instances.size() == 0) {
+			_free_cell(cell);
+			empty_cells.push_back(E->key);
+			continue;
+		}
+
+		if (cell.dirty) {
+			_rebuild_cell(cell);
+		}
+	}
+
+	for (int i = 0; i < empty_cells.size(); ++i) {
+		_cells.erase(empty_cells[i]);
+	}
+}
+
+void MeshDataStaticBatch::_rebuild_cell(Cell &p_cell) {
+	p_cell.dirty = false;
+	p_cell.material.unref();
+
+	//Everything is collected first, so the merged arrays only have to be allocated once
+	Vector<Array> arrays;
+	Vector<Transform> transforms;
+
+	int vertex_count = 0;
+	int index_count = 0;
+	bool has_normals = false;
+	bool has_tangents = false;
+	bool has_colors = false;
+	bool has_uvs = false;
+	bool has_uv2s = false;
+
+	for (int i = 0; i < p_cell.instances.size(); ++i) {
+		const InstanceEntry *entry = _instances.getptr(p_cell.instances[i]);
+		MeshDataInstance *mdi = Object::cast_to<MeshDataInstance>(ObjectDB::get_instance(p_cell.instances[i]));
+
+		if (!entry || !mdi || !entry->visible) {
+			continue;
+		}
+
+		Ref<MeshDataResource> mesh = mdi->get_mesh_data();
+
+		//Zero scale can't be inverted for the normals, these wouldn't be visible anyway
+		if (!mesh.is_valid() || mesh->get_vertex_count() == 0 || Math::is_zero_approx(entry->transform.basis.determinant())) {
+			continue;
+		}
+
+		if (!p_cell.material.is_valid()) {
+			p_cell.material = mdi->get_material();
+		}
+
+		Array arr = mesh->get_array();
+		int mesh_vertex_count = mesh->get_vertex_count();
+		int mesh_index_count = Vector<int>(arr[Mesh::ARRAY_INDEX]).size();
+
+		vertex_count += mesh_vertex_count;
+		index_count += mesh_index_count > 0 ? mesh_index_count : mesh_vertex_count;
+
+		has_normals = has_normals || Vector<Vector3>(arr[Mesh::ARRAY_NORMAL]).size() == mesh_vertex_count;
+		has_tangents = has_tangents || Vector<float>(arr[Mesh::ARRAY_TANGENT]).size() == mesh_vertex_count * 4;
+		has_colors = has_colors || Vector<Color>(arr[Mesh::ARRAY_COLOR]).size() == mesh_vertex_count;
+		has_uvs = has_uvs || Vector<Vector2>(arr[Mesh::ARRAY_TEX_UV]).size() == mesh_vertex_count;
+		has_uv2s = has_uv2s || Vector<Vector2>(arr[Mesh::ARRAY_TEX_UV2]).size() == mesh_vertex_count;
+
+		arrays.push_back(arr);
+		transforms.push_back(entry->transform);
+	}
+
+	if (vertex_count == 0) {
+		_free_cell(p_cell);
+		return;
+	}
+
+	Vector<Vector3> vertices;
+	Vector<Vector3> normals;
+	Vector<float> tangents;
+	Vector<Color> colors;
+	Vector<Vector2> uvs;
+	Vector<Vector2> uv2s;
+	Vector<int> indices;
+
+	vertices.resize(vertex_count);
+	indices.resize(index_count);
+
+	if (has_normals) {
+		normals.resize(vertex_count);
+	}
+
+	if (has_tangents) {
+		tangents.resize(vertex_count * 4);
+	}
+
+	if (has_colors) {
+		colors.resize(vertex_count);
+	}
+
+	if (has_uvs) {
+		uvs.resize(vertex_count);
+	}
+
+	if (has_uv2s) {
+		uv2s.resize(vertex_count);
+	}
+
+	Vector3 *vw = vertices.ptrw();
+	Vector3 *nw = normals.ptrw();
+	float *tw = tangents.ptrw();
+	Color *cw = colors.ptrw();
+	Vector2 *uw = uvs.ptrw();
+	Vector2 *u2w = uv2s.ptrw();
+	int *iw = indices.ptrw();
+
+	int vertex_offset = 0;
+	int index_offset = 0;
+
+	for (int i = 0; i < arrays.size(); ++i) {
+		const Array &arr = arrays[i];
+		const Transform &t = transforms[i];
+
+		Basis normal_basis = t.basis.inverse().transposed();
+		//Mirroring flips the winding order, and the handedness of the tangents
+		bool flip = t.basis.determinant() < 0;
+
+		Vector<Vector3> mesh_vertices = arr[Mesh::ARRAY_VERTEX];
+		Vector<Vector3> mesh_normals = arr[Mesh::ARRAY_NORMAL];
+		Vector<float> mesh_tangents = arr[Mesh::ARRAY_TANGENT];
+		Vector<Color> mesh_colors = arr[Mesh::ARRAY_COLOR];
+		Vector<Vector2> mesh_uvs = arr[Mesh::ARRAY_TEX_UV];
+		Vector<Vector2> mesh_uv2s = arr[Mesh::ARRAY_TEX_UV2];
+		Vector<int> mesh_indices = arr[Mesh::ARRAY_INDEX];
+
+		int count = mesh_vertices.size();
+
+		for (int j = 0; j < count; ++j) {
+			int v = vertex_offset + j;
+
+			vw[v] = t.xform(mesh_vertices[j]);
+
+			//The channels that only some of the meshes have are filled with defaults for the others
+			if (has_normals) {
+				nw[v] = mesh_normals.size() == count ? normal_basis.xform(mesh_normals[j]).normalized() : Vector3(0, 1, 0);
+			}
+
+			if (has_tangents) {
+				float *tv = tw + v * 4;
+
+				if (mesh_tangents.size() == count * 4) {
+					const float *tr = mesh_tangents.ptr() + j * 4;
+					Vector3 tangent = t.basis.xform(Vector3(tr[0], tr[1], tr[2])).normalized();
+
+					tv[0] = tangent.x;
+					tv[1] = tangent.y;
+					tv[2] = tangent.z;
+					tv[3] = flip ? -tr[3] : tr[3];
+				} else {
+					tv[0] = 1;
+					tv[1] = 0;
+					tv[2] = 0;
+					tv[3] = 1;
+				}
+			}
+
+			if (has_colors) {
+				cw[v] = mesh_colors.size() == count ? mesh_colors[j] : Color(1, 1, 1, 1);
+			}
+
+			if (has_uvs) {
+				uw[v] = mesh_uvs.size() == count ? mesh_uvs[j] : Vector2();
+			}
+
+			if (has_uv2s) {
+				u2w[v] = mesh_uv2s.size() == count ? mesh_uv2s[j] : Vector2();
+			}
+		}
+
+		int mesh_index_count = mesh_indices.size() > 0 ? mesh_indices.size() : count;
+
+		for (int j = 0; j + 2 < mesh_index_count; j += 3) {
+			int a = mesh_indices.size() > 0 ? mesh_indices[j] : j;
+			int b = mesh_indices.size() > 0 ? mesh_indices[j + 1] : j + 1;
+			int c = mesh_indices.size() > 0 ? mesh_indices[j + 2] : j + 2;
+
+			int *it = iw + index_offset + j;
+
+			it[0] = vertex_offset + a;
+			it[1] = vertex_offset + (flip ? c : b);
+			it[2] = vertex_offset + (flip ? b : c);
+		}
+
+		vertex_offset += count;
+		index_offset += mesh_index_count;
+	}
+
+	Array arr;
+	arr.resize(RS::ARRAY_MAX);
+
+	arr[RS::ARRAY_VERTEX] = vertices;
+	arr[RS::ARRAY_INDEX] = indices;
+
+	if (has_normals) {
+		arr[RS::ARRAY_NORMAL] = normals;
+	}
+
+	if (has_tangents) {
+		arr[RS::ARRAY_TANGENT] = tangents;
+	}
+
+	if (has_colors) {
+		arr[RS::ARRAY_COLOR] = colors;
+	}
+
+	if (has_uvs) {
+		arr[RS::ARRAY_TEX_UV] = uvs;
+	}
+
+	if (has_uv2s) {
+		arr[RS::ARRAY_TEX_UV2] = uv2s;
+	}
+
+	RenderingServer *rs = RS::get_singleton();
+
+	//Every cell has its own instance, so the RenderingServer culls them separately
+	if (p_cell.mesh == RID()) {
+		p_cell.mesh = rs->mesh_create();
+		p_cell.instance = rs->instance_create();
+
+		rs->instance_set_base(p_cell.instance, p_cell.mesh);
+		rs->instance_set_scenario(p_cell.instance, get_world_3d()->get_scenario());
+		rs->instance_set_transform(p_cell.instance, get_global_transform());
+		rs->instance_set_visible(p_cell.instance, is_visible_in_tree());
+	}
+
+	rs->mesh_clear(p_cell.mesh);
+	rs->mesh_add_surface_from_arrays(p_cell.mesh, RS::PRIMITIVE_TRIANGLES, arr);
+
+	if (p_cell.material.is_valid()) {
+		rs->mesh_surface_set_material(p_cell.mesh, 0, p_cell.material->get_rid());
+	}
+}
+
+void MeshDataStaticBatch::_free_cell(Cell &p_cell) {
+	if (p_cell.instance != RID()) {
+		RS::get_singleton()->free(p_cell.instance);
+		p_cell.instance = RID();
+	}
+
+	if (p_cell.mesh != RID()) {
+		RS::get_singleton()->free(p_cell.mesh);
+		p_cell.mesh = RID();
+	}
+}
+
+void MeshDataStaticBatch::_mark_dirty(const CellKey &p_key) {
+	Cell *cell = _cells.getptr(p_key);
+
+	if (cell) {
+		cell->dirty = true;
+	}
+
+	queue_rebuild();
+}
+
+MeshDataStaticBatch::InstanceEntry MeshDataStaticBatch::_get_entry(MeshDataInstance *p_instance) const {
+	InstanceEntry entry;
+
+	entry.transform = get_global_transform().affine_inverse() * p_instance->get_global_transform();
+
+	//Only the visibility of the nodes between the instance and the batch matters, the batch hides its cells itself
+	entry.visible = true;
+
+	for (Node *n = p_instance; n && n != this; n = n->get_parent()) {
+		Node3D *s = Object::cast_to<Node3D>(n);
+
+		if (s && !s->is_visible()) {
+			entry.visible = false;
+			break;
+		}
+	}
+
+	Ref<MeshDataResource> mesh = p_instance->get_mesh_data();
+	Vector3 center = mesh.is_valid() ? entry.transform.xform(mesh->get_aabb()).get_center() : entry.transform.origin;
+
+	entry.key.cell = Vector3i(Math::floor(center.x / _cell_size), Math::floor(center.y / _cell_size), Math::floor(center.z / _cell_size));
+
+	Ref<Material> material = p_instance->get_material();
+	entry.key.material = material.is_valid() ? material->get_instance_id() : ObjectID();
+
+	return entry;
+}
+
+void MeshDataStaticBatch::_add_entry(const ObjectID p_id, const InstanceEntry &p_entry) {
+	Cell *cell = _cells.getptr(p_entry.key);
+
+	if (!cell) {
+		_cells.insert(p_entry.key, Cell());
+		cell = _cells.getptr(p_entry.key);
+	}
+
+	cell->instances.push_back(p_id);
+
+	_mark_dirty(p_entry.key);
+}
+
+void MeshDataStaticBatch::_remove_entry(const ObjectID p_id, const InstanceEntry &p_entry) {
+	Cell *cell = _cells.getptr(p_entry.key);
+
+	ERR_FAIL_COND(!cell);
+
+	cell->instances.erase(p_id);
+
+	_mark_dirty(p_entry.key);
+}
+
+void MeshDataStaticBatch::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_cell_size"), &MeshDataStaticBatch::get_cell_size);
+	ClassDB::bind_method(D_METHOD("set_cell_size", "value"), &MeshDataStaticBatch::set_cell_size);
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "cell_size", PROPERTY_HINT_RANGE, "0.1,1024,0.1,or_greater"), "set_cell_size", "get_cell_size");
+
+	ClassDB::bind_method(D_METHOD("get_cell_count"), &MeshDataStaticBatch::get_cell_count);
+	ClassDB::bind_method(D_METHOD("get_batched_instance_count"), &MeshDataStaticBatch::get_batched_instance_count);
+
+	ClassDB::bind_method(D_METHOD("rebuild"), &MeshDataStaticBatch::rebuild);
+	ClassDB::bind_method(D_METHOD("queue_rebuild"), &MeshDataStaticBatch::queue_rebuild);
+}
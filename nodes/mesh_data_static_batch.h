@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MESH_DATA_STATIC_BATCH_H
+#define MESH_DATA_STATIC_BATCH_H
+
+#include "core/version.h"
+
+#include "core/math/vector3i.h"
+#include "core/object/object_id.h"
+#include "core/templates/hash_map.h"
+#include "scene/3d/node_3d.h"
+#include "scene/resources/material.h"
+
+#include "../mesh_data_resource.h"
+
+class MeshDataInstance;
+
+//Merges the descendant MeshDataInstances into one mesh per grid cell and material.
+//The instances register themselves when they enter the tree, and only the cells they touch are rebuilt when they change.
+class MeshDataStaticBatch : public Node3D {
+	GDCLASS(MeshDataStaticBatch, Node3D);
+
+public:
+	real_t get_cell_size() const;
+	void set_cell_size(const real_t value);
+
+	int get_cell_count() const;
+	int get_batched_instance_count() const;
+
+	//Rebuilds every cell immediately
+	void rebuild();
+	void queue_rebuild();
+
+	//Called by the MeshDataInstances. If p_geometry_changed is false, the cell is only rebuilt when the instance moved or got hidden.
+	void add_instance(MeshDataInstance *p_instance);
+	void update_instance(MeshDataInstance *p_instance, const bool p_geometry_changed);
+	void remove_instance(MeshDataInstance *p_instance);
+
+	MeshDataStaticBatch();
+	~MeshDataStaticBatch();
+
+protected:
+	struct CellKey {
+		Vector3i cell;
+		ObjectID material;
+
+		bool operator==(const CellKey &p_other) const {
+			return cell == p_other.cell && material == p_other.material;
+		}
+	};
+
+	struct CellKeyHasher {
+		static _FORCE_INLINE_ uint32_t hash(const CellKey &p_key) {
+			uint32_t h = hash_murmur3_one_32(p_key.cell.x);
+			h = hash_murmur3_one_32(p_key.cell.y, h);
+			h = hash_murmur3_one_32(p_key.cell.z, h);
+			return hash_murmur3_one_64(static_cast<uint64_t>(p_key.material), h);
+		}
+	};
+
+	struct Cell {
+		Ref<Material> material;
+		Vector<ObjectID> instances;
+		RID mesh;
+		RID instance;
+		bool dirty;
+
+		Cell() {
+			dirty = true;
+		}
+	};
+
+	struct InstanceEntry {
+		CellKey key;
+		Transform transform;
+		bool visible;
+	};
+
+	void _notification(int p_what);
+	static void _bind_methods();
+
+	void _flush_rebuild();
+	void _rebuild_cell(Cell &p_cell);
+	void _free_cell(Cell &p_cell);
+	void _mark_dirty(const CellKey &p_key);
+
+	InstanceEntry _get_entry(MeshDataInstance *p_instance) const;
+	void _add_entry(const ObjectID p_id, const InstanceEntry &p_entry);
+	void _remove_entry(const ObjectID p_id, const InstanceEntry &p_entry);
+
+private:
+	bool _dirty;
+	real_t _cell_size;
+
+	HashMap<CellKey, Cell, CellKeyHasher> _cells;
+	HashMap<ObjectID, InstanceEntry> _instances;
+};
+
+#endif
@@ -22,6 +22,11 @@ SOFTWARE.
 
 #include "mdr_import_plugin_base.h"
 
+#include "core/crypto/crypto_core.h"
+#include "core/io/dir_access.h"
+#include "core/io/file_access.h"
+#include "core/io/marshalls.h"
+#include "core/object/worker_thread_pool.h"
 #include "core/version.h"
 
 #if VERSION_MAJOR < 4
@@ -55,7 +60,7 @@ SOFTWARE.
 #define PoolVector3Array PackedVector3Array
 #define PoolVector2Array PackedVector2Array
 #define PoolColorArray PackedColorArray
-#define PoolIntArray PackedInt64Array
+#define PoolIntArray PackedInt32Array
 #define PoolRealArray PackedFloat32Array
 #define PoolByteArray PackedByteArray
 
@@ -75,11 +80,29 @@ using PoolVector = Vector<N>;
 
 const String MDRImportPluginBase::BINDING_MDR_IMPORT_TYPE = "Single,Multiple";
 const String MDRImportPluginBase::BINDING_MDR_SURFACE_HANDLING_TYPE = "Only Use First,Create Separate MDRs,Merge";
-const String MDRImportPluginBase::BINDING_MDR_OPTIMIZATION_TYPE = "Off"
+const String MDRImportPluginBase::BINDING_MDR_OPTIMIZATION_TYPE = "Off:0"
 #if MESH_UTILS_PRESENT
-																  ",Remove Doubles,Remove Doubles Interpolate Normals"
+																  ",Remove Doubles:1,Remove Doubles Interpolate Normals:2"
 #endif
-		;
+																  ",Vertex Cache:3,Vertex Cache And Fetch:4";
+
+//The options that change the generated MeshDataResources
+static const char *import_cache_options[] = {
+	"surface_handling",
+	"optimization_type",
+	"optimize_overdraw",
+	"overdraw_threshold",
+	"generate_lods",
+	"lod_count",
+	"lod_max_error",
+	"build_clusters",
+	"quantization",
+	"collider_type",
+	"offset",
+	"rotation",
+	"scale",
+	nullptr
+};
 
 void MDRImportPluginBase::get_import_options(const String &p_path, List<ImportOption> *r_options, int p_preset) const {
 	r_options->push_back(ImportOption(PropertyInfo(Variant::INT, "import_type", PROPERTY_HINT_ENUM, BINDING_MDR_IMPORT_TYPE), MDRImportPluginBase::MDR_IMPORT_TIME_SINGLE));
@@ -92,6 +115,16 @@ void MDRImportPluginBase::get_import_options(const String &p_path, List<ImportOp
 	r_options->push_back(ImportOption(PropertyInfo(Variant::INT, "optimization_type", PROPERTY_HINT_ENUM, BINDING_MDR_OPTIMIZATION_TYPE), MDRImportPluginBase::MDR_OPTIMIZATION_OFF));
 #endif
 
+	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "optimize_overdraw"), false));
+	r_options->push_back(ImportOption(PropertyInfo(Variant::FLOAT, "overdraw_threshold", PROPERTY_HINT_RANGE, "1,3,0.01"), 1.05));
+
+	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "generate_lods"), false));
+	r_options->push_back(ImportOption(PropertyInfo(Variant::INT, "lod_count", PROPERTY_HINT_RANGE, "1,8,1"), 4));
+	r_options->push_back(ImportOption(PropertyInfo(Variant::FLOAT, "lod_max_error", PROPERTY_HINT_RANGE, "0.001,1,0.001"), 0.05));
+	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "build_clusters"), false));
+
+	r_options->push_back(ImportOption(PropertyInfo(Variant::INT, "quantization", PROPERTY_HINT_FLAGS, MeshDataResource::BINDING_STRING_QUANTIZATION_FLAGS), MeshDataResource::QUANTIZATION_NONE));
+
 	r_options->push_back(ImportOption(PropertyInfo(Variant::INT, "collider_type", PROPERTY_HINT_ENUM, MeshDataResource::BINDING_STRING_COLLIDER_TYPE), MeshDataResource::COLLIDER_TYPE_NONE));
 
 	r_options->push_back(ImportOption(PropertyInfo(Variant::VECTOR3, "offset"), Vector3(0, 0, 0)));
@@ -99,9 +132,22 @@ void MDRImportPluginBase::get_import_options(const String &p_path, List<ImportOp
 	r_options->push_back(ImportOption(PropertyInfo(Variant::VECTOR3, "scale"), Vector3(1, 1, 1)));
 
 	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "save_copy_as_resource"), false));
+	r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "use_import_cache"), true));
 }
 
 bool MDRImportPluginBase::get_option_visibility(const String &p_path, const String &p_option, const HashMap<StringName, Variant> &p_options) const {
+	if (p_option == "overdraw_threshold") {
+		return p_options["optimize_overdraw"];
+	}
+
+	if (p_option == "lod_count" || p_option == "lod_max_error") {
+		return p_options["generate_lods"];
+	}
+
+	if (p_option == "use_import_cache") {
+		return static_cast<int>(p_options["import_type"]) == MDR_IMPORT_TIME_MULTIPLE;
+	}
+
 	return true;
 }
 
@@ -135,7 +181,7 @@ Error MDRImportPluginBase::process_node(Node *n, const String &p_source_file, co
 				save_mdrcoll_copy_as_tres(p_source_file, copy_coll);
 			}
 
-			return ResourceSaver::save(coll, p_save_path + "." + get_save_extension());
+			return save_resource(coll, p_save_path + "." + get_save_extension());
 		}
 
 			//case MDR_IMPORT_TIME_SINGLE_WITH_SEPARATED_BONES: {
@@ -146,6 +192,24 @@ Error MDRImportPluginBase::process_node(Node *n, const String &p_source_file, co
 	return Error::ERR_PARSE_ERROR;
 }
 
+//Imports made before the .mdres format saved the same files with the .res extension. They are removed once
+//their replacement is saved, so they aren't left behind in the project.
+Error MDRImportPluginBase::save_resource(const Ref<Resource> &res, const String &p_path) {
+	Error err = ResourceSaver::save(res, p_path);
+
+	if (err != OK) {
+		return err;
+	}
+
+	String legacy_path = p_path.get_basename() + ".res";
+
+	if (legacy_path != p_path && FileAccess::exists(legacy_path)) {
+		DirAccess::remove_absolute(legacy_path);
+	}
+
+	return OK;
+}
+
 int MDRImportPluginBase::get_mesh_count(Node *n) {
 	int count = 0;
 
@@ -163,10 +227,6 @@ int MDRImportPluginBase::get_mesh_count(Node *n) {
 }
 
 Error MDRImportPluginBase::process_node_single(Node *n, const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata) {
-#if MESH_UTILS_PRESENT
-	MDRImportPluginBase::MDROptimizationType optimization_type = static_cast<MDRImportPluginBase::MDROptimizationType>(static_cast<int>(p_options["optimization_type"]));
-#endif
-
 	bool save_copy_as_resource = static_cast<bool>(p_options["save_copy_as_resource"]);
 	MeshDataResource::ColliderType collider_type = static_cast<MeshDataResource::ColliderType>(static_cast<int>(p_options["collider_type"]));
 
@@ -189,18 +249,10 @@ Error MDRImportPluginBase::process_node_single(Node *n, const String &p_source_f
 					continue;
 				}
 
-#if MESH_UTILS_PRESENT
-				switch (optimization_type) {
-					case MDR_OPTIMIZATION_OFF:
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles(mdr->get_array()));
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles_interpolate_normals(mdr->get_array()));
-						break;
-				}
-#endif
+				apply_optimization(mdr, p_options);
+				apply_lods(mdr, p_options);
+				apply_clusters(mdr, p_options);
+				apply_quantization(mdr, p_options, r_metadata);
 
 				ERR_FAIL_COND_V(!mdr.is_valid(), Error::ERR_PARSE_ERROR);
 
@@ -208,7 +260,7 @@ Error MDRImportPluginBase::process_node_single(Node *n, const String &p_source_f
 					save_mdr_copy_as_tres(p_source_file, mdr, mdrs.size() > 1, mi);
 				}
 
-				ResourceSaver::save(mdr, p_save_path + "." + get_save_extension());
+				save_resource(mdr, p_save_path + "." + get_save_extension());
 			}
 
 			return Error::OK;
@@ -223,10 +275,6 @@ Error MDRImportPluginBase::process_node_single(Node *n, const String &p_source_f
 }
 
 Error MDRImportPluginBase::process_node_single_separated_bones(Node *n, const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata) {
-#if MESH_UTILS_PRESENT
-	MDRImportPluginBase::MDROptimizationType optimization_type = static_cast<MDRImportPluginBase::MDROptimizationType>(static_cast<int>(p_options["optimization_type"]));
-#endif
-
 	MeshDataResource::ColliderType collider_type = static_cast<MeshDataResource::ColliderType>(static_cast<int>(p_options["collider_type"]));
 	bool save_copy_as_resource = static_cast<bool>(p_options["save_copy_as_resource"]);
 
@@ -258,24 +306,16 @@ Error MDRImportPluginBase::process_node_single_separated_bones(Node *n, const St
 				if (!mdr.is_valid())
 					continue;
 
-#if MESH_UTILS_PRESENT
-				switch (optimization_type) {
-					case MDR_OPTIMIZATION_OFF:
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles(mdr->get_array()));
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles_interpolate_normals(mdr->get_array()));
-						break;
-				}
-#endif
+				apply_optimization(mdr, p_options);
+				apply_lods(mdr, p_options);
+				apply_clusters(mdr, p_options);
+				apply_quantization(mdr, p_options, r_metadata);
 
 				String node_name = c->get_name();
 				node_name = node_name.to_lower();
 				String filename = p_source_file.get_basename() + "_" + node_name + "_" + String::num(j) + "." + get_save_extension();
 
-				Error err = ResourceSaver::save(mdr, filename);
+				Error err = save_resource(mdr, filename);
 
 				ERR_CONTINUE(err != Error::OK);
 
@@ -296,7 +336,7 @@ Error MDRImportPluginBase::process_node_single_separated_bones(Node *n, const St
 				//	save_mdrcoll_copy_as_tres(mdr_coll_name, coll);
 			}
 
-			return ResourceSaver::save(coll, p_save_path + "." + get_save_extension());
+			return save_resource(coll, p_save_path + "." + get_save_extension());
 		}
 
 		if (process_node_single_separated_bones(c, p_source_file, p_save_path, p_options, r_platform_variants, r_gen_files, r_metadata) == Error::OK) {
@@ -308,138 +348,424 @@ Error MDRImportPluginBase::process_node_single_separated_bones(Node *n, const St
 }
 
 Error MDRImportPluginBase::process_node_multi(Node *n, const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata, Ref<MeshDataResourceCollection> coll, Ref<MeshDataResourceCollection> copy_coll, int node_count) {
-#if MESH_UTILS_PRESENT
-	MDRImportPluginBase::MDROptimizationType optimization_type = static_cast<MDRImportPluginBase::MDROptimizationType>(static_cast<int>(p_options["optimization_type"]));
-#endif
+	ERR_FAIL_COND_V(n == NULL, Error::ERR_PARSE_ERROR);
 
-	MeshDataResource::ColliderType collider_type = static_cast<MeshDataResource::ColliderType>(static_cast<int>(p_options["collider_type"]));
+	bool use_import_cache = p_options.has("use_import_cache") && static_cast<bool>(p_options["use_import_cache"]);
 
+	//The meshes are read on the main thread, everything else is done for all of them in parallel
+	Vector<MeshJob> jobs;
+	collect_mesh_jobs(n, p_options, jobs, node_count);
+
+	MeshJobData data;
+	data.plugin = this;
+	data.options = &p_options;
+	data.jobs = jobs.ptrw();
+
+	if (use_import_cache && jobs.size() > 0) {
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_native_group_task(&MDRImportPluginBase::_hash_mesh_job, &data, jobs.size(), -1, true, "MDRImportPluginBase");
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+
+		//Every hit is loaded before anything gets saved, as the results of this import can overwrite the cached files
+		Dictionary cache = load_import_cache(p_save_path);
+		int hits = 0;
+
+		for (int i = 0; i < jobs.size(); ++i) {
+			if (load_cached_mesh_job(jobs.write[i], cache)) {
+				++hits;
+			}
+		}
+
+		add_import_cache_metadata(r_metadata, hits, jobs.size() - hits);
+	}
+
+	if (jobs.size() > 0) {
+		//Cached jobs return immediately
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_native_group_task(&MDRImportPluginBase::_process_mesh_job, &data, jobs.size(), -1, true, "MDRImportPluginBase");
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	}
+
+	//The colliders need ArrayMeshes, which talk to the RenderingServer, and jobs can share their source mesh,
+	//so they are only created here, on the main thread. The convex decomposition already ran on the workers.
+	MeshDataResource::ColliderType collider_type = static_cast<MeshDataResource::ColliderType>(static_cast<int>(p_options["collider_type"]));
 	Vector3 scale = p_options["scale"];
 
-	ERR_FAIL_COND_V(n == NULL, Error::ERR_PARSE_ERROR);
+	for (int i = 0; i < jobs.size(); ++i) {
+		const MeshJob &job = jobs[i];
 
-	for (int i = 0; i < n->get_child_count(); ++i) {
-		Node *c = n->get_child(i);
+		if (job.cached) {
+			continue;
+		}
 
-		if (Object::cast_to<MeshInstance>(c)) {
-			MeshInstance *mesh_inst = Object::cast_to<MeshInstance>(c);
+		for (int mi = 0; mi < job.mdrs.size(); ++mi) {
+			Ref<MeshDataResource> mdr = job.mdrs[mi];
 
-			Vector<Ref<MeshDataResource>> mdrs = get_meshes(mesh_inst, p_options, collider_type, scale);
+			if (!mdr.is_valid()) {
+				continue;
+			}
 
-			for (int mi = 0; mi < mdrs.size(); ++mi) {
-				Ref<MeshDataResource> mdr = mdrs[mi];
+			if (collider_type == MeshDataResource::COLLIDER_TYPE_MULTIPLE_CONVEX_COLLISION_SHAPES) {
+				add_convex_colliders(mdr, job.convex_hulls, scale);
+			} else {
+				add_colliders(mdr, job.mesh, p_options, collider_type, scale);
+			}
+		}
+	}
 
-				if (!mdr.is_valid()) {
-					continue;
-				}
+	//Saved in tree order, so the collections don't depend on which job finished first
+	for (int i = 0; i < jobs.size(); ++i) {
+		const MeshJob &job = jobs[i];
 
-#if MESH_UTILS_PRESENT
-				switch (optimization_type) {
-					case MDR_OPTIMIZATION_OFF:
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles(mdr->get_array()));
-						break;
-					case MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS:
-						mdr->set_array(MeshUtils::get_singleton()->remove_doubles_interpolate_normals(mdr->get_array()));
-						break;
-				}
-#endif
+		add_quantization_metadata(r_metadata, job.quantization_bytes_saved);
 
-				if (copy_coll.is_valid()) {
-					String node_name = c->get_name();
-					node_name = node_name.to_lower();
-					String filename = p_source_file.get_basename() + "_" + node_name + "_" + String::num(node_count);
+		for (int mi = 0; mi < job.mdrs.size(); ++mi) {
+			Ref<MeshDataResource> mdr = job.mdrs[mi];
 
-					if (mdrs.size() > 1) {
-						filename += "_";
-						filename += String::num(mi);
-					}
+			if (!mdr.is_valid()) {
+				continue;
+			}
 
-					filename += ".tres";
+			String filename = p_source_file.get_basename() + "_" + job.node_name + "_" + String::num(job.node_count);
 
-					Error err = ResourceSaver::save(mdr, filename);
-					Ref<MeshDataResource> mdrtl = ResourceLoader::load(filename);
-					copy_coll->add_mdr(mdrtl);
+			if (job.mdrs.size() > 1) {
+				filename += "_";
+				filename += String::num(mi);
+			}
 
-					if (err != Error::OK) {
-						return err;
-					}
-				}
+			//The saved instances are added to the collections with their new paths, instead of loading them back.
+			//One instance can only have one path, so the copy gets its own.
+			if (copy_coll.is_valid()) {
+				String copy_filename = filename + ".tres";
+				Ref<MeshDataResource> copy = mdr->duplicate();
 
-				String node_name = c->get_name();
-				node_name = node_name.to_lower();
-				String filename = p_source_file.get_basename() + "_" + node_name + "_" + String::num(node_count);
+				Error err = ResourceSaver::save(copy, copy_filename);
 
-				if (mdrs.size() > 1) {
-					filename += "_";
-					filename += String::num(mi);
+				if (err != Error::OK) {
+					return err;
 				}
 
-				filename += "." + get_save_extension();
+				copy->take_over_path(copy_filename);
+				copy_coll->add_mdr(copy);
+			}
 
-				Error err = ResourceSaver::save(mdr, filename);
-				Ref<MeshDataResource> mdrl = ResourceLoader::load(filename);
-				coll->add_mdr(mdrl);
+			filename += "." + get_save_extension();
+
+			//A cached result that is already in the right file doesn't need to be written again
+			if (!job.cached || job.cached_files[mi] != filename) {
+				Error err = save_resource(mdr, filename);
 
 				if (err != Error::OK) {
 					return err;
 				}
 			}
 
-			++node_count;
+			mdr->take_over_path(filename);
+			coll->add_mdr(mdr);
 		}
+	}
 
-		process_node_multi(c, p_source_file, p_save_path, p_options, r_platform_variants, r_gen_files, r_metadata, coll, copy_coll, node_count);
+	if (use_import_cache) {
+		save_import_cache(p_save_path, jobs);
 	}
 
 	return Error::OK;
 }
 
+void MDRImportPluginBase::collect_mesh_jobs(Node *n, const HashMap<StringName, Variant> &p_options, Vector<MeshJob> &r_jobs, int node_count) {
+	for (int i = 0; i < n->get_child_count(); ++i) {
+		Node *c = n->get_child(i);
+
+		if (Object::cast_to<MeshInstance>(c)) {
+			MeshInstance *mesh_inst = Object::cast_to<MeshInstance>(c);
+
+			MeshJob job;
+			job.node_name = String(c->get_name()).to_lower();
+			job.node_count = node_count;
+			job.mesh = mesh_inst->get_mesh();
+
+			if (job.mesh.is_valid()) {
+				job.surfaces = get_surface_arrays(job.mesh, p_options);
+
+				//The convex colliders are made from the whole mesh, even if only some of its surfaces are used
+				bool use_import_cache = p_options.has("use_import_cache") && static_cast<bool>(p_options["use_import_cache"]);
+				int collider_type = p_options["collider_type"];
+
+				if ((use_import_cache && collider_type != MeshDataResource::COLLIDER_TYPE_NONE) || collider_type == MeshDataResource::COLLIDER_TYPE_MULTIPLE_CONVEX_COLLISION_SHAPES) {
+					for (int si = job.surfaces.size(); si < job.mesh->get_surface_count(); ++si) {
+						job.collider_surfaces.push_back(job.mesh->surface_get_arrays(si));
+					}
+				}
+
+				r_jobs.push_back(job);
+			}
+
+			++node_count;
+		}
+
+		collect_mesh_jobs(c, p_options, r_jobs, node_count);
+	}
+}
+
+void MDRImportPluginBase::hash_mesh_job(MeshJob &job, const HashMap<StringName, Variant> &p_options) {
+	Array data;
+	data.push_back(IMPORT_CACHE_VERSION);
+
+	for (int i = 0; import_cache_options[i]; ++i) {
+		const char *option = import_cache_options[i];
+
+		data.push_back(p_options.has(option) ? p_options[option] : Variant());
+	}
+
+	Array surfaces;
+
+	for (int i = 0; i < job.surfaces.size(); ++i) {
+		surfaces.push_back(job.surfaces[i]);
+	}
+
+	for (int i = 0; i < job.collider_surfaces.size(); ++i) {
+		surfaces.push_back(job.collider_surfaces[i]);
+	}
+
+	data.push_back(surfaces);
+
+	int len = 0;
+	Error err = encode_variant(data, nullptr, len);
+	ERR_FAIL_COND(err != OK);
+
+	Vector<uint8_t> buffer;
+	buffer.resize(len);
+	encode_variant(data, buffer.ptrw(), len);
+
+	unsigned char hash[32];
+
+	CryptoCore::SHA256Context ctx;
+	ctx.start();
+	ctx.update(buffer.ptr(), len);
+	ctx.finish(hash);
+
+	job.hash = String::hex_encode_buffer(hash, 32);
+}
+
+void MDRImportPluginBase::process_mesh_job(MeshJob &job, const HashMap<StringName, Variant> &p_options) {
+	if (job.cached) {
+		return;
+	}
+
+	Vector3 scale = p_options["scale"];
+
+	//The colliders are added on the main thread, once every job is done
+	job.mdrs = get_meshes_from_arrays(job.surfaces, job.mesh, p_options, MeshDataResource::COLLIDER_TYPE_NONE, scale);
+
+	if (static_cast<int>(p_options["collider_type"]) == MeshDataResource::COLLIDER_TYPE_MULTIPLE_CONVEX_COLLISION_SHAPES) {
+		Vector<Array> surfaces = job.surfaces;
+		surfaces.append_array(job.collider_surfaces);
+
+		job.convex_hulls = decompose_convex(surfaces);
+	}
+
+	for (int i = 0; i < job.mdrs.size(); ++i) {
+		Ref<MeshDataResource> mdr = job.mdrs[i];
+
+		if (!mdr.is_valid()) {
+			continue;
+		}
+
+		apply_optimization(mdr, p_options);
+		apply_lods(mdr, p_options);
+		apply_clusters(mdr, p_options);
+		//The metadata is only updated on the main thread
+		job.quantization_bytes_saved += apply_quantization(mdr, p_options, NULL);
+	}
+}
+
+void MDRImportPluginBase::_hash_mesh_job(void *p_userdata, uint32_t p_index) {
+	MeshJobData *data = static_cast<MeshJobData *>(p_userdata);
+
+	data->plugin->hash_mesh_job(data->jobs[p_index], *data->options);
+}
+
+void MDRImportPluginBase::_process_mesh_job(void *p_userdata, uint32_t p_index) {
+	MeshJobData *data = static_cast<MeshJobData *>(p_userdata);
+
+	data->plugin->process_mesh_job(data->jobs[p_index], *data->options);
+}
+
+Dictionary MDRImportPluginBase::load_import_cache(const String &p_save_path) {
+	Ref<FileAccess> f = FileAccess::open(p_save_path + ".mdrcache", FileAccess::READ);
+
+	if (!f.is_valid()) {
+		return Dictionary();
+	}
+
+	Variant cache = f->get_var();
+
+	if (cache.get_type() != Variant::DICTIONARY) {
+		return Dictionary();
+	}
+
+	return cache;
+}
+
+void MDRImportPluginBase::save_import_cache(const String &p_save_path, const Vector<MeshJob> &jobs) {
+	//Only the results of this import are kept
+	Dictionary cache;
+
+	for (int i = 0; i < jobs.size(); ++i) {
+		const MeshJob &job = jobs[i];
+
+		if (job.hash.is_empty()) {
+			continue;
+		}
+
+		Array files;
+
+		for (int j = 0; j < job.mdrs.size(); ++j) {
+			files.push_back(job.mdrs[j].is_valid() ? job.mdrs[j]->get_path() : String());
+		}
+
+		Dictionary entry;
+		entry["files"] = files;
+		entry["quantization_bytes_saved"] = job.quantization_bytes_saved;
+
+		cache[job.hash] = entry;
+	}
+
+	Ref<FileAccess> f = FileAccess::open(p_save_path + ".mdrcache", FileAccess::WRITE);
+
+	ERR_FAIL_COND_MSG(!f.is_valid(), "Couldn't save the import cache: " + p_save_path + ".mdrcache");
+
+	f->store_var(cache);
+}
+
+bool MDRImportPluginBase::load_cached_mesh_job(MeshJob &job, const Dictionary &cache) {
+	if (job.hash.is_empty() || !cache.has(job.hash)) {
+		return false;
+	}
+
+	Dictionary entry = cache[job.hash];
+	Array files = entry.get("files", Array());
+
+	Vector<Ref<MeshDataResource>> mdrs;
+
+	for (int i = 0; i < files.size(); ++i) {
+		String file = files[i];
+
+		//Was invalid when it got generated
+		if (file.is_empty()) {
+			mdrs.push_back(Ref<MeshDataResource>());
+			continue;
+		}
+
+		//Any missing or broken file means the job has to be done again
+		if (!FileAccess::exists(file)) {
+			return false;
+		}
+
+		//Not shared through the cache, identical meshes of the same file can hit the same entry
+		Ref<MeshDataResource> mdr = ResourceLoader::load(file, "", ResourceFormatLoader::CACHE_MODE_IGNORE);
+
+		if (!mdr.is_valid()) {
+			return false;
+		}
+
+		//With lazy_load_geometry only the header is loaded, but the file can get overwritten before the geometry is needed.
+		//Geometry that failed to load leaves an empty resource behind.
+		mdr->_ensure_geometry();
+
+		if (mdr->get_vertex_count() == 0) {
+			return false;
+		}
+
+		mdrs.push_back(mdr);
+	}
+
+	job.mdrs = mdrs;
+	job.cached_files.clear();
+
+	for (int i = 0; i < files.size(); ++i) {
+		job.cached_files.push_back(files[i]);
+	}
+
+	job.quantization_bytes_saved = entry.get("quantization_bytes_saved", 0);
+	job.cached = true;
+
+	return true;
+}
+
+void MDRImportPluginBase::add_import_cache_metadata(Variant *r_metadata, const int hits, const int misses) {
+	if (!r_metadata) {
+		return;
+	}
+
+	Dictionary metadata;
+
+	if (r_metadata->get_type() == Variant::DICTIONARY) {
+		metadata = *r_metadata;
+	}
+
+	metadata["import_cache_hits"] = hits;
+	metadata["import_cache_misses"] = misses;
+
+	*r_metadata = metadata;
+}
+
 Vector<Ref<MeshDataResource>> MDRImportPluginBase::get_meshes(MeshInstance *mi, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale) {
+	Ref<ArrayMesh> mesh = mi->get_mesh();
+
+	if (!mesh.is_valid()) {
+		return Vector<Ref<MeshDataResource>>();
+	}
+
+	return get_meshes_from_arrays(get_surface_arrays(mesh, p_options), mesh, p_options, collider_type, scale);
+}
+
+Vector<Array> MDRImportPluginBase::get_surface_arrays(const Ref<ArrayMesh> &mesh, const HashMap<StringName, Variant> &p_options) {
 	MDRImportPluginBase::MDRSurfaceHandlingType surface_handling = static_cast<MDRImportPluginBase::MDRSurfaceHandlingType>(static_cast<int>(p_options["surface_handling"]));
 
-	Vector<Ref<MeshDataResource>> ret;
+	Vector<Array> surfaces;
 
-	Ref<ArrayMesh> mesh = mi->get_mesh();
+	int count = surface_handling == MDR_SURFACE_HANDLING_TYPE_ONLY_USE_FIRST ? MIN(1, mesh->get_surface_count()) : mesh->get_surface_count();
 
-	if (mesh.is_valid()) {
-		if (surface_handling == MDR_SURFACE_HANDLING_TYPE_ONLY_USE_FIRST) {
-			Ref<MeshDataResource> mdr;
-			mdr.instantiate();
+	for (int i = 0; i < count; ++i) {
+		surfaces.push_back(mesh->surface_get_arrays(i));
+	}
 
-			Array arrays = mesh->surface_get_arrays(0);
+	return surfaces;
+}
 
-			mdr->set_array(apply_transforms(arrays, p_options));
+Vector<Ref<MeshDataResource>> MDRImportPluginBase::get_meshes_from_arrays(const Vector<Array> &surfaces, Ref<ArrayMesh> mesh, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale) {
+	MDRImportPluginBase::MDRSurfaceHandlingType surface_handling = static_cast<MDRImportPluginBase::MDRSurfaceHandlingType>(static_cast<int>(p_options["surface_handling"]));
 
-			add_colliders(mdr, mesh, p_options, collider_type, scale);
+	Vector<Ref<MeshDataResource>> ret;
 
-			ret.push_back(mdr);
-		} else if (surface_handling == MDR_SURFACE_HANDLING_TYPE_MERGE) {
-			Ref<MeshDataResource> mdr;
-			mdr.instantiate();
+	if (surfaces.size() == 0) {
+		return ret;
+	}
 
-			for (int i = 0; i < mesh->get_surface_count(); ++i) {
-				Array arrays = mesh->surface_get_arrays(i);
+	if (surface_handling == MDR_SURFACE_HANDLING_TYPE_MERGE) {
+		Ref<MeshDataResource> mdr;
+		mdr.instantiate();
 
-				mdr->append_arrays(apply_transforms(arrays, p_options));
-			}
+		for (int i = 0; i < surfaces.size(); ++i) {
+			Array arrays = surfaces[i];
 
-			add_colliders(mdr, mesh, p_options, collider_type, scale);
-			ret.push_back(mdr);
-		} else if (surface_handling == MDR_SURFACE_HANDLING_TYPE_SEPARATE_MDRS) {
-			for (int i = 0; i < mesh->get_surface_count(); ++i) {
-				Ref<MeshDataResource> mdr;
-				mdr.instantiate();
+			mdr->append_arrays(apply_transforms(arrays, p_options));
+		}
 
-				Array arrays = mesh->surface_get_arrays(i);
+		add_colliders(mdr, mesh, p_options, collider_type, scale);
+		ret.push_back(mdr);
+	} else {
+		//Only the first surface is collected for MDR_SURFACE_HANDLING_TYPE_ONLY_USE_FIRST
+		for (int i = 0; i < surfaces.size(); ++i) {
+			Ref<MeshDataResource> mdr;
+			mdr.instantiate();
 
-				mdr->set_array(apply_transforms(arrays, p_options));
+			Array arrays = surfaces[i];
 
-				add_colliders(mdr, mesh, p_options, collider_type, scale);
+			mdr->set_array(apply_transforms(arrays, p_options));
 
-				ret.push_back(mdr);
-			}
+			add_colliders(mdr, mesh, p_options, collider_type, scale);
+
+			ret.push_back(mdr);
 		}
 	}
 
@@ -878,6 +1204,149 @@ Ref<Shape> MDRImportPluginBase::scale_shape(Ref<Shape> shape, const Vector3 &sca
 	return shape;
 }
 
+Vector<Vector<Vector3>> MDRImportPluginBase::decompose_convex(const Vector<Array> &surfaces) {
+	ERR_FAIL_NULL_V(Mesh::convex_decomposition_function, Vector<Vector<Vector3>>());
+
+	Vector<real_t> vertices;
+	Vector<uint32_t> indices;
+
+	for (int i = 0; i < surfaces.size(); ++i) {
+		const Array &arr = surfaces[i];
+
+		if (arr.size() != Mesh::ARRAY_MAX) {
+			continue;
+		}
+
+		PoolVector3Array surface_vertices = arr[Mesh::ARRAY_VERTEX];
+		PoolIntArray surface_indices = arr[Mesh::ARRAY_INDEX];
+
+		uint32_t offset = vertices.size() / 3;
+		int vc = surface_vertices.size();
+
+		vertices.resize(vertices.size() + vc * 3);
+		real_t *vw = vertices.ptrw() + offset * 3;
+
+		for (int j = 0; j < vc; ++j) {
+			const Vector3 &v = surface_vertices[j];
+
+			vw[j * 3] = v.x;
+			vw[j * 3 + 1] = v.y;
+			vw[j * 3 + 2] = v.z;
+		}
+
+		if (surface_indices.size() > 0) {
+			for (int j = 0; j < surface_indices.size(); ++j) {
+				indices.push_back(offset + surface_indices[j]);
+			}
+		} else {
+			for (int j = 0; j < vc - vc % 3; ++j) {
+				indices.push_back(offset + j);
+			}
+		}
+	}
+
+	if (indices.size() < 3) {
+		return Vector<Vector<Vector3>>();
+	}
+
+	Mesh::ConvexDecompositionSettings settings;
+
+	return Mesh::convex_decomposition_function(vertices.ptr(), vertices.size() / 3, indices.ptr(), indices.size() / 3, settings, nullptr);
+}
+
+void MDRImportPluginBase::add_convex_colliders(Ref<MeshDataResource> mdr, const Vector<Vector<Vector3>> &hulls, Vector3 scale) {
+	for (int i = 0; i < hulls.size(); ++i) {
+		Ref<ConvexPolygonShape> shape;
+		shape.instantiate();
+		shape->set_points(hulls[i]);
+
+		mdr->add_collision_shape(Transform(), scale_shape(shape, scale));
+	}
+}
+
+void MDRImportPluginBase::apply_optimization(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options) {
+	MDRImportPluginBase::MDROptimizationType optimization_type = static_cast<MDRImportPluginBase::MDROptimizationType>(static_cast<int>(p_options["optimization_type"]));
+
+	switch (optimization_type) {
+		case MDR_OPTIMIZATION_OFF:
+			break;
+#if MESH_UTILS_PRESENT
+		case MDR_OPTIMIZATION_REMOVE_DOUBLES:
+			mdr->set_array(MeshUtils::get_singleton()->remove_doubles(mdr->get_array()));
+			break;
+		case MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS:
+			mdr->set_array(MeshUtils::get_singleton()->remove_doubles_interpolate_normals(mdr->get_array()));
+			break;
+#endif
+		case MDR_OPTIMIZATION_VERTEX_CACHE:
+		case MDR_OPTIMIZATION_VERTEX_CACHE_AND_FETCH:
+			mdr->optimize_vertex_cache();
+			break;
+	}
+
+	//Needs to run after the vertex cache pass, as it builds on its ordering, but before the vertex fetch pass
+	if (static_cast<bool>(p_options["optimize_overdraw"]) && !mdr->is_2d()) {
+		mdr->optimize_overdraw(p_options["overdraw_threshold"]);
+	}
+
+	if (optimization_type == MDR_OPTIMIZATION_VERTEX_CACHE_AND_FETCH) {
+		mdr->optimize_vertex_fetch();
+	}
+}
+
+void MDRImportPluginBase::apply_lods(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options) {
+	if (!static_cast<bool>(p_options["generate_lods"]) || mdr->is_2d()) {
+		return;
+	}
+
+	mdr->generate_lods(p_options["lod_count"], p_options["lod_max_error"]);
+}
+
+void MDRImportPluginBase::apply_clusters(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options) {
+	if (!static_cast<bool>(p_options["build_clusters"]) || mdr->is_2d()) {
+		return;
+	}
+
+	mdr->build_clusters();
+}
+
+int MDRImportPluginBase::apply_quantization(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options, Variant *r_metadata) {
+	int quantization = p_options["quantization"];
+
+	if (quantization == MeshDataResource::QUANTIZATION_NONE) {
+		return 0;
+	}
+
+	int size_before = mdr->get_geometry_memory_usage();
+
+	mdr->set_quantization(quantization);
+
+	int bytes_saved = size_before - mdr->get_geometry_memory_usage();
+
+	print_verbose("MDRImportPlugin: quantization saved " + itos(bytes_saved) + " bytes (" + itos(size_before) + " -> " + itos(size_before - bytes_saved) + ").");
+
+	add_quantization_metadata(r_metadata, bytes_saved);
+
+	return bytes_saved;
+}
+
+void MDRImportPluginBase::add_quantization_metadata(Variant *r_metadata, const int bytes_saved) {
+	if (!r_metadata || bytes_saved == 0) {
+		return;
+	}
+
+	//Summed up for every MeshDataResource of the imported file
+	Dictionary metadata;
+
+	if (r_metadata->get_type() == Variant::DICTIONARY) {
+		metadata = *r_metadata;
+	}
+
+	metadata["quantization_bytes_saved"] = static_cast<int>(metadata.get("quantization_bytes_saved", 0)) + bytes_saved;
+
+	*r_metadata = metadata;
+}
+
 void MDRImportPluginBase::save_mdr_copy_as_tres(const String &p_source_file, const Ref<MeshDataResource> &res, bool indexed, int index) {
 	String sp = p_source_file;
 	String ext = p_source_file.get_extension();
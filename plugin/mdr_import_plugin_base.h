@@ -71,6 +71,9 @@ public:
 	static const String BINDING_MDR_SURFACE_HANDLING_TYPE;
 	static const String BINDING_MDR_OPTIMIZATION_TYPE;
 
+	//Bump when the processing changes in a way that makes the cached results outdated
+	static const int IMPORT_CACHE_VERSION = 1;
+
 	enum MDRImportType {
 		MDR_IMPORT_TIME_SINGLE = 0,
 		//MDR_IMPORT_TIME_SINGLE_MERGED,
@@ -84,12 +87,15 @@ public:
 		MDR_SURFACE_HANDLING_TYPE_MERGE,
 	};
 
+	//Explicit values, so saved import settings mean the same with and without mesh_utils
 	enum MDROptimizationType {
 		MDR_OPTIMIZATION_OFF = 0,
 #if MESH_UTILS_PRESENT
-		MDR_OPTIMIZATION_REMOVE_DOUBLES,
-		MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS,
+		MDR_OPTIMIZATION_REMOVE_DOUBLES = 1,
+		MDR_OPTIMIZATION_REMOVE_DOUBLES_INTERPOLATE_NORMALS = 2,
 #endif
+		MDR_OPTIMIZATION_VERTEX_CACHE = 3,
+		MDR_OPTIMIZATION_VERTEX_CACHE_AND_FETCH = 4,
 	};
 
 public:
@@ -103,6 +109,9 @@ public:
 	Error process_node_single_separated_bones(Node *n, const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata);
 	Error process_node_multi(Node *n, const String &p_source_file, const String &p_save_path, const HashMap<StringName, Variant> &p_options, List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata, Ref<MeshDataResourceCollection> coll, Ref<MeshDataResourceCollection> copy_coll, int node_count = 0);
 	Vector<Ref<MeshDataResource>> get_meshes(MeshInstance *mi, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale);
+	//get_meshes() in two steps, only the first one needs the main thread
+	Vector<Array> get_surface_arrays(const Ref<ArrayMesh> &mesh, const HashMap<StringName, Variant> &p_options);
+	Vector<Ref<MeshDataResource>> get_meshes_from_arrays(const Vector<Array> &surfaces, Ref<ArrayMesh> mesh, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale);
 	Ref<MeshDataResource> get_mesh_arrays(Array &arrs, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale);
 	void add_colliders(Ref<MeshDataResource> mdr, Ref<ArrayMesh> mesh, const HashMap<StringName, Variant> &p_options, MeshDataResource::ColliderType collider_type, Vector3 scale);
 
@@ -111,11 +120,71 @@ public:
 	Array apply_transforms(Array &array, const HashMap<StringName, Variant> &p_options);
 	Ref<Shape> scale_shape(Ref<Shape> shape, const Vector3 &scale);
 
+	//Only touches the arrays, so it can run on any thread
+	static Vector<Vector<Vector3>> decompose_convex(const Vector<Array> &surfaces);
+	void add_convex_colliders(Ref<MeshDataResource> mdr, const Vector<Vector<Vector3>> &hulls, Vector3 scale);
+
+	void apply_optimization(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options);
+	void apply_lods(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options);
+	void apply_clusters(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options);
+
+	//Returns the number of bytes saved
+	int apply_quantization(Ref<MeshDataResource> mdr, const HashMap<StringName, Variant> &p_options, Variant *r_metadata);
+	void add_quantization_metadata(Variant *r_metadata, const int bytes_saved);
+
+	//Also removes the file a previous, .res based import saved in its place
+	Error save_resource(const Ref<Resource> &res, const String &p_path);
 	void save_mdr_copy_as_tres(const String &p_source_file, const Ref<MeshDataResource> &res, bool indexed = false, int index = 0);
 	void save_mdrcoll_copy_as_tres(const String &p_source_file, const Ref<MeshDataResourceCollection> &res);
 
 	MDRImportPluginBase();
 	~MDRImportPluginBase();
+
+protected:
+	//A MeshInstance of the imported scene, for process_node_multi()
+	struct MeshJob {
+		String node_name;
+		int node_count;
+		Ref<ArrayMesh> mesh;
+		Vector<Array> surfaces;
+		//The mesh's other surfaces, as the colliders can depend on them
+		Vector<Array> collider_surfaces;
+		//Of the whole mesh, with multiple convex colliders, decomposed on the worker
+		Vector<Vector<Vector3>> convex_hulls;
+
+		//Of the surfaces and the options that affect the results
+		String hash;
+		//The mdrs were loaded from the import cache, from these files
+		bool cached;
+		Vector<String> cached_files;
+
+		Vector<Ref<MeshDataResource>> mdrs;
+		int quantization_bytes_saved;
+
+		MeshJob() {
+			node_count = 0;
+			cached = false;
+			quantization_bytes_saved = 0;
+		}
+	};
+
+	struct MeshJobData {
+		MDRImportPluginBase *plugin;
+		const HashMap<StringName, Variant> *options;
+		MeshJob *jobs;
+	};
+
+	void collect_mesh_jobs(Node *n, const HashMap<StringName, Variant> &p_options, Vector<MeshJob> &r_jobs, int node_count = 0);
+	void hash_mesh_job(MeshJob &job, const HashMap<StringName, Variant> &p_options);
+	void process_mesh_job(MeshJob &job, const HashMap<StringName, Variant> &p_options);
+	static void _hash_mesh_job(void *p_userdata, uint32_t p_index);
+	static void _process_mesh_job(void *p_userdata, uint32_t p_index);
+
+	//Maps the job hashes of the previous import to its results, stored next to the imported file
+	Dictionary load_import_cache(const String &p_save_path);
+	void save_import_cache(const String &p_save_path, const Vector<MeshJob> &jobs);
+	bool load_cached_mesh_job(MeshJob &job, const Dictionary &cache);
+	void add_import_cache_metadata(Variant *r_metadata, const int hits, const int misses);
 };
 
 #endif
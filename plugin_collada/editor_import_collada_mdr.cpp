@@ -35,7 +35,8 @@ void EditorImportColladaMdr::get_recognized_extensions(List<String> *p_extension
 }
 
 String EditorImportColladaMdr::get_save_extension() const {
-	return "res";
+	//Saved with ResourceFormatSaverMDRes
+	return "mdres";
 }
 
 String EditorImportColladaMdr::get_resource_type() const {
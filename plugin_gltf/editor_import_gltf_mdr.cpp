@@ -36,7 +36,8 @@ void EditorImportGLTFMdr::get_recognized_extensions(List<String> *p_extensions)
 }
 
 String EditorImportGLTFMdr::get_save_extension() const {
-	return "res";
+	//Saved with ResourceFormatSaverMDRes
+	return "mdres";
 }
 
 String EditorImportGLTFMdr::get_resource_type() const {
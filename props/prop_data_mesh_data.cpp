@@ -25,6 +25,7 @@ SOFTWARE.
 #if PROPS_PRESENT
 
 #include "../nodes/mesh_data_instance.h"
+#include "../utils/mdr_material_cache.h"
 #include "scene/resources/material.h"
 
 Ref<MeshDataResource> PropDataMeshData::get_mesh() const {
@@ -78,27 +79,37 @@ void PropDataMeshData::_processor_process(Ref<PropData> prop_data, Node *node, c
 	m.instantiate();
 	m->set_mesh(i->get_mesh_data());
 	m->set_texture(i->get_texture());
+	m->set_snap_to_mesh(i->get_snap_to_mesh());
+	m->set_snap_axis(i->get_snap_axis());
 	m->set_transform(transform * i->get_transform());
 	prop_data->add_prop(m);
 }
 
+Ref<Material> PropDataMeshData::get_base_material() {
+	return MDRMaterialCache::get_base_material();
+}
+void PropDataMeshData::set_base_material(const Ref<Material> &material) {
+	MDRMaterialCache::set_base_material(material);
+}
+
 Node *PropDataMeshData::_processor_get_node_for(const Transform &transform) {
 	MeshDataInstance *i = memnew(MeshDataInstance);
 
-	Ref<SpatialMaterial> m;
-	m.instantiate();
-
-	i->set_material(m);
+	//Nodes with the same texture share their material, so they can be batched
+	i->set_material(MDRMaterialCache::get_material(get_texture(), MDRMaterialCache::get_base_material()));
 	i->set_texture(get_texture());
 	i->set_mesh_data(get_mesh());
 	i->set_transform(get_transform());
+	//The instance snaps itself once it enters the tree
+	i->set_snap_to_mesh(get_snap_to_mesh());
+	i->set_snap_axis(get_snap_axis());
 
 	return i;
 }
 
 PropDataMeshData::PropDataMeshData() {
 	_snap_to_mesh = false;
-	_snap_axis = Vector3(0, 1, 0);
+	_snap_axis = Vector3(0, -1, 0);
 }
 PropDataMeshData::~PropDataMeshData() {
 	if (_mesh.is_valid())
@@ -122,6 +133,9 @@ void PropDataMeshData::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_snap_axis", "value"), &PropDataMeshData::set_snap_axis);
 	ADD_PROPERTY(PropertyInfo(Variant::VECTOR3, "snap_axis"), "set_snap_axis", "get_snap_axis");
 
+	ClassDB::bind_static_method("PropDataMeshData", D_METHOD("get_base_material"), &PropDataMeshData::get_base_material);
+	ClassDB::bind_static_method("PropDataMeshData", D_METHOD("set_base_material", "material"), &PropDataMeshData::set_base_material);
+
 #if TEXTURE_PACKER_PRESENT
 	ClassDB::bind_method(D_METHOD("_add_textures_into", "texture_packer"), &PropDataMeshData::_add_textures_into);
 #endif
@@ -54,6 +54,10 @@ public:
 	Vector3 get_snap_axis();
 	void set_snap_axis(Vector3 value);
 
+	//Used as the template for the materials of the spawned nodes
+	static Ref<Material> get_base_material();
+	static void set_base_material(const Ref<Material> &material);
+
 #if TEXTURE_PACKER_PRESENT
 	void _add_textures_into(Ref<TexturePacker> texture_packer);
 #endif
@@ -22,10 +22,20 @@ SOFTWARE.
 
 #include "register_types.h"
 
+#include "core/config/engine.h"
+#include "core/config/project_settings.h"
+
 #include "mesh_data_resource.h"
 #include "mesh_data_resource_collection.h"
+#include "io/resource_format_mdres.h"
+#include "utils/mdr_material_cache.h"
+#include "utils/mdr_mesh_uploader.h"
+#include "utils/mdr_texture_cache.h"
 #include "nodes/mesh_data_instance.h"
 #include "nodes/mesh_data_instance_2d.h"
+#include "nodes/mesh_data_multi_instance.h"
+#include "nodes/mesh_data_static_batch.h"
+#include "singleton/mesh_data_server.h"
 
 #ifdef TOOLS_ENABLED
 #include "editor/editor_plugin.h"
@@ -45,13 +55,35 @@ SOFTWARE.
 #include "props_2d/prop_2d_data_mesh_data.h"
 #endif
 
+static Ref<ResourceFormatLoaderMDRes> resource_loader_mdres;
+static Ref<ResourceFormatSaverMDRes> resource_saver_mdres;
+
+static MeshDataServer *mesh_data_server = nullptr;
+
 void initialize_mesh_data_resource_module(ModuleInitializationLevel p_level) {
 	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
 		GDREGISTER_CLASS(MeshDataResource);
 		GDREGISTER_CLASS(MeshDataResourceCollection);
 
+		GLOBAL_DEF("mesh_data_resource/lazy_load_geometry", false);
+		GLOBAL_DEF("mesh_data_resource/upload_budget_kb_per_frame", 4096);
+		GLOBAL_DEF("mesh_data_resource/prop_base_material", "");
+		ProjectSettings::get_singleton()->set_custom_property_info("mesh_data_resource/prop_base_material", PropertyInfo(Variant::STRING, "mesh_data_resource/prop_base_material", PROPERTY_HINT_FILE, "*.tres,*.res,*.material"));
+
+		resource_loader_mdres.instantiate();
+		ResourceLoader::add_resource_format_loader(resource_loader_mdres, true);
+
+		resource_saver_mdres.instantiate();
+		ResourceSaver::add_resource_format_saver(resource_saver_mdres, true);
+
 		GDREGISTER_CLASS(MeshDataInstance);
 		GDREGISTER_CLASS(MeshDataInstance2D);
+		GDREGISTER_CLASS(MeshDataMultiInstance);
+		GDREGISTER_CLASS(MeshDataStaticBatch);
+
+		GDREGISTER_CLASS(MeshDataServer);
+		mesh_data_server = memnew(MeshDataServer);
+		Engine::get_singleton()->add_singleton(Engine::Singleton("MeshDataServer", MeshDataServer::get_singleton()));
 
 #if PROPS_PRESENT
 		GDREGISTER_CLASS(PropDataMeshData);
@@ -76,4 +108,19 @@ void initialize_mesh_data_resource_module(ModuleInitializationLevel p_level) {
 }
 
 void uninitialize_mesh_data_resource_module(ModuleInitializationLevel p_level) {
+	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
+		Engine::get_singleton()->remove_singleton("MeshDataServer");
+		memdelete(mesh_data_server);
+		mesh_data_server = nullptr;
+
+		MDRMeshUploader::clear();
+		MDRMaterialCache::clear();
+		MDRTextureCache::clear();
+
+		ResourceLoader::remove_resource_format_loader(resource_loader_mdres);
+		resource_loader_mdres.unref();
+
+		ResourceSaver::remove_resource_format_saver(resource_saver_mdres);
+		resource_saver_mdres.unref();
+	}
 }
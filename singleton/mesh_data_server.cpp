@@ -0,0 +1,586 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mesh_data_server.h"
+
+#include "core/os/thread.h"
+#include "scene/main/scene_tree.h"
+#include "servers/physics_server_3d.h"
+#include "servers/rendering_server.h"
+
+MeshDataServer *MeshDataServer::_self = nullptr;
+
+MeshDataServer *MeshDataServer::get_singleton() {
+	return _self;
+}
+
+RID MeshDataServer::instance_create(const Ref<MeshDataResource> &p_mesh) {
+	MutexLock lock(_mutex);
+
+	return _create(p_mesh);
+}
+
+void MeshDataServer::instance_free(const RID &p_instance) {
+	MutexLock lock(_mutex);
+
+	_free(p_instance);
+}
+
+bool MeshDataServer::instance_is_valid(const RID &p_instance) {
+	MutexLock lock(_mutex);
+
+	return _instances.owns(p_instance);
+}
+
+void MeshDataServer::instance_set_mesh_data(const RID &p_instance, const Ref<MeshDataResource> &p_mesh) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->mesh = p_mesh;
+
+	_mark_dirty(p_instance, instance, DIRTY_MESH | DIRTY_MATERIAL | DIRTY_BODY);
+}
+
+Ref<MeshDataResource> MeshDataServer::instance_get_mesh_data(const RID &p_instance) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND_V(!instance, Ref<MeshDataResource>());
+
+	return instance->mesh;
+}
+
+void MeshDataServer::instance_set_material(const RID &p_instance, const Ref<Material> &p_material) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->material = p_material;
+
+	_mark_dirty(p_instance, instance, DIRTY_MATERIAL);
+}
+
+void MeshDataServer::instance_set_scenario(const RID &p_instance, const RID &p_scenario) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->scenario = p_scenario;
+
+	_mark_dirty(p_instance, instance, DIRTY_SCENARIO);
+}
+
+void MeshDataServer::instance_set_transform(const RID &p_instance, const Transform &p_transform) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->transform = p_transform;
+
+	_mark_dirty(p_instance, instance, DIRTY_TRANSFORM);
+}
+
+Transform MeshDataServer::instance_get_transform(const RID &p_instance) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND_V(!instance, Transform());
+
+	return instance->transform;
+}
+
+void MeshDataServer::instance_set_visible(const RID &p_instance, const bool p_visible) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	if (instance->visible == p_visible) {
+		return;
+	}
+
+	instance->visible = p_visible;
+
+	_mark_dirty(p_instance, instance, DIRTY_VISIBILITY);
+}
+
+void MeshDataServer::instance_set_space(const RID &p_instance, const RID &p_space) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->space = p_space;
+
+	_mark_dirty(p_instance, instance, DIRTY_BODY);
+}
+
+void MeshDataServer::instance_set_collision_layer(const RID &p_instance, const uint32_t p_layer) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->collision_layer = p_layer;
+
+	_mark_dirty(p_instance, instance, DIRTY_BODY);
+}
+
+void MeshDataServer::instance_set_collision_mask(const RID &p_instance, const uint32_t p_mask) {
+	MutexLock lock(_mutex);
+
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	instance->collision_mask = p_mask;
+
+	_mark_dirty(p_instance, instance, DIRTY_BODY);
+}
+
+Array MeshDataServer::instances_create(const Ref<MeshDataResource> &p_mesh, const PoolRealArray &p_transforms, const RID &p_scenario, const RID &p_space) {
+	ERR_FAIL_COND_V(p_transforms.size() % TRANSFORM_STRIDE != 0, Array());
+
+	int count = p_transforms.size() / TRANSFORM_STRIDE;
+	const float *r = p_transforms.ptr();
+
+	Array instances;
+	instances.resize(count);
+
+	MutexLock lock(_mutex);
+
+	for (int i = 0; i < count; ++i) {
+		RID rid = _create(p_mesh);
+		Instance *instance = _instances.get_or_null(rid);
+
+		instance->transform = _read_transform(r + i * TRANSFORM_STRIDE);
+		instance->scenario = p_scenario;
+		instance->space = p_space;
+
+		instances[i] = rid;
+	}
+
+	return instances;
+}
+
+void MeshDataServer::instances_free(const Array &p_instances) {
+	MutexLock lock(_mutex);
+
+	for (int i = 0; i < p_instances.size(); ++i) {
+		_free(p_instances[i]);
+	}
+}
+
+void MeshDataServer::instances_set_transforms(const Array &p_instances, const PoolRealArray &p_transforms) {
+	ERR_FAIL_COND(p_transforms.size() != p_instances.size() * TRANSFORM_STRIDE);
+
+	const float *r = p_transforms.ptr();
+
+	MutexLock lock(_mutex);
+
+	for (int i = 0; i < p_instances.size(); ++i) {
+		RID rid = p_instances[i];
+		Instance *instance = _instances.get_or_null(rid);
+
+		ERR_CONTINUE(!instance);
+
+		instance->transform = _read_transform(r + i * TRANSFORM_STRIDE);
+
+		_mark_dirty(rid, instance, DIRTY_TRANSFORM);
+	}
+}
+
+void MeshDataServer::instances_set_visible(const Array &p_instances, const bool p_visible) {
+	MutexLock lock(_mutex);
+
+	for (int i = 0; i < p_instances.size(); ++i) {
+		RID rid = p_instances[i];
+		Instance *instance = _instances.get_or_null(rid);
+
+		ERR_CONTINUE(!instance);
+
+		if (instance->visible == p_visible) {
+			continue;
+		}
+
+		instance->visible = p_visible;
+
+		_mark_dirty(rid, instance, DIRTY_VISIBILITY);
+	}
+}
+
+int MeshDataServer::get_instance_count() {
+	MutexLock lock(_mutex);
+
+	return _instances.get_rid_count();
+}
+
+int MeshDataServer::get_pending_count() {
+	MutexLock lock(_mutex);
+
+	return _dirty_instances.size() + _freed_instances.size();
+}
+
+void MeshDataServer::flush() {
+	ERR_FAIL_COND(!Thread::is_main_thread());
+
+	MutexLock lock(_mutex);
+
+	for (int i = 0; i < _freed_instances.size(); ++i) {
+		_free_server_objects(_freed_instances.write[i]);
+	}
+
+	_freed_instances.clear();
+
+	for (int i = 0; i < _dirty_instances.size(); ++i) {
+		Instance *instance = _instances.get_or_null(_dirty_instances[i]);
+
+		//Freed since
+		if (!instance) {
+			continue;
+		}
+
+		_apply(instance);
+	}
+
+	_dirty_instances.clear();
+
+	bool materials_dirty = false;
+
+	for (HashMap<ObjectID, MeshEntry>::Iterator E = _meshes.begin(); E; ++E) {
+		//Only does anything if the geometry changed since
+		E->value.mesh->get_mesh_rid();
+
+		materials_dirty = materials_dirty || E->value.materials_dirty;
+	}
+
+	if (!materials_dirty) {
+		return;
+	}
+
+	//The surface override materials got dropped when the meshes' surfaces were replaced
+	List<RID> owned;
+	_instances.get_owned_list(&owned);
+
+	for (List<RID>::Element *E = owned.front(); E; E = E->next()) {
+		Instance *instance = _instances.get_or_null(E->get());
+
+		if (!instance || instance->instance == RID() || !instance->shared_mesh.is_valid()) {
+			continue;
+		}
+
+		MeshEntry *entry = _meshes.getptr(instance->shared_mesh->get_instance_id());
+
+		if (entry && entry->materials_dirty) {
+			_apply_material(instance);
+		}
+	}
+
+	for (HashMap<ObjectID, MeshEntry>::Iterator E = _meshes.begin(); E; ++E) {
+		E->value.materials_dirty = false;
+	}
+}
+
+void MeshDataServer::clear() {
+	MutexLock lock(_mutex);
+
+	List<RID> owned;
+	_instances.get_owned_list(&owned);
+
+	for (List<RID>::Element *E = owned.front(); E; E = E->next()) {
+		_free(E->get());
+	}
+
+	for (int i = 0; i < _freed_instances.size(); ++i) {
+		_free_server_objects(_freed_instances.write[i]);
+	}
+
+	_freed_instances.clear();
+	_dirty_instances.clear();
+}
+
+MeshDataServer::MeshDataServer() {
+	_self = this;
+	_connected = false;
+	_connect_queued = false;
+}
+
+MeshDataServer::~MeshDataServer() {
+	clear();
+
+	_self = nullptr;
+}
+
+RID MeshDataServer::_create(const Ref<MeshDataResource> &p_mesh) {
+	Instance instance;
+	instance.mesh = p_mesh;
+
+	RID rid = _instances.make_rid(instance);
+
+	_mark_dirty(rid, _instances.get_or_null(rid), DIRTY_ALL);
+
+	return rid;
+}
+
+void MeshDataServer::_free(const RID &p_instance) {
+	Instance *instance = _instances.get_or_null(p_instance);
+	ERR_FAIL_COND(!instance);
+
+	//If it never got flushed, there is nothing to free on the servers
+	if (instance->instance != RID()) {
+		_freed_instances.push_back(*instance);
+		_connect();
+	}
+
+	_instances.free(p_instance);
+}
+
+void MeshDataServer::_mark_dirty(const RID &p_rid, Instance *p_instance, const uint32_t p_flags) {
+	if (p_instance->dirty == 0) {
+		_dirty_instances.push_back(p_rid);
+	}
+
+	p_instance->dirty |= p_flags;
+
+	_connect();
+}
+
+void MeshDataServer::_apply(Instance *p_instance) {
+	RenderingServer *rs = RS::get_singleton();
+	PhysicsServer3D *ps = PhysicsServer3D::get_singleton();
+
+	uint32_t dirty = p_instance->dirty;
+	p_instance->dirty = 0;
+
+	if (p_instance->instance == RID()) {
+		p_instance->instance = rs->instance_create();
+	}
+
+	if (dirty & DIRTY_MESH) {
+		if (p_instance->shared_mesh != p_instance->mesh) {
+			_release_mesh(p_instance->shared_mesh);
+
+			p_instance->shared_mesh = p_instance->mesh;
+
+			rs->instance_set_base(p_instance->instance, _acquire_mesh(p_instance->shared_mesh));
+		}
+	}
+
+	if (dirty & DIRTY_MATERIAL) {
+		_apply_material(p_instance);
+	}
+
+	if (dirty & DIRTY_SCENARIO) {
+		rs->instance_set_scenario(p_instance->instance, p_instance->scenario);
+	}
+
+	if (dirty & DIRTY_TRANSFORM) {
+		rs->instance_set_transform(p_instance->instance, p_instance->transform);
+
+		if (p_instance->body != RID()) {
+			ps->body_set_state(p_instance->body, PhysicsServer3D::BODY_STATE_TRANSFORM, p_instance->transform);
+		}
+	}
+
+	if (dirty & DIRTY_VISIBILITY) {
+		rs->instance_set_visible(p_instance->instance, p_instance->visible);
+	}
+
+	if (dirty & DIRTY_BODY) {
+		if (p_instance->body != RID()) {
+			ps->free(p_instance->body);
+			p_instance->body = RID();
+		}
+
+		const Ref<MeshDataResource> &mesh = p_instance->mesh;
+
+		if (p_instance->space == RID() || !mesh.is_valid() || mesh->get_collision_shape_count() == 0) {
+			return;
+		}
+
+		p_instance->body = ps->body_create();
+		ps->body_set_mode(p_instance->body, PhysicsServer3D::BODY_MODE_STATIC);
+		ps->body_set_collision_layer(p_instance->body, p_instance->collision_layer);
+		ps->body_set_collision_mask(p_instance->body, p_instance->collision_mask);
+		ps->body_set_state(p_instance->body, PhysicsServer3D::BODY_STATE_TRANSFORM, p_instance->transform);
+
+		for (int i = 0; i < mesh->get_collision_shape_count(); ++i) {
+			Ref<Shape> shape = mesh->get_collision_shape(i);
+
+			ERR_CONTINUE(!shape.is_valid());
+
+			ps->body_add_shape(p_instance->body, shape->get_rid(), mesh->get_collision_shape_offset(i));
+		}
+
+		ps->body_set_space(p_instance->body, p_instance->space);
+	}
+}
+
+void MeshDataServer::_apply_material(Instance *p_instance) {
+	RS::get_singleton()->instance_set_surface_override_material(p_instance->instance, 0, p_instance->material.is_valid() ? p_instance->material->get_rid() : RID());
+}
+
+void MeshDataServer::_free_server_objects(Instance &p_instance) {
+	if (p_instance.body != RID()) {
+		PhysicsServer3D::get_singleton()->free(p_instance.body);
+		p_instance.body = RID();
+	}
+
+	if (p_instance.instance != RID()) {
+		RS::get_singleton()->free(p_instance.instance);
+		p_instance.instance = RID();
+	}
+
+	_release_mesh(p_instance.shared_mesh);
+	p_instance.shared_mesh.unref();
+}
+
+RID MeshDataServer::_acquire_mesh(const Ref<MeshDataResource> &p_mesh) {
+	if (!p_mesh.is_valid()) {
+		return RID();
+	}
+
+	MeshEntry *entry = _meshes.getptr(p_mesh->get_instance_id());
+
+	if (!entry) {
+		_meshes.insert(p_mesh->get_instance_id(), MeshEntry());
+		entry = _meshes.getptr(p_mesh->get_instance_id());
+		entry->mesh = p_mesh;
+
+		Callable on_changed = callable_mp(this, &MeshDataServer::_mesh_changed).bind(static_cast<uint64_t>(p_mesh->get_instance_id()));
+
+		p_mesh->connect("changed", on_changed);
+		p_mesh->connect("mesh_rid_updated", on_changed);
+	}
+
+	++entry->users;
+
+	return p_mesh->acquire_mesh_rid();
+}
+
+void MeshDataServer::_release_mesh(const Ref<MeshDataResource> &p_mesh) {
+	if (!p_mesh.is_valid()) {
+		return;
+	}
+
+	p_mesh->release_mesh_rid();
+
+	MeshEntry *entry = _meshes.getptr(p_mesh->get_instance_id());
+
+	ERR_FAIL_COND(!entry);
+
+	if (--entry->users == 0) {
+		Callable on_changed = callable_mp(this, &MeshDataServer::_mesh_changed).bind(static_cast<uint64_t>(p_mesh->get_instance_id()));
+
+		p_mesh->disconnect("changed", on_changed);
+		p_mesh->disconnect("mesh_rid_updated", on_changed);
+
+		_meshes.erase(p_mesh->get_instance_id());
+	}
+}
+
+void MeshDataServer::_mesh_changed(const uint64_t p_id) {
+	MutexLock lock(_mutex);
+
+	MeshEntry *entry = _meshes.getptr(ObjectID(p_id));
+
+	if (entry) {
+		entry->materials_dirty = true;
+		_connect();
+	}
+}
+
+void MeshDataServer::_connect() {
+	if (_connected) {
+		return;
+	}
+
+	//Signals can only be connected on the main thread
+	if (!Thread::is_main_thread()) {
+		if (!_connect_queued) {
+			_connect_queued = true;
+			callable_mp(this, &MeshDataServer::_connect).call_deferred();
+		}
+
+		return;
+	}
+
+	_connect_queued = false;
+
+	SceneTree *tree = SceneTree::get_singleton();
+
+	if (!tree) {
+		return;
+	}
+
+	tree->connect("process_frame", callable_mp(this, &MeshDataServer::flush));
+	_connected = true;
+}
+
+Transform MeshDataServer::_read_transform(const float *p_data) {
+	Transform t;
+
+	for (int i = 0; i < 3; ++i) {
+		t.basis.rows[i] = Vector3(p_data[i * 4], p_data[i * 4 + 1], p_data[i * 4 + 2]);
+		t.origin[i] = p_data[i * 4 + 3];
+	}
+
+	return t;
+}
+
+void MeshDataServer::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("instance_create", "mesh_data"), &MeshDataServer::instance_create);
+	ClassDB::bind_method(D_METHOD("instance_free", "instance"), &MeshDataServer::instance_free);
+	ClassDB::bind_method(D_METHOD("instance_is_valid", "instance"), &MeshDataServer::instance_is_valid);
+
+	ClassDB::bind_method(D_METHOD("instance_set_mesh_data", "instance", "mesh_data"), &MeshDataServer::instance_set_mesh_data);
+	ClassDB::bind_method(D_METHOD("instance_get_mesh_data", "instance"), &MeshDataServer::instance_get_mesh_data);
+
+	ClassDB::bind_method(D_METHOD("instance_set_material", "instance", "material"), &MeshDataServer::instance_set_material);
+	ClassDB::bind_method(D_METHOD("instance_set_scenario", "instance", "scenario"), &MeshDataServer::instance_set_scenario);
+
+	ClassDB::bind_method(D_METHOD("instance_set_transform", "instance", "transform"), &MeshDataServer::instance_set_transform);
+	ClassDB::bind_method(D_METHOD("instance_get_transform", "instance"), &MeshDataServer::instance_get_transform);
+
+	ClassDB::bind_method(D_METHOD("instance_set_visible", "instance", "visible"), &MeshDataServer::instance_set_visible);
+
+	ClassDB::bind_method(D_METHOD("instance_set_space", "instance", "space"), &MeshDataServer::instance_set_space);
+	ClassDB::bind_method(D_METHOD("instance_set_collision_layer", "instance", "layer"), &MeshDataServer::instance_set_collision_layer);
+	ClassDB::bind_method(D_METHOD("instance_set_collision_mask", "instance", "mask"), &MeshDataServer::instance_set_collision_mask);
+
+	ClassDB::bind_method(D_METHOD("instances_create", "mesh_data", "transforms", "scenario", "space"), &MeshDataServer::instances_create, DEFVAL(RID()));
+	ClassDB::bind_method(D_METHOD("instances_free", "instances"), &MeshDataServer::instances_free);
+	ClassDB::bind_method(D_METHOD("instances_set_transforms", "instances", "transforms"), &MeshDataServer::instances_set_transforms);
+	ClassDB::bind_method(D_METHOD("instances_set_visible", "instances", "visible"), &MeshDataServer::instances_set_visible);
+
+	ClassDB::bind_method(D_METHOD("get_instance_count"), &MeshDataServer::get_instance_count);
+	ClassDB::bind_method(D_METHOD("get_pending_count"), &MeshDataServer::get_pending_count);
+
+	ClassDB::bind_method(D_METHOD("flush"), &MeshDataServer::flush);
+	ClassDB::bind_method(D_METHOD("clear"), &MeshDataServer::clear);
+
+	BIND_CONSTANT(TRANSFORM_STRIDE);
+}
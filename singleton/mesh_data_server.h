@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MESH_DATA_SERVER_H
+#define MESH_DATA_SERVER_H
+
+#include "core/object/object.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/rid_owner.h"
+#include "core/templates/vector.h"
+#include "scene/resources/material.h"
+
+#include "../mesh_data_resource.h"
+
+//Manages MeshDataResource instances without nodes. The calls only record the new state, it's applied to the
+//RenderingServer and the PhysicsServer3D once per frame, so they are cheap, and can be used from any thread.
+class MeshDataServer : public Object {
+	GDCLASS(MeshDataServer, Object);
+
+public:
+	static MeshDataServer *get_singleton();
+
+	//Floats per instance transform in the bulk calls, same layout as MeshDataMultiInstance's
+	static const int TRANSFORM_STRIDE = 12;
+
+	RID instance_create(const Ref<MeshDataResource> &p_mesh);
+	void instance_free(const RID &p_instance);
+	bool instance_is_valid(const RID &p_instance);
+
+	void instance_set_mesh_data(const RID &p_instance, const Ref<MeshDataResource> &p_mesh);
+	Ref<MeshDataResource> instance_get_mesh_data(const RID &p_instance);
+
+	void instance_set_material(const RID &p_instance, const Ref<Material> &p_material);
+	void instance_set_scenario(const RID &p_instance, const RID &p_scenario);
+
+	void instance_set_transform(const RID &p_instance, const Transform &p_transform);
+	Transform instance_get_transform(const RID &p_instance);
+
+	void instance_set_visible(const RID &p_instance, const bool p_visible);
+
+	//With a valid space, a static body is created with the collision shapes of the mesh
+	void instance_set_space(const RID &p_instance, const RID &p_space);
+	void instance_set_collision_layer(const RID &p_instance, const uint32_t p_layer);
+	void instance_set_collision_mask(const RID &p_instance, const uint32_t p_mask);
+
+	//Bulk versions, the transforms take TRANSFORM_STRIDE floats each
+	Array instances_create(const Ref<MeshDataResource> &p_mesh, const PoolRealArray &p_transforms, const RID &p_scenario, const RID &p_space = RID());
+	void instances_free(const Array &p_instances);
+	void instances_set_transforms(const Array &p_instances, const PoolRealArray &p_transforms);
+	void instances_set_visible(const Array &p_instances, const bool p_visible);
+
+	int get_instance_count();
+	int get_pending_count();
+
+	//Applies every change. Called on SceneTree's process_frame.
+	void flush();
+	//Frees every instance
+	void clear();
+
+	MeshDataServer();
+	~MeshDataServer();
+
+protected:
+	enum DirtyFlags {
+		DIRTY_MESH = 1 << 0,
+		DIRTY_MATERIAL = 1 << 1,
+		DIRTY_SCENARIO = 1 << 2,
+		DIRTY_TRANSFORM = 1 << 3,
+		DIRTY_VISIBILITY = 1 << 4,
+		DIRTY_BODY = 1 << 5,
+		DIRTY_ALL = (1 << 6) - 1,
+	};
+
+	struct Instance {
+		Ref<MeshDataResource> mesh;
+		Ref<Material> material;
+		RID scenario;
+		RID space;
+		Transform transform;
+		bool visible;
+		uint32_t collision_layer;
+		uint32_t collision_mask;
+
+		uint32_t dirty;
+
+		//The server side objects, only touched by flush()
+		Ref<MeshDataResource> shared_mesh;
+		RID instance;
+		RID body;
+
+		Instance() {
+			visible = true;
+			collision_layer = 1;
+			collision_mask = 1;
+			dirty = 0;
+		}
+	};
+
+	//The meshes the instances use, their RenderingServer meshes are updated in flush() if they changed
+	struct MeshEntry {
+		Ref<MeshDataResource> mesh;
+		int users;
+		//Set when the mesh's surfaces get replaced, its instances' materials have to be set again
+		bool materials_dirty;
+
+		MeshEntry() {
+			users = 0;
+			materials_dirty = false;
+		}
+	};
+
+	static void _bind_methods();
+
+	RID _create(const Ref<MeshDataResource> &p_mesh);
+	void _free(const RID &p_instance);
+	void _mark_dirty(const RID &p_rid, Instance *p_instance, const uint32_t p_flags);
+	void _apply(Instance *p_instance);
+	void _apply_material(Instance *p_instance);
+	void _free_server_objects(Instance &p_instance);
+	RID _acquire_mesh(const Ref<MeshDataResource> &p_mesh);
+	void _release_mesh(const Ref<MeshDataResource> &p_mesh);
+	void _mesh_changed(const uint64_t p_id);
+	void _connect();
+
+	static Transform _read_transform(const float *p_data);
+
+	static MeshDataServer *_self;
+
+private:
+	RID_Owner<Instance> _instances;
+	Vector<RID> _dirty_instances;
+	//Instances that were freed after they got their server side objects
+	Vector<Instance> _freed_instances;
+	HashMap<ObjectID, MeshEntry> _meshes;
+	bool _connected;
+	bool _connect_queued;
+	Mutex _mutex;
+};
+
+#endif
@@ -0,0 +1,231 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_bounds.h"
+
+#include "core/object/worker_thread_pool.h"
+
+#ifndef REAL_T_IS_DOUBLE
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MDR_BOUNDS_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MDR_BOUNDS_NEON
+#endif
+#endif
+
+#if defined(MDR_BOUNDS_SSE)
+typedef __m128 mdr_f4;
+#define MDR_F4_LOAD(p) _mm_loadu_ps(p)
+#define MDR_F4_MIN(a, b) _mm_min_ps(a, b)
+#define MDR_F4_MAX(a, b) _mm_max_ps(a, b)
+#define MDR_F4_STORE(p, a) _mm_storeu_ps(p, a)
+#define MDR_BOUNDS_SIMD
+#elif defined(MDR_BOUNDS_NEON)
+typedef float32x4_t mdr_f4;
+#define MDR_F4_LOAD(p) vld1q_f32(p)
+#define MDR_F4_MIN(a, b) vminq_f32(a, b)
+#define MDR_F4_MAX(a, b) vmaxq_f32(a, b)
+#define MDR_F4_STORE(p, a) vst1q_f32(p, a)
+#define MDR_BOUNDS_SIMD
+#endif
+
+AABB MDRBounds::compute_aabb(const Vector3 *p_vertices, const int p_count) {
+	if (p_count <= 0) {
+		return AABB();
+	}
+
+	Vector3 min;
+	Vector3 max;
+
+	if (p_count >= PARALLEL_VERTEX_THRESHOLD) {
+		_reduce_parallel(&p_vertices[0].x, 3, p_count, min, max);
+	} else {
+		_reduce(&p_vertices[0].x, 3, p_count, min, max);
+	}
+
+	return AABB(min, max - min);
+}
+
+AABB MDRBounds::compute_aabb_2d(const Vector2 *p_vertices, const int p_count) {
+	if (p_count <= 0) {
+		return AABB();
+	}
+
+	Vector3 min;
+	Vector3 max;
+
+	if (p_count >= PARALLEL_VERTEX_THRESHOLD) {
+		_reduce_parallel(&p_vertices[0].x, 2, p_count, min, max);
+	} else {
+		_reduce(&p_vertices[0].x, 2, p_count, min, max);
+	}
+
+	return AABB(min, max - min);
+}
+
+void MDRBounds::_reduce(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max) {
+#ifdef MDR_BOUNDS_SIMD
+	//4 vertices are processed per iteration. The floats of 4 Vector3s fill 3 registers,
+	//4 Vector2s fill 2, so every register lane always holds the same component.
+	const int regs = p_components;
+	const int batch_count = p_vertex_count / 4;
+
+	if (batch_count == 0) {
+		_reduce_scalar(p_data, p_components, p_vertex_count, r_min, r_max);
+		return;
+	}
+
+	mdr_f4 mins[3];
+	mdr_f4 maxs[3];
+
+	for (int i = 0; i < regs; ++i) {
+		mins[i] = MDR_F4_LOAD(p_data + i * 4);
+		maxs[i] = mins[i];
+	}
+
+	for (int b = 1; b < batch_count; ++b) {
+		const float *d = p_data + b * regs * 4;
+
+		for (int i = 0; i < regs; ++i) {
+			mdr_f4 v = MDR_F4_LOAD(d + i * 4);
+
+			mins[i] = MDR_F4_MIN(mins[i], v);
+			maxs[i] = MDR_F4_MAX(maxs[i], v);
+		}
+	}
+
+	float min_lanes[12];
+	float max_lanes[12];
+
+	for (int i = 0; i < regs; ++i) {
+		MDR_F4_STORE(min_lanes + i * 4, mins[i]);
+		MDR_F4_STORE(max_lanes + i * 4, maxs[i]);
+	}
+
+	//Lane j holds component j % p_components
+	r_min = Vector3(min_lanes[0], min_lanes[1], p_components == 3 ? min_lanes[2] : 0);
+	r_max = Vector3(max_lanes[0], max_lanes[1], p_components == 3 ? max_lanes[2] : 0);
+
+	for (int j = p_components; j < regs * 4; ++j) {
+		int c = j % p_components;
+
+		r_min[c] = MIN(r_min[c], min_lanes[j]);
+		r_max[c] = MAX(r_max[c], max_lanes[j]);
+	}
+
+	int done = batch_count * 4;
+
+	if (done < p_vertex_count) {
+		Vector3 tail_min;
+		Vector3 tail_max;
+
+		_reduce_scalar(p_data + done * p_components, p_components, p_vertex_count - done, tail_min, tail_max);
+
+		for (int c = 0; c < p_components; ++c) {
+			r_min[c] = MIN(r_min[c], tail_min[c]);
+			r_max[c] = MAX(r_max[c], tail_max[c]);
+		}
+	}
+#else
+	_reduce_scalar(p_data, p_components, p_vertex_count, r_min, r_max);
+#endif
+}
+
+void MDRBounds::_reduce_scalar(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max) {
+	r_min = Vector3();
+	r_max = Vector3();
+
+	for (int c = 0; c < p_components; ++c) {
+		r_min[c] = p_data[c];
+		r_max[c] = p_data[c];
+	}
+
+	for (int i = 1; i < p_vertex_count; ++i) {
+		const real_t *v = p_data + i * p_components;
+
+		for (int c = 0; c < p_components; ++c) {
+			r_min[c] = MIN(r_min[c], v[c]);
+			r_max[c] = MAX(r_max[c], v[c]);
+		}
+	}
+}
+
+void MDRBounds::_reduce_parallel(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max) {
+	int thread_count = WorkerThreadPool::get_singleton()->get_thread_count();
+	int chunk_count = MAX(1, MIN(thread_count, p_vertex_count / (PARALLEL_VERTEX_THRESHOLD / 4)));
+
+	//A pool thread waiting on its own subtasks can deadlock the pool when every thread does the same
+	if (chunk_count == 1 || WorkerThreadPool::get_singleton()->get_thread_index() != -1) {
+		_reduce(p_data, p_components, p_vertex_count, r_min, r_max);
+		return;
+	}
+
+	Vector<Vector3> mins;
+	Vector<Vector3> maxs;
+	mins.resize(chunk_count);
+	maxs.resize(chunk_count);
+
+	ParallelData data;
+	data.data = p_data;
+	data.components = p_components;
+	data.vertex_count = p_vertex_count;
+	//Multiple of 4, so chunks don't break up the simd batches
+	data.chunk_size = ((p_vertex_count / chunk_count) + 3) & ~3;
+	data.mins = mins.ptrw();
+	data.maxs = maxs.ptrw();
+
+	WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_native_group_task(&MDRBounds::_reduce_chunk, &data, chunk_count, -1, true, "MDRBounds");
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+
+	r_min = mins[0];
+	r_max = maxs[0];
+
+	for (int i = 1; i < chunk_count; ++i) {
+		if (maxs[i].x < mins[i].x) {
+			//Empty chunk
+			continue;
+		}
+
+		for (int c = 0; c < p_components; ++c) {
+			r_min[c] = MIN(r_min[c], mins[i][c]);
+			r_max[c] = MAX(r_max[c], maxs[i][c]);
+		}
+	}
+}
+
+void MDRBounds::_reduce_chunk(void *p_userdata, uint32_t p_index) {
+	ParallelData *data = static_cast<ParallelData *>(p_userdata);
+
+	int from = p_index * data->chunk_size;
+	int count = MIN(data->chunk_size, data->vertex_count - from);
+
+	if (count <= 0) {
+		//Marks the chunk as empty
+		data->mins[p_index] = Vector3(1, 1, 1);
+		data->maxs[p_index] = Vector3(-1, -1, -1);
+		return;
+	}
+
+	_reduce(data->data + from * data->components, data->components, count, data->mins[p_index], data->maxs[p_index]);
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_BOUNDS_H
+#define MDR_BOUNDS_H
+
+#include "core/math/aabb.h"
+#include "core/math/vector2.h"
+#include "core/math/vector3.h"
+
+//Min / max reductions over vertex buffers. Uses SSE or NEON when available, and splits
+//large buffers between the WorkerThreadPool's threads.
+class MDRBounds {
+public:
+	//Below this many vertices the work is not split between threads
+	static const int PARALLEL_VERTEX_THRESHOLD = 65536;
+
+	static AABB compute_aabb(const Vector3 *p_vertices, const int p_count);
+	static AABB compute_aabb_2d(const Vector2 *p_vertices, const int p_count);
+
+protected:
+	struct ParallelData {
+		const real_t *data;
+		int components;
+		int vertex_count;
+		int chunk_size;
+		Vector3 *mins;
+		Vector3 *maxs;
+	};
+
+	static void _reduce(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max);
+	static void _reduce_scalar(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max);
+	static void _reduce_parallel(const real_t *p_data, const int p_components, const int p_vertex_count, Vector3 &r_min, Vector3 &r_max);
+	static void _reduce_chunk(void *p_userdata, uint32_t p_index);
+};
+
+#endif
@@ -0,0 +1,544 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_bvh.h"
+
+#include "core/error/error_macros.h"
+#include "core/math/math_funcs.h"
+
+void MDRBVH::build(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count) {
+	clear();
+
+	int triangle_count = p_index_count / 3;
+
+	if (triangle_count == 0 || p_vertex_count == 0) {
+		return;
+	}
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		ERR_FAIL_COND_MSG(p_indices[i] >= static_cast<uint32_t>(p_vertex_count), "Index out of range!");
+	}
+
+	Vector<Bounds> triangle_bounds;
+	triangle_bounds.resize(triangle_count);
+	Bounds *tbw = triangle_bounds.ptrw();
+
+	Vector<Vector3> centroids;
+	centroids.resize(triangle_count);
+	Vector3 *cw = centroids.ptrw();
+
+	_triangle_ids.resize(triangle_count);
+	uint32_t *idw = _triangle_ids.ptrw();
+
+	Bounds root_bounds;
+	root_bounds.reset();
+
+	for (int i = 0; i < triangle_count; ++i) {
+		const uint32_t *t = p_indices + i * 3;
+
+		Bounds &b = tbw[i];
+		b.reset();
+		b.expand(p_vertices[t[0]]);
+		b.expand(p_vertices[t[1]]);
+		b.expand(p_vertices[t[2]]);
+
+		cw[i] = (b.min + b.max) * 0.5;
+		idw[i] = i;
+
+		root_bounds.merge(b);
+	}
+
+	//A binary tree with single triangle leaves has 2n - 1 nodes, so this is enough
+	_nodes.resize(triangle_count * 2 - 1);
+	Node *nw = _nodes.ptrw();
+	int node_count = 1;
+
+	nw[0].min = root_bounds.min;
+	nw[0].max = root_bounds.max;
+	nw[0].first = 0;
+	nw[0].count = triangle_count;
+
+	struct BuildItem {
+		uint32_t node;
+		int depth;
+	};
+
+	Vector<BuildItem> stack;
+	stack.push_back({ 0, 0 });
+
+	while (stack.size() > 0) {
+		BuildItem item = stack[stack.size() - 1];
+		stack.resize(stack.size() - 1);
+
+		Node &node = nw[item.node];
+
+		if (node.count <= MAX_LEAF_TRIANGLES || item.depth >= MAX_DEPTH) {
+			continue;
+		}
+
+		Bounds centroid_bounds;
+		centroid_bounds.reset();
+
+		for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+			centroid_bounds.expand(cw[idw[i]]);
+		}
+
+		//Evaluate the split planes between the bins on every axis
+		int best_axis = -1;
+		int best_split = 0;
+		real_t best_cost = Math_INF;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			real_t extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+
+			if (extent <= CMP_EPSILON) {
+				continue;
+			}
+
+			Bounds bins[SAH_BIN_COUNT];
+			int bin_counts[SAH_BIN_COUNT];
+
+			for (int i = 0; i < SAH_BIN_COUNT; ++i) {
+				bins[i].reset();
+				bin_counts[i] = 0;
+			}
+
+			real_t scale = SAH_BIN_COUNT / extent;
+
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t id = idw[i];
+				int bin = MIN(static_cast<int>((cw[id][axis] - centroid_bounds.min[axis]) * scale), SAH_BIN_COUNT - 1);
+
+				bins[bin].merge(tbw[id]);
+				++bin_counts[bin];
+			}
+
+			real_t left_areas[SAH_BIN_COUNT - 1];
+			int left_counts[SAH_BIN_COUNT - 1];
+
+			Bounds left;
+			left.reset();
+			int left_count = 0;
+
+			for (int i = 0; i < SAH_BIN_COUNT - 1; ++i) {
+				left.merge(bins[i]);
+				left_count += bin_counts[i];
+
+				left_areas[i] = left.get_area();
+				left_counts[i] = left_count;
+			}
+
+			Bounds right;
+			right.reset();
+			int right_count = 0;
+
+			for (int i = SAH_BIN_COUNT - 1; i > 0; --i) {
+				right.merge(bins[i]);
+				right_count += bin_counts[i];
+
+				if (left_counts[i - 1] == 0 || right_count == 0) {
+					continue;
+				}
+
+				real_t cost = left_areas[i - 1] * left_counts[i - 1] + right.get_area() * right_count;
+
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_axis = axis;
+					best_split = i - 1;
+				}
+			}
+		}
+
+		Bounds node_bounds;
+		node_bounds.min = node.min;
+		node_bounds.max = node.max;
+
+		//Small nodes stay leaves if splitting them isn't worth the extra traversal step
+		real_t node_area = node_bounds.get_area();
+		if (node.count <= MAX_LEAF_TRIANGLES * 4 && best_cost + node_area >= node_area * node.count) {
+			continue;
+		}
+
+		uint32_t mid = node.first;
+
+		if (best_axis != -1) {
+			real_t scale = SAH_BIN_COUNT / (centroid_bounds.max[best_axis] - centroid_bounds.min[best_axis]);
+
+			uint32_t i = node.first;
+			uint32_t j = node.first + node.count;
+
+			while (i < j) {
+				int bin = MIN(static_cast<int>((cw[idw[i]][best_axis] - centroid_bounds.min[best_axis]) * scale), SAH_BIN_COUNT - 1);
+
+				if (bin <= best_split) {
+					++i;
+				} else {
+					--j;
+					SWAP(idw[i], idw[j]);
+				}
+			}
+
+			mid = i;
+		}
+
+		//Every centroid is at the same place (or rounding put them in the same bin), split in the middle
+		if (mid == node.first || mid == node.first + node.count) {
+			mid = node.first + node.count / 2;
+		}
+
+		uint32_t left_index = node_count;
+		node_count += 2;
+
+		Node &left = nw[left_index];
+		Node &right = nw[left_index + 1];
+
+		left.first = node.first;
+		left.count = mid - node.first;
+		right.first = mid;
+		right.count = node.first + node.count - mid;
+
+		for (int c = 0; c < 2; ++c) {
+			Node &child = c == 0 ? left : right;
+
+			Bounds child_bounds;
+			child_bounds.reset();
+
+			for (uint32_t i = child.first; i < child.first + child.count; ++i) {
+				child_bounds.merge(tbw[idw[i]]);
+			}
+
+			child.min = child_bounds.min;
+			child.max = child_bounds.max;
+		}
+
+		node.first = left_index;
+		node.count = 0;
+
+		stack.push_back({ left_index, item.depth + 1 });
+		stack.push_back({ left_index + 1, item.depth + 1 });
+	}
+
+	_nodes.resize(node_count);
+
+	_vertices.resize(triangle_count * 3);
+	Vector3 *vw = _vertices.ptrw();
+
+	for (int i = 0; i < triangle_count; ++i) {
+		const uint32_t *t = p_indices + idw[i] * 3;
+
+		vw[i * 3] = p_vertices[t[0]];
+		vw[i * 3 + 1] = p_vertices[t[1]];
+		vw[i * 3 + 2] = p_vertices[t[2]];
+	}
+}
+
+void MDRBVH::clear() {
+	_nodes.clear();
+	_vertices.clear();
+	_triangle_ids.clear();
+}
+
+bool MDRBVH::is_empty() const {
+	return _nodes.size() == 0;
+}
+
+bool MDRBVH::intersect_ray(const Vector3 &p_from, const Vector3 &p_direction, const real_t p_max_distance, Hit &r_hit) const {
+	if (_nodes.size() == 0) {
+		return false;
+	}
+
+	real_t length = p_direction.length();
+
+	if (length < CMP_EPSILON) {
+		return false;
+	}
+
+	Vector3 direction = p_direction / length;
+	Vector3 inv_direction = Vector3(1.0 / direction.x, 1.0 / direction.y, 1.0 / direction.z);
+
+	const Node *nodes = _nodes.ptr();
+	const Vector3 *vertices = _vertices.ptr();
+
+	if (_intersect_node(nodes[0], p_from, inv_direction, p_max_distance) == Math_INF) {
+		return false;
+	}
+
+	real_t best_distance = p_max_distance;
+	int best_slot = -1;
+
+	//Only the farther child gets left on the stack on every level
+	uint32_t stack[MAX_DEPTH + 2];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		const Node &node = nodes[stack[--stack_size]];
+
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				const Vector3 &a = vertices[i * 3];
+
+				//Möller–Trumbore, without culling back faces
+				Vector3 e1 = vertices[i * 3 + 1] - a;
+				Vector3 e2 = vertices[i * 3 + 2] - a;
+				Vector3 p = direction.cross(e2);
+				real_t det = e1.dot(p);
+
+				if (Math::abs(det) < CMP_EPSILON * CMP_EPSILON) {
+					continue;
+				}
+
+				real_t inv_det = 1.0 / det;
+				Vector3 s = p_from - a;
+				real_t u = s.dot(p) * inv_det;
+
+				if (u < 0 || u > 1) {
+					continue;
+				}
+
+				Vector3 q = s.cross(e1);
+				real_t v = direction.dot(q) * inv_det;
+
+				if (v < 0 || u + v > 1) {
+					continue;
+				}
+
+				real_t t = e2.dot(q) * inv_det;
+
+				if (t >= 0 && t < best_distance) {
+					best_distance = t;
+					best_slot = i;
+				}
+			}
+
+			continue;
+		}
+
+		uint32_t near_child = node.first;
+		uint32_t far_child = node.first + 1;
+
+		real_t near_distance = _intersect_node(nodes[near_child], p_from, inv_direction, best_distance);
+		real_t far_distance = _intersect_node(nodes[far_child], p_from, inv_direction, best_distance);
+
+		if (far_distance < near_distance) {
+			SWAP(near_child, far_child);
+			SWAP(near_distance, far_distance);
+		}
+
+		if (far_distance != Math_INF) {
+			stack[stack_size++] = far_child;
+		}
+
+		if (near_distance != Math_INF) {
+			stack[stack_size++] = near_child;
+		}
+	}
+
+	if (best_slot == -1) {
+		return false;
+	}
+
+	r_hit.distance = best_distance;
+	r_hit.position = p_from + direction * best_distance;
+	_finalize_hit(r_hit, best_slot);
+
+	return true;
+}
+
+bool MDRBVH::intersect_segment(const Vector3 &p_from, const Vector3 &p_to, Hit &r_hit) const {
+	Vector3 direction = p_to - p_from;
+
+	return intersect_ray(p_from, direction, direction.length(), r_hit);
+}
+
+bool MDRBVH::get_closest_point(const Vector3 &p_point, Hit &r_hit) const {
+	if (_nodes.size() == 0) {
+		return false;
+	}
+
+	const Node *nodes = _nodes.ptr();
+	const Vector3 *vertices = _vertices.ptr();
+
+	real_t best_distance_squared = Math_INF;
+	Vector3 best_point;
+	int best_slot = -1;
+
+	uint32_t stack[MAX_DEPTH + 2];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		const Node &node = nodes[stack[--stack_size]];
+
+		//The bound might have shrunk since the node was pushed
+		if (_get_node_distance_squared(node, p_point) >= best_distance_squared) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				Vector3 point = _get_closest_point_on_triangle(p_point, vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+				real_t distance_squared = point.distance_squared_to(p_point);
+
+				if (distance_squared < best_distance_squared) {
+					best_distance_squared = distance_squared;
+					best_point = point;
+					best_slot = i;
+				}
+			}
+
+			continue;
+		}
+
+		uint32_t near_child = node.first;
+		uint32_t far_child = node.first + 1;
+
+		real_t near_distance = _get_node_distance_squared(nodes[near_child], p_point);
+		real_t far_distance = _get_node_distance_squared(nodes[far_child], p_point);
+
+		if (far_distance < near_distance) {
+			SWAP(near_child, far_child);
+			SWAP(near_distance, far_distance);
+		}
+
+		if (far_distance < best_distance_squared) {
+			stack[stack_size++] = far_child;
+		}
+
+		if (near_distance < best_distance_squared) {
+			stack[stack_size++] = near_child;
+		}
+	}
+
+	if (best_slot == -1) {
+		return false;
+	}
+
+	r_hit.distance = Math::sqrt(best_distance_squared);
+	r_hit.position = best_point;
+	_finalize_hit(r_hit, best_slot);
+
+	return true;
+}
+
+int MDRBVH::get_memory_usage() const {
+	return _nodes.size() * sizeof(Node) + _vertices.size() * sizeof(Vector3) + _triangle_ids.size() * sizeof(uint32_t);
+}
+
+real_t MDRBVH::_intersect_node(const Node &p_node, const Vector3 &p_from, const Vector3 &p_inv_direction, const real_t p_max_distance) {
+	real_t t_min = 0;
+	real_t t_max = p_max_distance;
+
+	for (int i = 0; i < 3; ++i) {
+		//The ray is parallel to this slab (0 * inf would be NaN), it either stays inside it or never enters it
+		if (Math::is_inf(p_inv_direction[i])) {
+			if (p_from[i] < p_node.min[i] || p_from[i] > p_node.max[i]) {
+				return Math_INF;
+			}
+
+			continue;
+		}
+
+		real_t t1 = (p_node.min[i] - p_from[i]) * p_inv_direction[i];
+		real_t t2 = (p_node.max[i] - p_from[i]) * p_inv_direction[i];
+
+		t_min = MAX(t_min, MIN(t1, t2));
+		t_max = MIN(t_max, MAX(t1, t2));
+	}
+
+	if (t_min > t_max) {
+		return Math_INF;
+	}
+
+	return t_min;
+}
+
+real_t MDRBVH::_get_node_distance_squared(const Node &p_node, const Vector3 &p_point) {
+	real_t distance_squared = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		real_t d = p_point[i] - CLAMP(p_point[i], p_node.min[i], p_node.max[i]);
+		distance_squared += d * d;
+	}
+
+	return distance_squared;
+}
+
+//From Real-Time Collision Detection, by Christer Ericson
+Vector3 MDRBVH::_get_closest_point_on_triangle(const Vector3 &p_point, const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c) {
+	Vector3 ab = p_b - p_a;
+	Vector3 ac = p_c - p_a;
+	Vector3 ap = p_point - p_a;
+
+	real_t d1 = ab.dot(ap);
+	real_t d2 = ac.dot(ap);
+
+	if (d1 <= 0 && d2 <= 0) {
+		return p_a;
+	}
+
+	Vector3 bp = p_point - p_b;
+	real_t d3 = ab.dot(bp);
+	real_t d4 = ac.dot(bp);
+
+	if (d3 >= 0 && d4 <= d3) {
+		return p_b;
+	}
+
+	real_t vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+		return p_a + ab * (d1 / (d1 - d3));
+	}
+
+	Vector3 cp = p_point - p_c;
+	real_t d5 = ab.dot(cp);
+	real_t d6 = ac.dot(cp);
+
+	if (d6 >= 0 && d5 <= d6) {
+		return p_c;
+	}
+
+	real_t vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+		return p_a + ac * (d2 / (d2 - d6));
+	}
+
+	real_t va = d3 * d6 - d5 * d4;
+
+	if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+		return p_b + (p_c - p_b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	real_t denom = 1.0 / (va + vb + vc);
+
+	return p_a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+void MDRBVH::_finalize_hit(Hit &r_hit, const int p_triangle_slot) const {
+	const Vector3 *t = _vertices.ptr() + p_triangle_slot * 3;
+
+	r_hit.normal = (t[2] - t[0]).cross(t[1] - t[0]).normalized();
+	r_hit.triangle = _triangle_ids[p_triangle_slot];
+}
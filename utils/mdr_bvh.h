@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_BVH_H
+#define MDR_BVH_H
+
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+//Bounding volume hierarchy over the triangles of an index buffer, for ray and closest point queries.
+//Built with binned SAH, the nodes are stored in a flat array, with the two children of a node next to each other.
+class MDRBVH {
+public:
+	static const int MAX_LEAF_TRIANGLES = 4;
+	static const int MAX_DEPTH = 48;
+	static const int SAH_BIN_COUNT = 12;
+
+	struct Hit {
+		Vector3 position;
+		Vector3 normal; //Front faces are clockwise
+		real_t distance;
+		int triangle;
+
+		Hit() {
+			distance = 0;
+			triangle = -1;
+		}
+	};
+
+	void build(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count);
+	void clear();
+	bool is_empty() const;
+
+	//p_direction doesn't need to be normalized, the returned distance is along the normalized direction.
+	//Back faces are hit too.
+	bool intersect_ray(const Vector3 &p_from, const Vector3 &p_direction, const real_t p_max_distance, Hit &r_hit) const;
+	bool intersect_segment(const Vector3 &p_from, const Vector3 &p_to, Hit &r_hit) const;
+	bool get_closest_point(const Vector3 &p_point, Hit &r_hit) const;
+
+	int get_memory_usage() const;
+
+protected:
+	struct Node {
+		Vector3 min;
+		//First triangle for leaves, left child for inner nodes
+		uint32_t first;
+		Vector3 max;
+		//0 for inner nodes
+		uint32_t count;
+
+		Node() {
+			first = 0;
+			count = 0;
+		}
+	};
+
+	struct Bounds {
+		Vector3 min;
+		Vector3 max;
+
+		_FORCE_INLINE_ void reset() {
+			min = Vector3(1e30, 1e30, 1e30);
+			max = Vector3(-1e30, -1e30, -1e30);
+		}
+
+		_FORCE_INLINE_ void expand(const Vector3 &p_point) {
+			for (int i = 0; i < 3; ++i) {
+				min[i] = MIN(min[i], p_point[i]);
+				max[i] = MAX(max[i], p_point[i]);
+			}
+		}
+
+		_FORCE_INLINE_ void merge(const Bounds &p_bounds) {
+			for (int i = 0; i < 3; ++i) {
+				min[i] = MIN(min[i], p_bounds.min[i]);
+				max[i] = MAX(max[i], p_bounds.max[i]);
+			}
+		}
+
+		_FORCE_INLINE_ real_t get_area() const {
+			Vector3 size = max - min;
+
+			if (size.x < 0 || size.y < 0 || size.z < 0) {
+				return 0;
+			}
+
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+	};
+
+	static real_t _intersect_node(const Node &p_node, const Vector3 &p_from, const Vector3 &p_inv_direction, const real_t p_max_distance);
+	static real_t _get_node_distance_squared(const Node &p_node, const Vector3 &p_point);
+	static Vector3 _get_closest_point_on_triangle(const Vector3 &p_point, const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c);
+
+	void _finalize_hit(Hit &r_hit, const int p_triangle_slot) const;
+
+	Vector<Node> _nodes;
+	//3 vertices per triangle, in leaf order
+	Vector<Vector3> _vertices;
+	//Original triangle index, in leaf order
+	Vector<uint32_t> _triangle_ids;
+};
+
+#endif
@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_cluster_builder.h"
+
+#include "core/error/error_macros.h"
+#include "core/math/math_funcs.h"
+
+Vector<MDRCluster> MDRClusterBuilder::build(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const int p_max_vertices, const int p_max_triangles) {
+	Vector<MDRCluster> clusters;
+
+	int triangle_count = p_index_count / 3;
+
+	if (triangle_count == 0 || p_vertex_count == 0) {
+		return clusters;
+	}
+
+	ERR_FAIL_COND_V(p_max_vertices < 3 || p_max_triangles < 1, clusters);
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		ERR_FAIL_COND_V_MSG(p_indices[i] >= static_cast<uint32_t>(p_vertex_count), clusters, "Index out of range!");
+	}
+
+	//Which cluster last used the vertex
+	Vector<int> vertex_markers;
+	vertex_markers.resize(p_vertex_count);
+	int *mw = vertex_markers.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		mw[i] = -1;
+	}
+
+	MDRCluster cluster;
+	int cluster_index = 0;
+	int cluster_vertex_count = 0;
+
+	for (int i = 0; i < triangle_count; ++i) {
+		const uint32_t *t = p_indices + i * 3;
+
+		int new_vertices = 0;
+
+		for (int j = 0; j < 3; ++j) {
+			if (mw[t[j]] != cluster_index) {
+				++new_vertices;
+			}
+		}
+
+		//Degenerate triangles could count a vertex twice, that's fine, it's only conservative
+		if (cluster.triangle_count > 0 && (cluster_vertex_count + new_vertices > p_max_vertices || static_cast<int>(cluster.triangle_count) >= p_max_triangles)) {
+			_compute_bounds(cluster, p_indices, p_vertices);
+			clusters.push_back(cluster);
+
+			cluster = MDRCluster();
+			cluster.triangle_offset = i;
+
+			++cluster_index;
+			cluster_vertex_count = 0;
+		}
+
+		for (int j = 0; j < 3; ++j) {
+			if (mw[t[j]] != cluster_index) {
+				mw[t[j]] = cluster_index;
+				++cluster_vertex_count;
+			}
+		}
+
+		++cluster.triangle_count;
+	}
+
+	_compute_bounds(cluster, p_indices, p_vertices);
+	clusters.push_back(cluster);
+
+	return clusters;
+}
+
+bool MDRClusterBuilder::is_visible(const MDRCluster &p_cluster, const Plane *p_planes, const int p_plane_count, const Vector3 &p_camera_position, const bool p_backface_test) {
+	for (int i = 0; i < p_plane_count; ++i) {
+		if (p_planes[i].distance_to(p_cluster.center) > p_cluster.radius) {
+			return false;
+		}
+	}
+
+	if (!p_backface_test) {
+		return true;
+	}
+
+	//Every triangle faces away, if the direction to the cluster is within the cone's complement, for every point of the sphere
+	Vector3 direction = p_cluster.center - p_camera_position;
+
+	if (direction.dot(p_cluster.cone_axis) >= p_cluster.cone_cutoff * direction.length() + p_cluster.radius) {
+		return false;
+	}
+
+	return true;
+}
+
+void MDRClusterBuilder::_compute_bounds(MDRCluster &r_cluster, const uint32_t *p_indices, const Vector3 *p_vertices) {
+	const uint32_t *indices = p_indices + r_cluster.triangle_offset * 3;
+	int index_count = r_cluster.triangle_count * 3;
+
+	Vector3 min = p_vertices[indices[0]];
+	Vector3 max = min;
+
+	for (int i = 1; i < index_count; ++i) {
+		const Vector3 &v = p_vertices[indices[i]];
+
+		for (int j = 0; j < 3; ++j) {
+			min[j] = MIN(min[j], v[j]);
+			max[j] = MAX(max[j], v[j]);
+		}
+	}
+
+	r_cluster.center = (min + max) * 0.5;
+	r_cluster.radius = 0;
+
+	for (int i = 0; i < index_count; ++i) {
+		r_cluster.radius = MAX(r_cluster.radius, r_cluster.center.distance_to(p_vertices[indices[i]]));
+	}
+
+	//Front faces are clockwise, so this points outwards
+	Vector3 axis;
+
+	for (int i = 0; i < index_count; i += 3) {
+		const Vector3 &a = p_vertices[indices[i]];
+		const Vector3 &b = p_vertices[indices[i + 1]];
+		const Vector3 &c = p_vertices[indices[i + 2]];
+
+		Vector3 n = (c - a).cross(b - a);
+		real_t length = n.length();
+
+		if (length > CMP_EPSILON) {
+			axis += n / length;
+		}
+	}
+
+	real_t axis_length = axis.length();
+
+	r_cluster.cone_axis = Vector3();
+	r_cluster.cone_cutoff = 1;
+
+	if (axis_length <= CMP_EPSILON) {
+		return;
+	}
+
+	axis /= axis_length;
+
+	real_t min_dot = 1;
+
+	for (int i = 0; i < index_count; i += 3) {
+		const Vector3 &a = p_vertices[indices[i]];
+		const Vector3 &b = p_vertices[indices[i + 1]];
+		const Vector3 &c = p_vertices[indices[i + 2]];
+
+		Vector3 n = (c - a).cross(b - a);
+		real_t length = n.length();
+
+		if (length > CMP_EPSILON) {
+			min_dot = MIN(min_dot, axis.dot(n / length));
+		}
+	}
+
+	r_cluster.cone_axis = axis;
+
+	//Normals spread over a half sphere or more, it's never completely backfacing
+	if (min_dot <= 0) {
+		return;
+	}
+
+	//sin of the cone's half angle
+	r_cluster.cone_cutoff = Math::sqrt(1 - min_dot * min_dot);
+}
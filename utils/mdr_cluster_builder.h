@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_CLUSTER_BUILDER_H
+#define MDR_CLUSTER_BUILDER_H
+
+#include "core/math/plane.h"
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+//A contiguous range of triangles in an index buffer, with culling data
+struct MDRCluster {
+	uint32_t triangle_offset;
+	uint32_t triangle_count;
+
+	Vector3 center;
+	real_t radius;
+
+	//Every triangle normal is within the cone. A cutoff of 1 means the cluster can't be backface culled.
+	Vector3 cone_axis;
+	real_t cone_cutoff;
+
+	MDRCluster() {
+		triangle_offset = 0;
+		triangle_count = 0;
+		radius = 0;
+		cone_cutoff = 1;
+	}
+};
+
+class MDRClusterBuilder {
+public:
+	static const int DEFAULT_MAX_VERTICES = 64;
+	static const int DEFAULT_MAX_TRIANGLES = 124;
+
+	//Splits the triangles in index order, so the index buffer doesn't need to change.
+	//Running the vertex cache optimization first results in tighter clusters.
+	static Vector<MDRCluster> build(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const int p_max_vertices = DEFAULT_MAX_VERTICES, const int p_max_triangles = DEFAULT_MAX_TRIANGLES);
+
+	//Frustum and backface test. Everything needs to be in the same space as the vertices.
+	//The backface test needs a perspective camera.
+	static bool is_visible(const MDRCluster &p_cluster, const Plane *p_planes, const int p_plane_count, const Vector3 &p_camera_position, const bool p_backface_test = true);
+
+protected:
+	static void _compute_bounds(MDRCluster &r_cluster, const uint32_t *p_indices, const Vector3 *p_vertices);
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_material_cache.h"
+
+#include "core/config/project_settings.h"
+#include "core/io/resource_loader.h"
+
+//Entries of freed materials are only pruned once the cache doubled in size since the last time
+#define MDR_MATERIAL_CACHE_MIN_PRUNE_SIZE 64
+
+HashMap<MDRMaterialCache::Key, ObjectID, MDRMaterialCache::KeyHasher> MDRMaterialCache::_materials;
+HashMap<ObjectID, ObjectID> MDRMaterialCache::_bases;
+int MDRMaterialCache::_prune_size = MDR_MATERIAL_CACHE_MIN_PRUNE_SIZE;
+Ref<Material> MDRMaterialCache::_base_material;
+bool MDRMaterialCache::_base_material_loaded = false;
+Mutex MDRMaterialCache::_mutex;
+
+Ref<Material> MDRMaterialCache::get_material(const Ref<Texture2D> &p_texture, const Ref<Material> &p_base) {
+	MutexLock lock(_mutex);
+
+	Key key;
+	key.texture = p_texture.is_valid() ? p_texture->get_instance_id() : ObjectID();
+	key.base = p_base.is_valid() ? p_base->get_instance_id() : ObjectID();
+
+	ObjectID *material_id = _materials.getptr(key);
+
+	if (material_id) {
+		Ref<Material> material = Object::cast_to<Material>(ObjectDB::get_instance(*material_id));
+
+		if (material.is_valid()) {
+			return material;
+		}
+	}
+
+	Ref<Material> material;
+
+	if (p_base.is_valid()) {
+		material = p_base->duplicate();
+	} else {
+		Ref<StandardMaterial3D> sm;
+		sm.instantiate();
+		material = sm;
+	}
+
+	ERR_FAIL_COND_V(!material.is_valid(), material);
+
+	Ref<BaseMaterial3D> bm = material;
+
+	if (bm.is_valid()) {
+		bm->set_texture(BaseMaterial3D::TEXTURE_ALBEDO, p_texture);
+	} else {
+		Ref<ShaderMaterial> shm = material;
+
+		//Same name as in shaders converted from StandardMaterial3Ds
+		if (shm.is_valid()) {
+			shm->set_shader_parameter("texture_albedo", p_texture);
+		}
+	}
+
+	_materials[key] = material->get_instance_id();
+	_bases[material->get_instance_id()] = key.base;
+
+	if (_materials.size() >= _prune_size) {
+		_prune();
+	}
+
+	return material;
+}
+
+bool MDRMaterialCache::get_cached_base(const Ref<Material> &p_material, Ref<Material> &r_base) {
+	if (!p_material.is_valid()) {
+		return false;
+	}
+
+	MutexLock lock(_mutex);
+
+	ObjectID *base_id = _bases.getptr(p_material->get_instance_id());
+
+	if (!base_id) {
+		return false;
+	}
+
+	if (base_id->is_null()) {
+		r_base = Ref<Material>();
+		return true;
+	}
+
+	r_base = Object::cast_to<Material>(ObjectDB::get_instance(*base_id));
+
+	//The base is gone, the material itself is the same apart from the texture
+	if (!r_base.is_valid()) {
+		r_base = p_material;
+	}
+
+	return true;
+}
+
+Ref<Material> MDRMaterialCache::get_base_material() {
+	MutexLock lock(_mutex);
+
+	if (!_base_material_loaded) {
+		_base_material_loaded = true;
+
+		String path = GLOBAL_GET("mesh_data_resource/prop_base_material");
+
+		if (!path.is_empty()) {
+			_base_material = ResourceLoader::load(path, "Material");
+
+			ERR_FAIL_COND_V_MSG(!_base_material.is_valid(), _base_material, "Couldn't load the prop base material from '" + path + "'.");
+		}
+	}
+
+	return _base_material;
+}
+void MDRMaterialCache::set_base_material(const Ref<Material> &p_material) {
+	MutexLock lock(_mutex);
+
+	_base_material = p_material;
+	_base_material_loaded = true;
+}
+
+void MDRMaterialCache::clear() {
+	MutexLock lock(_mutex);
+
+	_materials.clear();
+	_bases.clear();
+	_prune_size = MDR_MATERIAL_CACHE_MIN_PRUNE_SIZE;
+	_base_material.unref();
+	_base_material_loaded = false;
+}
+
+void MDRMaterialCache::_prune() {
+	Vector<Key> dead;
+
+	for (const KeyValue<Key, ObjectID> &E : _materials) {
+		const Key &k = E.key;
+
+		//A freed texture or base can't be asked for again, and its id won't be reused
+		if (!ObjectDB::get_instance(E.value) || (k.texture.is_valid() && !ObjectDB::get_instance(k.texture)) || (k.base.is_valid() && !ObjectDB::get_instance(k.base))) {
+			dead.push_back(k);
+		}
+	}
+
+	for (int i = 0; i < dead.size(); ++i) {
+		_bases.erase(_materials[dead[i]]);
+		_materials.erase(dead[i]);
+	}
+
+	_prune_size = MAX(MDR_MATERIAL_CACHE_MIN_PRUNE_SIZE, _materials.size() * 2);
+}
@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_MATERIAL_CACHE_H
+#define MDR_MATERIAL_CACHE_H
+
+#include "core/object/object_id.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#include "scene/resources/material.h"
+#include "scene/resources/texture.h"
+
+//Materials shared by the nodes that are spawned from props, one for every texture and base material pair.
+//Only the ids are stored, so a material is freed with its last user.
+class MDRMaterialCache {
+public:
+	//The base is duplicated for every texture. If it's not valid, a StandardMaterial3D is created.
+	static Ref<Material> get_material(const Ref<Texture2D> &p_texture, const Ref<Material> &p_base);
+
+	//Returns true, if p_material came from get_material(). r_base is set to what can be passed
+	//to get_material() to get the same material with a different texture.
+	static bool get_cached_base(const Ref<Material> &p_material, Ref<Material> &r_base);
+
+	//Set from code, or loaded from the mesh_data_resource/prop_base_material project setting
+	static Ref<Material> get_base_material();
+	static void set_base_material(const Ref<Material> &p_material);
+
+	static void clear();
+
+protected:
+	static void _prune();
+
+	struct Key {
+		ObjectID texture;
+		ObjectID base;
+
+		bool operator==(const Key &p_other) const {
+			return texture == p_other.texture && base == p_other.base;
+		}
+	};
+
+	struct KeyHasher {
+		static _FORCE_INLINE_ uint32_t hash(const Key &p_key) {
+			return hash_murmur3_one_64(static_cast<uint64_t>(p_key.texture), hash_murmur3_one_64(static_cast<uint64_t>(p_key.base)));
+		}
+	};
+
+	static HashMap<Key, ObjectID, KeyHasher> _materials;
+	//Material id -> base id
+	static HashMap<ObjectID, ObjectID> _bases;
+	static int _prune_size;
+	static Ref<Material> _base_material;
+	static bool _base_material_loaded;
+	static Mutex _mutex;
+};
+
+#endif
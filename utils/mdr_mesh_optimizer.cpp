@@ -0,0 +1,460 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_mesh_optimizer.h"
+
+#include "core/error/error_macros.h"
+#include "core/math/math_funcs.h"
+
+#define MDR_CACHE_DECAY_POWER 1.5
+#define MDR_LAST_TRIANGLE_SCORE 0.75
+#define MDR_VALENCE_BOOST_SCALE 2.0
+#define MDR_VALENCE_BOOST_POWER 0.5
+
+#define MDR_OVERDRAW_CACHE_SIZE 16
+
+void MDRMeshOptimizer::optimize_vertex_cache(uint32_t *r_indices, const int p_index_count, const int p_vertex_count) {
+	int triangle_count = p_index_count / 3;
+
+	if (triangle_count == 0 || p_vertex_count == 0) {
+		return;
+	}
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		ERR_FAIL_COND_MSG(r_indices[i] >= static_cast<uint32_t>(p_vertex_count), "Index out of range!");
+	}
+
+	//Triangles that use a vertex. The first remaining[v] entries are the ones not yet emitted.
+	Vector<int> triangle_offsets;
+	triangle_offsets.resize(p_vertex_count + 1);
+	int *tow = triangle_offsets.ptrw();
+
+	Vector<int> remaining;
+	remaining.resize(p_vertex_count);
+	int *rw = remaining.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		rw[i] = 0;
+	}
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		++rw[r_indices[i]];
+	}
+
+	tow[0] = 0;
+	for (int i = 0; i < p_vertex_count; ++i) {
+		tow[i + 1] = tow[i] + rw[i];
+		rw[i] = 0;
+	}
+
+	Vector<int> vertex_triangles;
+	vertex_triangles.resize(triangle_count * 3);
+	int *vtw = vertex_triangles.ptrw();
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		uint32_t v = r_indices[i];
+		vtw[tow[v] + rw[v]++] = i / 3;
+	}
+
+	Vector<int> cache_positions;
+	cache_positions.resize(p_vertex_count);
+	int *cpw = cache_positions.ptrw();
+
+	Vector<float> vertex_scores;
+	vertex_scores.resize(p_vertex_count);
+	float *vsw = vertex_scores.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		cpw[i] = -1;
+		vsw[i] = _vertex_score(-1, rw[i]);
+	}
+
+	Vector<float> triangle_scores;
+	triangle_scores.resize(triangle_count);
+	float *tsw = triangle_scores.ptrw();
+
+	Vector<uint8_t> emitted;
+	emitted.resize(triangle_count);
+	uint8_t *ew = emitted.ptrw();
+
+	int best_triangle = 0;
+	float best_score = -1;
+
+	for (int i = 0; i < triangle_count; ++i) {
+		const uint32_t *t = r_indices + i * 3;
+
+		tsw[i] = vsw[t[0]] + vsw[t[1]] + vsw[t[2]];
+		ew[i] = 0;
+
+		if (tsw[i] > best_score) {
+			best_score = tsw[i];
+			best_triangle = i;
+		}
+	}
+
+	Vector<uint32_t> result;
+	result.resize(triangle_count * 3);
+	uint32_t *resw = result.ptrw();
+
+	//The 3 extra slots hold the vertices that get pushed out by the current triangle
+	int cache[VERTEX_CACHE_SIZE + 3];
+	int new_cache[VERTEX_CACHE_SIZE + 3];
+	int cache_count = 0;
+
+	int cursor = 0;
+
+	for (int emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+		if (best_triangle < 0) {
+			//Nothing in the cache is connected to a remaining triangle, continue with the next one in the original order
+			while (ew[cursor]) {
+				++cursor;
+			}
+
+			best_triangle = cursor;
+		}
+
+		const uint32_t *t = r_indices + best_triangle * 3;
+
+		resw[emitted_count * 3] = t[0];
+		resw[emitted_count * 3 + 1] = t[1];
+		resw[emitted_count * 3 + 2] = t[2];
+
+		ew[best_triangle] = 1;
+
+		int new_cache_count = 0;
+
+		for (int i = 0; i < 3; ++i) {
+			int v = t[i];
+
+			//Move the triangle out of the vertex's remaining range
+			int *tris = vtw + tow[v];
+			int last = rw[v] - 1;
+
+			for (int j = 0; j <= last; ++j) {
+				if (tris[j] == best_triangle) {
+					SWAP(tris[j], tris[last]);
+					break;
+				}
+			}
+
+			--rw[v];
+
+			bool duplicate = false;
+			for (int j = 0; j < new_cache_count; ++j) {
+				if (new_cache[j] == v) {
+					duplicate = true;
+					break;
+				}
+			}
+
+			if (!duplicate) {
+				new_cache[new_cache_count++] = v;
+			}
+		}
+
+		for (int i = 0; i < cache_count; ++i) {
+			int v = cache[i];
+
+			if (v != static_cast<int>(t[0]) && v != static_cast<int>(t[1]) && v != static_cast<int>(t[2])) {
+				new_cache[new_cache_count++] = v;
+			}
+		}
+
+		best_triangle = -1;
+		best_score = -1;
+
+		//Rescore everything that is, or just was in the cache
+		for (int i = 0; i < new_cache_count; ++i) {
+			int v = new_cache[i];
+			int position = i < VERTEX_CACHE_SIZE ? i : -1;
+
+			cpw[v] = position;
+
+			float score = _vertex_score(position, rw[v]);
+			float diff = score - vsw[v];
+			vsw[v] = score;
+
+			const int *tris = vtw + tow[v];
+
+			for (int j = 0; j < rw[v]; ++j) {
+				int tri = tris[j];
+
+				tsw[tri] += diff;
+
+				if (position >= 0 && tsw[tri] > best_score) {
+					best_score = tsw[tri];
+					best_triangle = tri;
+				}
+			}
+		}
+
+		cache_count = MIN(new_cache_count, static_cast<int>(VERTEX_CACHE_SIZE));
+
+		for (int i = 0; i < cache_count; ++i) {
+			cache[i] = new_cache[i];
+		}
+	}
+
+	memcpy(r_indices, result.ptr(), sizeof(uint32_t) * triangle_count * 3);
+}
+
+void MDRMeshOptimizer::optimize_overdraw(uint32_t *r_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const float p_threshold) {
+	int triangle_count = p_index_count / 3;
+
+	if (triangle_count == 0 || p_vertex_count == 0) {
+		return;
+	}
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		ERR_FAIL_COND_MSG(r_indices[i] >= static_cast<uint32_t>(p_vertex_count), "Index out of range!");
+	}
+
+	Vector<int> timestamps;
+	timestamps.resize(p_vertex_count);
+	int *tw = timestamps.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		tw[i] = -MDR_OVERDRAW_CACHE_SIZE - 1;
+	}
+
+	int timestamp = 0;
+
+	//Hard boundaries: the cache is completely cold there, so the triangles can be moved around freely
+	Vector<int> hard_clusters;
+
+	for (int i = 0; i < triangle_count; ++i) {
+		int misses = _update_cache(r_indices + i * 3, tw, timestamp, MDR_OVERDRAW_CACHE_SIZE);
+
+		if (i == 0 || misses == 3) {
+			hard_clusters.push_back(i);
+		}
+	}
+
+	//Soft boundaries: split the hard clusters further, as long as the pieces stay within the threshold
+	Vector<int> clusters;
+
+	for (int c = 0; c < hard_clusters.size(); ++c) {
+		int start = hard_clusters[c];
+		int end = c + 1 < hard_clusters.size() ? hard_clusters[c + 1] : triangle_count;
+
+		timestamp += MDR_OVERDRAW_CACHE_SIZE + 1;
+
+		int cluster_misses = 0;
+
+		for (int i = start; i < end; ++i) {
+			cluster_misses += _update_cache(r_indices + i * 3, tw, timestamp, MDR_OVERDRAW_CACHE_SIZE);
+		}
+
+		float cluster_threshold = p_threshold * (static_cast<float>(cluster_misses) / (end - start));
+
+		clusters.push_back(start);
+
+		timestamp += MDR_OVERDRAW_CACHE_SIZE + 1;
+
+		int running_misses = 0;
+		int running_start = start;
+
+		for (int i = start; i < end; ++i) {
+			running_misses += _update_cache(r_indices + i * 3, tw, timestamp, MDR_OVERDRAW_CACHE_SIZE);
+
+			if (i + 1 < end && static_cast<float>(running_misses) / (i + 1 - running_start) <= cluster_threshold) {
+				clusters.push_back(i + 1);
+
+				running_start = i + 1;
+				running_misses = 0;
+				timestamp += MDR_OVERDRAW_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	Vector3 mesh_centroid;
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		mesh_centroid += p_vertices[r_indices[i]];
+	}
+
+	mesh_centroid /= triangle_count * 3;
+
+	//Clusters that face away from the center are likely to occlude the rest of the mesh
+	Vector<ClusterSortItem> sort_items;
+	sort_items.resize(clusters.size());
+	ClusterSortItem *siw = sort_items.ptrw();
+
+	for (int c = 0; c < clusters.size(); ++c) {
+		int start = clusters[c];
+		int end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+		Vector3 centroid;
+		Vector3 normal;
+		real_t area = 0;
+
+		for (int i = start; i < end; ++i) {
+			const uint32_t *t = r_indices + i * 3;
+
+			const Vector3 &v0 = p_vertices[t[0]];
+			const Vector3 &v1 = p_vertices[t[1]];
+			const Vector3 &v2 = p_vertices[t[2]];
+
+			//Front faces are clockwise. Length is twice the area of the triangle, so it doubles as a weight
+			Vector3 n = (v2 - v0).cross(v1 - v0);
+			real_t triangle_area = n.length();
+
+			centroid += (v0 + v1 + v2) * (triangle_area / 3.0);
+			normal += n;
+			area += triangle_area;
+		}
+
+		if (area > CMP_EPSILON) {
+			centroid /= area;
+		} else {
+			centroid = p_vertices[r_indices[start * 3]];
+		}
+
+		real_t normal_length = normal.length();
+
+		if (normal_length > CMP_EPSILON) {
+			normal /= normal_length;
+		}
+
+		siw[c].cluster = c;
+		siw[c].key = (centroid - mesh_centroid).dot(normal);
+	}
+
+	sort_items.sort();
+
+	Vector<uint32_t> result;
+	result.resize(triangle_count * 3);
+	uint32_t *rw = result.ptrw();
+	int offset = 0;
+
+	for (int i = 0; i < sort_items.size(); ++i) {
+		int c = sort_items[i].cluster;
+		int start = clusters[c];
+		int end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+
+		int count = (end - start) * 3;
+
+		memcpy(rw + offset, r_indices + start * 3, sizeof(uint32_t) * count);
+		offset += count;
+	}
+
+	memcpy(r_indices, result.ptr(), sizeof(uint32_t) * triangle_count * 3);
+}
+
+Vector<uint32_t> MDRMeshOptimizer::get_vertex_fetch_remap(const uint32_t *p_indices, const int p_index_count, const int p_vertex_count) {
+	Vector<uint32_t> remap;
+	remap.resize(p_vertex_count);
+	uint32_t *w = remap.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		w[i] = UINT32_MAX;
+	}
+
+	uint32_t next = 0;
+
+	for (int i = 0; i < p_index_count; ++i) {
+		uint32_t v = p_indices[i];
+
+		ERR_FAIL_COND_V_MSG(v >= static_cast<uint32_t>(p_vertex_count), Vector<uint32_t>(), "Index out of range!");
+
+		if (w[v] == UINT32_MAX) {
+			w[v] = next++;
+		}
+	}
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		if (w[i] == UINT32_MAX) {
+			w[i] = next++;
+		}
+	}
+
+	return remap;
+}
+
+float MDRMeshOptimizer::calculate_acmr(const uint32_t *p_indices, const int p_index_count, const int p_vertex_count, const int p_cache_size) {
+	int triangle_count = p_index_count / 3;
+
+	if (triangle_count == 0) {
+		return 0;
+	}
+
+	//A vertex is in the fifo cache, if it was added less than p_cache_size misses ago
+	Vector<int> cache_timestamps;
+	cache_timestamps.resize(p_vertex_count);
+	int *cw = cache_timestamps.ptrw();
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		cw[i] = -p_cache_size - 1;
+	}
+
+	for (int i = 0; i < triangle_count * 3; ++i) {
+		ERR_FAIL_COND_V_MSG(p_indices[i] >= static_cast<uint32_t>(p_vertex_count), 0, "Index out of range!");
+	}
+
+	int misses = 0;
+
+	for (int i = 0; i < triangle_count; ++i) {
+		_update_cache(p_indices + i * 3, cw, misses, p_cache_size);
+	}
+
+	return static_cast<float>(misses) / triangle_count;
+}
+
+int MDRMeshOptimizer::_update_cache(const uint32_t *p_triangle, int *r_timestamps, int &r_timestamp, const int p_cache_size) {
+	int misses = 0;
+
+	for (int i = 0; i < 3; ++i) {
+		uint32_t v = p_triangle[i];
+
+		if (r_timestamp - r_timestamps[v] > p_cache_size) {
+			r_timestamps[v] = r_timestamp;
+			++r_timestamp;
+			++misses;
+		}
+	}
+
+	return misses;
+}
+
+float MDRMeshOptimizer::_vertex_score(const int p_cache_position, const int p_remaining_triangles) {
+	if (p_remaining_triangles == 0) {
+		//Not needed anymore
+		return -1;
+	}
+
+	float score = 0;
+
+	if (p_cache_position >= 0) {
+		if (p_cache_position < 3) {
+			//Used by the last triangle, so it's fixed, otherwise strips would be preferred too much
+			score = MDR_LAST_TRIANGLE_SCORE;
+		} else {
+			float scaler = 1.0 / (VERTEX_CACHE_SIZE - 3);
+			score = Math::pow(1.0 - (p_cache_position - 3) * scaler, MDR_CACHE_DECAY_POWER);
+		}
+	}
+
+	//Vertices with only a few remaining triangles get a boost, so they get finished and don't stay around
+	score += MDR_VALENCE_BOOST_SCALE * Math::pow(static_cast<float>(p_remaining_triangles), static_cast<float>(-MDR_VALENCE_BOOST_POWER));
+
+	return score;
+}
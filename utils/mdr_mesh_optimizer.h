@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_MESH_OPTIMIZER_H
+#define MDR_MESH_OPTIMIZER_H
+
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+//Triangle and vertex reordering passes. They work on widened (32 bit) index buffers.
+class MDRMeshOptimizer {
+public:
+	//The cache size the scoring of the vertex cache pass is tuned for
+	static const int VERTEX_CACHE_SIZE = 32;
+
+	//Reorders the triangles (Forsyth's linear speed vertex cache optimization)
+	static void optimize_vertex_cache(uint32_t *r_indices, const int p_index_count, const int p_vertex_count);
+
+	//Splits the triangles into clusters, and sorts them so the ones facing outwards get drawn first.
+	//Clusters are only split while their ACMR stays below p_threshold times the original one.
+	static void optimize_overdraw(uint32_t *r_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const float p_threshold = 1.05);
+
+	//Returns old vertex index -> new vertex index, in the order the indices first use them.
+	//Vertices that are not referenced get moved to the end.
+	static Vector<uint32_t> get_vertex_fetch_remap(const uint32_t *p_indices, const int p_index_count, const int p_vertex_count);
+
+	//Average cache miss ratio (transformed vertices / triangles) with a fifo cache
+	static float calculate_acmr(const uint32_t *p_indices, const int p_index_count, const int p_vertex_count, const int p_cache_size = 16);
+
+protected:
+	struct ClusterSortItem {
+		int cluster;
+		float key;
+
+		bool operator<(const ClusterSortItem &p_other) const {
+			if (key != p_other.key) {
+				return key > p_other.key;
+			}
+
+			return cluster < p_other.cluster;
+		}
+	};
+
+	static float _vertex_score(const int p_cache_position, const int p_remaining_triangles);
+
+	//Fifo cache simulation, returns the number of misses for the triangle
+	static int _update_cache(const uint32_t *p_triangle, int *r_timestamps, int &r_timestamp, const int p_cache_size);
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_mesh_uploader.h"
+
+#include "core/config/project_settings.h"
+#include "scene/main/scene_tree.h"
+
+Vector<MDRMeshUploader::Job *> MDRMeshUploader::_jobs;
+Mutex MDRMeshUploader::_mutex;
+bool MDRMeshUploader::_connected = false;
+
+bool MDRMeshUploader::queue(const Ref<MeshDataResource> &p_mesh, const Array &p_arrays, const Dictionary &p_lods, const uint64_t p_version) {
+	ERR_FAIL_COND_V(!p_mesh.is_valid(), false);
+
+	if (!_connect()) {
+		return false;
+	}
+
+	Job *job = memnew(Job);
+	job->mesh = p_mesh;
+	job->arrays = p_arrays;
+	job->lods = p_lods;
+	job->version = p_version;
+	job->task = WorkerThreadPool::get_singleton()->add_native_task(&MDRMeshUploader::_prepare, job, false, "MDRMeshUploader");
+
+	MutexLock lock(_mutex);
+	_jobs.push_back(job);
+
+	return true;
+}
+
+void MDRMeshUploader::flush() {
+	int64_t budget = static_cast<int64_t>(GLOBAL_GET("mesh_data_resource/upload_budget_kb_per_frame")) * 1024;
+	int64_t uploaded = 0;
+
+	Job *job = _pop(false);
+
+	while (job) {
+		uploaded += _commit(job);
+
+		//0 means unlimited
+		if (budget > 0 && uploaded >= budget) {
+			return;
+		}
+
+		job = _pop(false);
+	}
+}
+
+void MDRMeshUploader::flush_all() {
+	Job *job = _pop(true);
+
+	while (job) {
+		_commit(job);
+
+		job = _pop(true);
+	}
+}
+
+void MDRMeshUploader::clear() {
+	Job *job = _pop(true);
+
+	while (job) {
+		memdelete(job);
+
+		job = _pop(true);
+	}
+}
+
+int MDRMeshUploader::get_pending_count() {
+	MutexLock lock(_mutex);
+
+	return _jobs.size();
+}
+
+bool MDRMeshUploader::_connect() {
+	if (_connected) {
+		return true;
+	}
+
+	SceneTree *tree = SceneTree::get_singleton();
+
+	if (!tree) {
+		return false;
+	}
+
+	tree->connect("process_frame", callable_mp_static(&MDRMeshUploader::flush));
+	_connected = true;
+
+	return true;
+}
+
+MDRMeshUploader::Job *MDRMeshUploader::_pop(const bool p_wait) {
+	Job *job = nullptr;
+
+	{
+		MutexLock lock(_mutex);
+
+		if (_jobs.size() == 0) {
+			return nullptr;
+		}
+
+		job = _jobs[0];
+
+		if (!p_wait && !WorkerThreadPool::get_singleton()->is_task_completed(job->task)) {
+			return nullptr;
+		}
+
+		_jobs.remove_at(0);
+	}
+
+	//The mesh's mutex can be locked while queueing, so the task is waited on outside of ours
+	WorkerThreadPool::get_singleton()->wait_for_task_completion(job->task);
+
+	return job;
+}
+
+int MDRMeshUploader::_commit(Job *p_job) {
+	int size = 0;
+
+	if (p_job->error == OK && p_job->mesh->_commit_mesh_surface(p_job->version, p_job->surface)) {
+		const RS::SurfaceData &s = p_job->surface;
+
+		size = s.vertex_data.size() + s.attribute_data.size() + s.skin_data.size() + s.index_data.size();
+
+		for (int i = 0; i < s.lods.size(); ++i) {
+			size += s.lods[i].index_data.size();
+		}
+	}
+
+	memdelete(p_job);
+
+	return size;
+}
+
+void MDRMeshUploader::_prepare(void *p_userdata) {
+	Job *job = static_cast<Job *>(p_userdata);
+
+	//Attribute packing, compression and the aabbs
+	job->error = RS::get_singleton()->mesh_create_surface_data_from_arrays(&job->surface, RS::PRIMITIVE_TRIANGLES, job->arrays, Array(), job->lods);
+}
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_MESH_UPLOADER_H
+#define MDR_MESH_UPLOADER_H
+
+#include "core/object/worker_thread_pool.h"
+#include "core/os/mutex.h"
+#include "core/templates/vector.h"
+#include "servers/rendering_server.h"
+
+#include "../mesh_data_resource.h"
+
+//Converts mesh arrays into RenderingServer surface data on the WorkerThreadPool, and commits the results
+//on the main thread, at most mesh_data_resource/upload_budget_kb_per_frame worth every frame.
+class MDRMeshUploader {
+public:
+	//Returns false if there is no SceneTree to commit the surfaces, the caller needs to upload directly then
+	static bool queue(const Ref<MeshDataResource> &p_mesh, const Array &p_arrays, const Dictionary &p_lods, const uint64_t p_version);
+
+	//Commits the prepared surfaces in order, until the budget runs out. At least one is committed.
+	static void flush();
+	//Waits for every surface, and commits them regardless of the budget
+	static void flush_all();
+	//Drops everything without committing
+	static void clear();
+
+	static int get_pending_count();
+
+protected:
+	struct Job {
+		Ref<MeshDataResource> mesh;
+		Array arrays;
+		Dictionary lods;
+		uint64_t version;
+
+		RS::SurfaceData surface;
+		Error error;
+		WorkerThreadPool::TaskID task;
+
+		Job() {
+			version = 0;
+			error = OK;
+			task = 0;
+		}
+	};
+
+	static bool _connect();
+	static Job *_pop(const bool p_wait);
+	static int _commit(Job *p_job);
+	static void _prepare(void *p_userdata);
+
+	static Vector<Job *> _jobs;
+	static Mutex _mutex;
+	static bool _connected;
+};
+
+#endif
@@ -0,0 +1,357 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_quantization.h"
+
+#include "core/math/math_funcs.h"
+
+Vector<uint32_t> MDRQuantization::encode_normals_octahedral(const Vector<Vector3> &p_normals) {
+	Vector<uint32_t> encoded;
+	encoded.resize(p_normals.size());
+
+	const Vector3 *r = p_normals.ptr();
+	uint32_t *w = encoded.ptrw();
+
+	for (int i = 0; i < p_normals.size(); ++i) {
+		Vector2 e = _octahedral_encode(r[i]);
+
+		int16_t x = static_cast<int16_t>(Math::round(CLAMP(e.x, -1.0, 1.0) * 32767.0));
+		int16_t y = static_cast<int16_t>(Math::round(CLAMP(e.y, -1.0, 1.0) * 32767.0));
+
+		w[i] = static_cast<uint16_t>(x) | (static_cast<uint32_t>(static_cast<uint16_t>(y)) << 16);
+	}
+
+	return encoded;
+}
+
+Vector<Vector3> MDRQuantization::decode_normals_octahedral(const Vector<uint32_t> &p_encoded) {
+	Vector<Vector3> normals;
+	normals.resize(p_encoded.size());
+
+	const uint32_t *r = p_encoded.ptr();
+	Vector3 *w = normals.ptrw();
+
+	for (int i = 0; i < p_encoded.size(); ++i) {
+		int16_t x = static_cast<int16_t>(r[i] & 0xFFFF);
+		int16_t y = static_cast<int16_t>(r[i] >> 16);
+
+		w[i] = _octahedral_decode(Vector2(MAX(x / 32767.0, -1.0), MAX(y / 32767.0, -1.0)));
+	}
+
+	return normals;
+}
+
+Vector<uint32_t> MDRQuantization::encode_tangents_octahedral(const Vector<float> &p_tangents) {
+	int count = p_tangents.size() / 4;
+
+	Vector<uint32_t> encoded;
+	encoded.resize(count);
+
+	const float *r = p_tangents.ptr();
+	uint32_t *w = encoded.ptrw();
+
+	for (int i = 0; i < count; ++i) {
+		const float *t = r + i * 4;
+
+		Vector2 e = _octahedral_encode(Vector3(t[0], t[1], t[2]));
+
+		uint32_t x = static_cast<uint32_t>(Math::round((CLAMP(e.x, -1.0, 1.0) * 0.5 + 0.5) * 32767.0));
+		uint32_t y = static_cast<uint32_t>(Math::round((CLAMP(e.y, -1.0, 1.0) * 0.5 + 0.5) * 32767.0));
+		uint32_t sign = t[3] < 0 ? 1 : 0;
+
+		w[i] = x | (y << 16) | (sign << 31);
+	}
+
+	return encoded;
+}
+
+Vector<float> MDRQuantization::decode_tangents_octahedral(const Vector<uint32_t> &p_encoded) {
+	Vector<float> tangents;
+	tangents.resize(p_encoded.size() * 4);
+
+	const uint32_t *r = p_encoded.ptr();
+	float *w = tangents.ptrw();
+
+	for (int i = 0; i < p_encoded.size(); ++i) {
+		float x = (r[i] & 0x7FFF) / 32767.0 * 2.0 - 1.0;
+		float y = ((r[i] >> 16) & 0x7FFF) / 32767.0 * 2.0 - 1.0;
+
+		Vector3 t = _octahedral_decode(Vector2(x, y));
+
+		float *tw = w + i * 4;
+		tw[0] = t.x;
+		tw[1] = t.y;
+		tw[2] = t.z;
+		tw[3] = (r[i] >> 31) ? -1 : 1;
+	}
+
+	return tangents;
+}
+
+Vector<uint16_t> MDRQuantization::encode_half2(const Vector<Vector2> &p_values) {
+	Vector<uint16_t> encoded;
+	encoded.resize(p_values.size() * 2);
+
+	const Vector2 *r = p_values.ptr();
+	uint16_t *w = encoded.ptrw();
+
+	for (int i = 0; i < p_values.size(); ++i) {
+		w[i * 2] = Math::make_half_float(r[i].x);
+		w[i * 2 + 1] = Math::make_half_float(r[i].y);
+	}
+
+	return encoded;
+}
+
+Vector<Vector2> MDRQuantization::decode_half2(const Vector<uint16_t> &p_encoded) {
+	int count = p_encoded.size() / 2;
+
+	Vector<Vector2> values;
+	values.resize(count);
+
+	const uint16_t *r = p_encoded.ptr();
+	Vector2 *w = values.ptrw();
+
+	for (int i = 0; i < count; ++i) {
+		w[i] = Vector2(Math::half_to_float(r[i * 2]), Math::half_to_float(r[i * 2 + 1]));
+	}
+
+	return values;
+}
+
+Vector<uint16_t> MDRQuantization::encode_unorm16_2(const Vector<Vector2> &p_values, Rect2 &r_range) {
+	Vector<uint16_t> encoded;
+
+	if (p_values.size() == 0) {
+		r_range = Rect2();
+		return encoded;
+	}
+
+	const Vector2 *r = p_values.ptr();
+
+	Vector2 min = r[0];
+	Vector2 max = r[0];
+
+	for (int i = 1; i < p_values.size(); ++i) {
+		min.x = MIN(min.x, r[i].x);
+		min.y = MIN(min.y, r[i].y);
+		max.x = MAX(max.x, r[i].x);
+		max.y = MAX(max.y, r[i].y);
+	}
+
+	r_range = Rect2(min, max - min);
+
+	Vector2 inv_size = Vector2(r_range.size.x > CMP_EPSILON ? 1.0 / r_range.size.x : 0, r_range.size.y > CMP_EPSILON ? 1.0 / r_range.size.y : 0);
+
+	encoded.resize(p_values.size() * 2);
+	uint16_t *w = encoded.ptrw();
+
+	for (int i = 0; i < p_values.size(); ++i) {
+		w[i * 2] = static_cast<uint16_t>(Math::round(CLAMP((r[i].x - min.x) * inv_size.x, 0.0, 1.0) * 65535.0));
+		w[i * 2 + 1] = static_cast<uint16_t>(Math::round(CLAMP((r[i].y - min.y) * inv_size.y, 0.0, 1.0) * 65535.0));
+	}
+
+	return encoded;
+}
+
+Vector<Vector2> MDRQuantization::decode_unorm16_2(const Vector<uint16_t> &p_encoded, const Rect2 &p_range) {
+	int count = p_encoded.size() / 2;
+
+	Vector<Vector2> values;
+	values.resize(count);
+
+	const uint16_t *r = p_encoded.ptr();
+	Vector2 *w = values.ptrw();
+
+	for (int i = 0; i < count; ++i) {
+		w[i] = p_range.position + Vector2(r[i * 2] / 65535.0, r[i * 2 + 1] / 65535.0) * p_range.size;
+	}
+
+	return values;
+}
+
+bool MDRQuantization::encode_unorm16_2_in_range(const Vector<Vector2> &p_values, const Rect2 &p_range, Vector<uint16_t> &r_encoded) {
+	const Vector2 *r = p_values.ptr();
+
+	Vector2 min = p_range.position - Vector2(CMP_EPSILON, CMP_EPSILON);
+	Vector2 max = p_range.position + p_range.size + Vector2(CMP_EPSILON, CMP_EPSILON);
+
+	for (int i = 0; i < p_values.size(); ++i) {
+		if (r[i].x < min.x || r[i].y < min.y || r[i].x > max.x || r[i].y > max.y) {
+			return false;
+		}
+	}
+
+	Vector2 inv_size = Vector2(p_range.size.x > CMP_EPSILON ? 1.0 / p_range.size.x : 0, p_range.size.y > CMP_EPSILON ? 1.0 / p_range.size.y : 0);
+
+	r_encoded.resize(p_values.size() * 2);
+	uint16_t *w = r_encoded.ptrw();
+
+	for (int i = 0; i < p_values.size(); ++i) {
+		w[i * 2] = static_cast<uint16_t>(Math::round(CLAMP((r[i].x - p_range.position.x) * inv_size.x, 0.0, 1.0) * 65535.0));
+		w[i * 2 + 1] = static_cast<uint16_t>(Math::round(CLAMP((r[i].y - p_range.position.y) * inv_size.y, 0.0, 1.0) * 65535.0));
+	}
+
+	return true;
+}
+
+Vector<uint8_t> MDRQuantization::encode_weights_unorm8(const Vector<float> &p_weights) {
+	Vector<uint8_t> encoded;
+	encoded.resize(p_weights.size());
+
+	const float *r = p_weights.ptr();
+	uint8_t *w = encoded.ptrw();
+
+	for (int i = 0; i < p_weights.size(); ++i) {
+		w[i] = static_cast<uint8_t>(Math::round(CLAMP(r[i], 0.0f, 1.0f) * 255.0f));
+	}
+
+	return encoded;
+}
+
+Vector<float> MDRQuantization::decode_weights_unorm8(const Vector<uint8_t> &p_encoded) {
+	Vector<float> weights;
+	weights.resize(p_encoded.size());
+
+	const uint8_t *r = p_encoded.ptr();
+	float *w = weights.ptrw();
+
+	for (int i = 0; i + 3 < p_encoded.size(); i += 4) {
+		int sum = r[i] + r[i + 1] + r[i + 2] + r[i + 3];
+		//Rounding can make the weights not sum up to 1 anymore
+		float inv_sum = sum > 0 ? 1.0f / sum : 0.0f;
+
+		for (int j = 0; j < 4; ++j) {
+			w[i + j] = r[i + j] * inv_sum;
+		}
+	}
+
+	return weights;
+}
+
+Vector<uint8_t> MDRQuantization::encode_colors_unorm8(const Vector<Color> &p_colors) {
+	Vector<uint8_t> encoded;
+	encoded.resize(p_colors.size() * 4);
+
+	const Color *r = p_colors.ptr();
+	uint8_t *w = encoded.ptrw();
+
+	for (int i = 0; i < p_colors.size(); ++i) {
+		for (int j = 0; j < 4; ++j) {
+			w[i * 4 + j] = static_cast<uint8_t>(Math::round(CLAMP(r[i].components[j], 0.0f, 1.0f) * 255.0f));
+		}
+	}
+
+	return encoded;
+}
+
+Vector<Color> MDRQuantization::decode_colors_unorm8(const Vector<uint8_t> &p_encoded) {
+	int count = p_encoded.size() / 4;
+
+	Vector<Color> colors;
+	colors.resize(count);
+
+	const uint8_t *r = p_encoded.ptr();
+	Color *w = colors.ptrw();
+
+	for (int i = 0; i < count; ++i) {
+		const uint8_t *c = r + i * 4;
+
+		w[i] = Color(c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, c[3] / 255.0f);
+	}
+
+	return colors;
+}
+
+bool MDRQuantization::encode_bones_uint8(const Vector<int> &p_bones, Vector<uint8_t> &r_encoded) {
+	const int *r = p_bones.ptr();
+
+	for (int i = 0; i < p_bones.size(); ++i) {
+		if (r[i] < 0 || r[i] > 255) {
+			return false;
+		}
+	}
+
+	r_encoded.resize(p_bones.size());
+	uint8_t *w = r_encoded.ptrw();
+
+	for (int i = 0; i < p_bones.size(); ++i) {
+		w[i] = r[i];
+	}
+
+	return true;
+}
+
+Vector<int> MDRQuantization::decode_bones_uint8(const Vector<uint8_t> &p_encoded) {
+	Vector<int> bones;
+	bones.resize(p_encoded.size());
+
+	const uint8_t *r = p_encoded.ptr();
+	int *w = bones.ptrw();
+
+	for (int i = 0; i < p_encoded.size(); ++i) {
+		w[i] = r[i];
+	}
+
+	return bones;
+}
+
+Vector2 MDRQuantization::_octahedral_encode(Vector3 p_normal) {
+	real_t l1 = Math::abs(p_normal.x) + Math::abs(p_normal.y) + Math::abs(p_normal.z);
+
+	if (l1 < CMP_EPSILON) {
+		return Vector2(0, 0);
+	}
+
+	p_normal /= l1;
+
+	Vector2 e = Vector2(p_normal.x, p_normal.y);
+
+	if (p_normal.z < 0) {
+		e.x = (1.0 - Math::abs(p_normal.y)) * SIGN(p_normal.x);
+		e.y = (1.0 - Math::abs(p_normal.x)) * SIGN(p_normal.y);
+
+		if (p_normal.x == 0) {
+			e.x = 1.0 - Math::abs(p_normal.y);
+		}
+
+		if (p_normal.y == 0) {
+			e.y = 1.0 - Math::abs(p_normal.x);
+		}
+	}
+
+	return e;
+}
+
+Vector3 MDRQuantization::_octahedral_decode(const Vector2 &p_encoded) {
+	Vector3 n = Vector3(p_encoded.x, p_encoded.y, 1.0 - Math::abs(p_encoded.x) - Math::abs(p_encoded.y));
+
+	if (n.z < 0) {
+		real_t x = (1.0 - Math::abs(p_encoded.y)) * (p_encoded.x >= 0 ? 1.0 : -1.0);
+		real_t y = (1.0 - Math::abs(p_encoded.x)) * (p_encoded.y >= 0 ? 1.0 : -1.0);
+
+		n.x = x;
+		n.y = y;
+	}
+
+	return n.normalized();
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_QUANTIZATION_H
+#define MDR_QUANTIZATION_H
+
+#include "core/math/color.h"
+#include "core/math/rect2.h"
+#include "core/math/vector2.h"
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+//Encoders / decoders for the compact vertex attribute formats MeshDataResource can store.
+class MDRQuantization {
+public:
+	//Octahedral, 2x snorm16
+	static Vector<uint32_t> encode_normals_octahedral(const Vector<Vector3> &p_normals);
+	static Vector<Vector3> decode_normals_octahedral(const Vector<uint32_t> &p_encoded);
+
+	//Octahedral, 2x unorm15, the binormal sign is stored in the highest bit
+	static Vector<uint32_t> encode_tangents_octahedral(const Vector<float> &p_tangents);
+	static Vector<float> decode_tangents_octahedral(const Vector<uint32_t> &p_encoded);
+
+	static Vector<uint16_t> encode_half2(const Vector<Vector2> &p_values);
+	static Vector<Vector2> decode_half2(const Vector<uint16_t> &p_encoded);
+
+	//Values are stored relative to r_range
+	static Vector<uint16_t> encode_unorm16_2(const Vector<Vector2> &p_values, Rect2 &r_range);
+	static Vector<Vector2> decode_unorm16_2(const Vector<uint16_t> &p_encoded, const Rect2 &p_range);
+	//Keeps p_range, returns false, if a value falls outside of it
+	static bool encode_unorm16_2_in_range(const Vector<Vector2> &p_values, const Rect2 &p_range, Vector<uint16_t> &r_encoded);
+
+	//Every 4 consecutive weights get normalized again when decoded
+	static Vector<uint8_t> encode_weights_unorm8(const Vector<float> &p_weights);
+	static Vector<float> decode_weights_unorm8(const Vector<uint8_t> &p_encoded);
+
+	static Vector<uint8_t> encode_colors_unorm8(const Vector<Color> &p_colors);
+	static Vector<Color> decode_colors_unorm8(const Vector<uint8_t> &p_encoded);
+
+	//Returns false, if a value doesn't fit
+	static bool encode_bones_uint8(const Vector<int> &p_bones, Vector<uint8_t> &r_encoded);
+	static Vector<int> decode_bones_uint8(const Vector<uint8_t> &p_encoded);
+
+protected:
+	static Vector2 _octahedral_encode(Vector3 p_normal);
+	static Vector3 _octahedral_decode(const Vector2 &p_encoded);
+};
+
+#endif
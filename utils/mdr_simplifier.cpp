@@ -0,0 +1,409 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_simplifier.h"
+
+#include "core/error/error_macros.h"
+#include "core/math/math_funcs.h"
+#include "core/templates/hash_map.h"
+
+Vector<uint32_t> MDRSimplifier::simplify(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const int p_target_index_count, const float p_target_error, float *r_error) {
+	int index_count = (p_index_count / 3) * 3;
+
+	Vector<uint32_t> result;
+	result.resize(index_count);
+
+	if (r_error) {
+		*r_error = 0;
+	}
+
+	if (index_count == 0) {
+		return result;
+	}
+
+	memcpy(result.ptrw(), p_indices, sizeof(uint32_t) * index_count);
+
+	for (int i = 0; i < index_count; ++i) {
+		ERR_FAIL_COND_V_MSG(p_indices[i] >= static_cast<uint32_t>(p_vertex_count), result, "Index out of range!");
+	}
+
+	//Vertices with the same position get the same quadric
+	Vector<uint32_t> position_remap;
+	position_remap.resize(p_vertex_count);
+	uint32_t *prw = position_remap.ptrw();
+
+	Vector<uint8_t> locked;
+	locked.resize(p_vertex_count);
+	uint8_t *lw = locked.ptrw();
+
+	HashMap<Vector3, uint32_t> positions;
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		lw[i] = 0;
+
+		uint32_t *existing = positions.getptr(p_vertices[i]);
+
+		if (existing) {
+			prw[i] = *existing;
+
+			//Seam, moving it would tear the mesh apart
+			lw[i] = 1;
+			lw[*existing] = 1;
+		} else {
+			prw[i] = i;
+			positions.insert(p_vertices[i], i);
+		}
+	}
+
+	//Edges only used by one triangle are on the border
+	HashMap<uint64_t, int> edges;
+
+	for (int i = 0; i < index_count; i += 3) {
+		for (int j = 0; j < 3; ++j) {
+			uint32_t a = prw[p_indices[i + j]];
+			uint32_t b = prw[p_indices[i + (j + 1) % 3]];
+
+			uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+
+			int *count = edges.getptr(key);
+
+			if (count) {
+				++(*count);
+			} else {
+				edges.insert(key, 1);
+			}
+		}
+	}
+
+	for (int i = 0; i < index_count; i += 3) {
+		for (int j = 0; j < 3; ++j) {
+			uint32_t a = prw[p_indices[i + j]];
+			uint32_t b = prw[p_indices[i + (j + 1) % 3]];
+
+			uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+
+			if (edges[key] == 1) {
+				lw[p_indices[i + j]] = 1;
+				lw[p_indices[i + (j + 1) % 3]] = 1;
+			}
+		}
+	}
+
+	for (int i = 0; i < p_vertex_count; ++i) {
+		if (lw[i]) {
+			lw[prw[i]] = 1;
+		}
+	}
+
+	Vector<Quadric> quadrics;
+	quadrics.resize(p_vertex_count);
+	Quadric *qw = quadrics.ptrw();
+
+	for (int i = 0; i < index_count; i += 3) {
+		Quadric q = _plane_quadric(p_vertices[p_indices[i]], p_vertices[p_indices[i + 1]], p_vertices[p_indices[i + 2]]);
+
+		for (int j = 0; j < 3; ++j) {
+			qw[prw[p_indices[i + j]]].add(q);
+		}
+	}
+
+	double error_limit = static_cast<double>(p_target_error) * p_target_error;
+	double max_error = 0;
+
+	Vector<int> triangle_offsets;
+	triangle_offsets.resize(p_vertex_count + 1);
+	int *tow = triangle_offsets.ptrw();
+
+	Vector<int> triangle_counts;
+	triangle_counts.resize(p_vertex_count);
+	int *tcw = triangle_counts.ptrw();
+
+	Vector<int> vertex_triangles;
+
+	Vector<uint32_t> collapse_remap;
+	collapse_remap.resize(p_vertex_count);
+	uint32_t *crw = collapse_remap.ptrw();
+
+	//Vertices that were involved in a collapse in the current pass
+	Vector<uint8_t> pass_locked;
+	pass_locked.resize(p_vertex_count);
+	uint8_t *plw = pass_locked.ptrw();
+
+	Vector<Collapse> collapses;
+
+	while (index_count > p_target_index_count) {
+		uint32_t *rw = result.ptrw();
+		int triangle_count = index_count / 3;
+
+		//Vertex -> triangle adjacency
+		for (int i = 0; i < p_vertex_count; ++i) {
+			tcw[i] = 0;
+		}
+
+		for (int i = 0; i < index_count; ++i) {
+			++tcw[rw[i]];
+		}
+
+		tow[0] = 0;
+		for (int i = 0; i < p_vertex_count; ++i) {
+			tow[i + 1] = tow[i] + tcw[i];
+			tcw[i] = 0;
+		}
+
+		vertex_triangles.resize(index_count);
+		int *vtw = vertex_triangles.ptrw();
+
+		for (int i = 0; i < index_count; ++i) {
+			uint32_t v = rw[i];
+			vtw[tow[v] + tcw[v]++] = i / 3;
+		}
+
+		collapses.clear();
+
+		for (int i = 0; i < index_count; i += 3) {
+			for (int j = 0; j < 3; ++j) {
+				uint32_t a = rw[i + j];
+				uint32_t b = rw[i + (j + 1) % 3];
+
+				for (int k = 0; k < 2; ++k) {
+					uint32_t from = k == 0 ? a : b;
+					uint32_t to = k == 0 ? b : a;
+
+					if (lw[from]) {
+						continue;
+					}
+
+					Quadric q = qw[prw[from]];
+					q.add(qw[prw[to]]);
+
+					Collapse c;
+					c.from = from;
+					c.to = to;
+					c.cost = q.evaluate(p_vertices[to]);
+
+					collapses.push_back(c);
+				}
+			}
+		}
+
+		if (collapses.size() == 0) {
+			break;
+		}
+
+		collapses.sort();
+
+		for (int i = 0; i < p_vertex_count; ++i) {
+			crw[i] = i;
+			plw[i] = 0;
+		}
+
+		//Every collapse removes about 2 triangles
+		int triangles_to_remove = (index_count - p_target_index_count) / 3;
+		int triangles_removed = 0;
+		int collapse_count = 0;
+
+		for (int i = 0; i < collapses.size() && triangles_removed < triangles_to_remove; ++i) {
+			const Collapse &c = collapses[i];
+
+			if (c.cost > error_limit) {
+				break;
+			}
+
+			if (plw[c.from] || plw[c.to]) {
+				continue;
+			}
+
+			const int *tris = vtw + tow[c.from];
+			int tri_count = tcw[c.from];
+
+			bool flips = false;
+			int removed = 0;
+
+			for (int j = 0; j < tri_count; ++j) {
+				const uint32_t *t = rw + tris[j] * 3;
+
+				if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+					++removed;
+					continue;
+				}
+
+				if (_flips(p_vertices, t, c.from, c.to)) {
+					flips = true;
+					break;
+				}
+			}
+
+			if (flips) {
+				continue;
+			}
+
+			crw[c.from] = c.to;
+			qw[prw[c.to]].add(qw[prw[c.from]]);
+
+			//The neighbours' triangles change, so their collapse costs and flip checks are stale until the next pass
+			for (int j = 0; j < tri_count; ++j) {
+				const uint32_t *t = rw + tris[j] * 3;
+
+				plw[t[0]] = 1;
+				plw[t[1]] = 1;
+				plw[t[2]] = 1;
+			}
+
+			triangles_removed += removed;
+			++collapse_count;
+
+			max_error = MAX(max_error, c.cost);
+		}
+
+		if (collapse_count == 0) {
+			break;
+		}
+
+		//Apply the collapses, and drop the degenerate triangles
+		int write = 0;
+
+		for (int i = 0; i < triangle_count; ++i) {
+			uint32_t a = crw[rw[i * 3]];
+			uint32_t b = crw[rw[i * 3 + 1]];
+			uint32_t c = crw[rw[i * 3 + 2]];
+
+			if (a == b || b == c || a == c) {
+				continue;
+			}
+
+			rw[write++] = a;
+			rw[write++] = b;
+			rw[write++] = c;
+		}
+
+		index_count = write;
+	}
+
+	result.resize(index_count);
+
+	if (r_error) {
+		*r_error = Math::sqrt(max_error);
+	}
+
+	return result;
+}
+
+void MDRSimplifier::Quadric::add(const Quadric &p_other) {
+	a00 += p_other.a00;
+	a01 += p_other.a01;
+	a02 += p_other.a02;
+	a11 += p_other.a11;
+	a12 += p_other.a12;
+	a22 += p_other.a22;
+	b0 += p_other.b0;
+	b1 += p_other.b1;
+	b2 += p_other.b2;
+	c += p_other.c;
+	weight += p_other.weight;
+}
+
+double MDRSimplifier::Quadric::evaluate(const Vector3 &p_point) const {
+	double x = p_point.x;
+	double y = p_point.y;
+	double z = p_point.z;
+
+	double r = a00 * x * x + a11 * y * y + a22 * z * z;
+	r += 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z);
+	r += 2.0 * (b0 * x + b1 * y + b2 * z);
+	r += c;
+
+	//Area weighted sum of squared distances -> mean squared distance
+	if (weight > 0) {
+		r /= weight;
+	}
+
+	return MAX(r, 0.0);
+}
+
+MDRSimplifier::Quadric::Quadric() {
+	a00 = 0;
+	a01 = 0;
+	a02 = 0;
+	a11 = 0;
+	a12 = 0;
+	a22 = 0;
+	b0 = 0;
+	b1 = 0;
+	b2 = 0;
+	c = 0;
+	weight = 0;
+}
+
+MDRSimplifier::Quadric MDRSimplifier::_plane_quadric(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c) {
+	Quadric q;
+
+	Vector3 n = (p_b - p_a).cross(p_c - p_a);
+	double area = n.length();
+
+	if (area <= 0) {
+		return q;
+	}
+
+	n /= area;
+
+	double nx = n.x;
+	double ny = n.y;
+	double nz = n.z;
+	double d = -(nx * p_a.x + ny * p_a.y + nz * p_a.z);
+
+	q.a00 = nx * nx * area;
+	q.a01 = nx * ny * area;
+	q.a02 = nx * nz * area;
+	q.a11 = ny * ny * area;
+	q.a12 = ny * nz * area;
+	q.a22 = nz * nz * area;
+	q.b0 = nx * d * area;
+	q.b1 = ny * d * area;
+	q.b2 = nz * d * area;
+	q.c = d * d * area;
+	q.weight = area;
+
+	return q;
+}
+
+bool MDRSimplifier::_flips(const Vector3 *p_vertices, const uint32_t *p_triangle, const uint32_t p_from, const uint32_t p_to) {
+	Vector3 a = p_vertices[p_triangle[0]];
+	Vector3 b = p_vertices[p_triangle[1]];
+	Vector3 c = p_vertices[p_triangle[2]];
+
+	Vector3 normal = (b - a).cross(c - a);
+
+	const Vector3 &target = p_vertices[p_to];
+
+	if (p_triangle[0] == p_from) {
+		a = target;
+	} else if (p_triangle[1] == p_from) {
+		b = target;
+	} else {
+		c = target;
+	}
+
+	Vector3 new_normal = (b - a).cross(c - a);
+
+	//Degenerate triangles count as flipped too, they usually mean a spike
+	return normal.dot(new_normal) <= 0;
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_SIMPLIFIER_H
+#define MDR_SIMPLIFIER_H
+
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+//Quadric error metric mesh simplifier. It only ever collapses vertices into other existing vertices,
+//so the result is an index buffer that can be used with the original vertex data.
+//Border vertices, and vertices that share their position with other vertices (uv / normal seams) are never moved.
+class MDRSimplifier {
+public:
+	//p_target_error is an absolute distance. r_error is set to the largest error that was introduced.
+	static Vector<uint32_t> simplify(const uint32_t *p_indices, const int p_index_count, const Vector3 *p_vertices, const int p_vertex_count, const int p_target_index_count, const float p_target_error, float *r_error = nullptr);
+
+protected:
+	struct Quadric {
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+
+		void add(const Quadric &p_other);
+		double evaluate(const Vector3 &p_point) const;
+
+		Quadric();
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+
+		bool operator<(const Collapse &p_other) const {
+			if (cost != p_other.cost) {
+				return cost < p_other.cost;
+			}
+
+			if (from != p_other.from) {
+				return from < p_other.from;
+			}
+
+			return to < p_other.to;
+		}
+	};
+
+	static Quadric _plane_quadric(const Vector3 &p_a, const Vector3 &p_b, const Vector3 &p_c);
+	static bool _flips(const Vector3 *p_vertices, const uint32_t *p_triangle, const uint32_t p_from, const uint32_t p_to);
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_snap.h"
+
+#include "core/object/worker_thread_pool.h"
+
+MDRSnap::Target MDRSnap::make_target(const Ref<MeshDataResource> &p_mesh, const Transform &p_transform) {
+	Target t;
+	t.mesh = p_mesh;
+	t.transform = p_transform;
+	t.inverse = p_transform.affine_inverse();
+	//Grown a bit, so rays along the faces of flat meshes aren't culled by rounding
+	t.aabb = p_transform.xform(p_mesh->get_aabb()).grow(CMP_EPSILON);
+
+	return t;
+}
+
+bool MDRSnap::snap_point(const Vector<Target> &p_targets, const Vector3 &p_point, const Vector3 &p_axis, Vector3 &r_point) {
+	if (_cast(p_targets, p_point, p_axis, r_point)) {
+		return true;
+	}
+
+	return _cast(p_targets, p_point, -p_axis, r_point);
+}
+
+int MDRSnap::snap_points(const Vector<Target> &p_targets, Vector3 *r_points, const Vector3 *p_axes, const int p_count) {
+	if (p_count == 0 || p_targets.size() == 0) {
+		return 0;
+	}
+
+	//Build the bvhs up front, so the worker threads don't end up waiting on each other for them
+	for (int i = 0; i < p_targets.size(); ++i) {
+		p_targets[i].mesh->get_bvh();
+	}
+
+	Vector<uint8_t> snapped;
+	snapped.resize(p_count);
+	uint8_t *sw = snapped.ptrw();
+
+	int thread_count = WorkerThreadPool::get_singleton()->get_thread_count();
+	int chunk_count = MAX(1, MIN(thread_count * 4, p_count / (PARALLEL_POINT_THRESHOLD / 4)));
+
+	//Pool threads don't wait on subtasks, every thread doing so would deadlock the pool
+	if (p_count < PARALLEL_POINT_THRESHOLD || chunk_count == 1 || WorkerThreadPool::get_singleton()->get_thread_index() != -1) {
+		_snap_range(p_targets, r_points, p_axes, sw, p_count);
+	} else {
+		ParallelData data;
+		data.targets = &p_targets;
+		data.points = r_points;
+		data.axes = p_axes;
+		data.snapped = sw;
+		data.count = p_count;
+		data.chunk_size = (p_count + chunk_count - 1) / chunk_count;
+
+		WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_native_group_task(&MDRSnap::_snap_chunk, &data, chunk_count, -1, true, "MDRSnap");
+		WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+	}
+
+	int snapped_count = 0;
+
+	for (int i = 0; i < p_count; ++i) {
+		snapped_count += sw[i];
+	}
+
+	return snapped_count;
+}
+
+bool MDRSnap::_cast(const Vector<Target> &p_targets, const Vector3 &p_point, const Vector3 &p_direction, Vector3 &r_point) {
+	bool found = false;
+	real_t best_distance = 0;
+
+	for (int i = 0; i < p_targets.size(); ++i) {
+		const Target &t = p_targets[i];
+
+		if (!t.aabb.intersects_ray(p_point, p_direction)) {
+			continue;
+		}
+
+		//The query is done in the mesh's space, the distances are compared in the targets' space
+		MDRBVH::Hit hit;
+
+		if (!t.mesh->get_bvh().intersect_ray(t.inverse.xform(p_point), t.inverse.basis.xform(p_direction), 1e20, hit)) {
+			continue;
+		}
+
+		Vector3 position = t.transform.xform(hit.position);
+		real_t distance = position.distance_squared_to(p_point);
+
+		if (!found || distance < best_distance) {
+			found = true;
+			best_distance = distance;
+			r_point = position;
+		}
+	}
+
+	return found;
+}
+
+void MDRSnap::_snap_range(const Vector<Target> &p_targets, Vector3 *r_points, const Vector3 *p_axes, uint8_t *r_snapped, const int p_count) {
+	for (int i = 0; i < p_count; ++i) {
+		Vector3 point;
+
+		if (snap_point(p_targets, r_points[i], p_axes[i], point)) {
+			r_points[i] = point;
+			r_snapped[i] = 1;
+		} else {
+			r_snapped[i] = 0;
+		}
+	}
+}
+
+void MDRSnap::_snap_chunk(void *p_userdata, uint32_t p_index) {
+	ParallelData *data = static_cast<ParallelData *>(p_userdata);
+
+	int from = p_index * data->chunk_size;
+	int count = MIN(data->chunk_size, data->count - from);
+
+	if (count <= 0) {
+		return;
+	}
+
+	_snap_range(*data->targets, data->points + from, data->axes + from, data->snapped + from, count);
+}
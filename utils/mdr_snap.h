@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_SNAP_H
+#define MDR_SNAP_H
+
+#include "core/math/aabb.h"
+#include "core/math/vector3.h"
+#include "core/templates/vector.h"
+
+#include "../mesh_data_resource.h"
+
+//Projects points along an axis onto the triangles of MeshDataResources, using their bvhs.
+//Large batches are split between the WorkerThreadPool's threads.
+class MDRSnap {
+public:
+	//Below this many points the work is not split between threads
+	static const int PARALLEL_POINT_THRESHOLD = 256;
+
+	struct Target {
+		Ref<MeshDataResource> mesh;
+		Transform transform;
+		Transform inverse;
+		//The mesh's aabb in the targets' space, rays that miss it skip the bvh
+		AABB aabb;
+	};
+
+	static Target make_target(const Ref<MeshDataResource> &p_mesh, const Transform &p_transform);
+
+	//p_axis is the direction to project along, if nothing is hit that way the opposite direction is tried.
+	//Everything is in the same (usually global) space as the targets' transforms.
+	static bool snap_point(const Vector<Target> &p_targets, const Vector3 &p_point, const Vector3 &p_axis, Vector3 &r_point);
+
+	//Snaps the points in place, every point has its own axis. Returns how many of them got snapped.
+	static int snap_points(const Vector<Target> &p_targets, Vector3 *r_points, const Vector3 *p_axes, const int p_count);
+
+protected:
+	struct ParallelData {
+		const Vector<Target> *targets;
+		Vector3 *points;
+		const Vector3 *axes;
+		uint8_t *snapped;
+		int count;
+		int chunk_size;
+	};
+
+	static bool _cast(const Vector<Target> &p_targets, const Vector3 &p_point, const Vector3 &p_direction, Vector3 &r_point);
+	static void _snap_range(const Vector<Target> &p_targets, Vector3 *r_points, const Vector3 *p_axes, uint8_t *r_snapped, const int p_count);
+	static void _snap_chunk(void *p_userdata, uint32_t p_index);
+};
+
+#endif
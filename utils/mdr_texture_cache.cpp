@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "mdr_texture_cache.h"
+
+#include "core/version.h"
+
+#if TEXTURE_PACKER_PRESENT
+#include "../../texture_packer/texture_resource/packer_image_resource.h"
+#endif
+
+//Entries of freed resources are only pruned once the cache doubled in size since the last time
+#define MDR_TEXTURE_CACHE_MIN_PRUNE_SIZE 64
+
+HashMap<ObjectID, ObjectID> MDRTextureCache::_textures;
+int MDRTextureCache::_prune_size = MDR_TEXTURE_CACHE_MIN_PRUNE_SIZE;
+Mutex MDRTextureCache::_mutex;
+
+#if TEXTURE_PACKER_PRESENT
+Ref<ImageTexture> MDRTextureCache::get_texture(const Ref<PackerImageResource> &p_resource) {
+	ERR_FAIL_COND_V(!p_resource.is_valid(), Ref<ImageTexture>());
+
+	MutexLock lock(_mutex);
+
+	ObjectID id = p_resource->get_instance_id();
+	ObjectID *texture_id = _textures.getptr(id);
+
+	if (texture_id) {
+		Ref<ImageTexture> tex = Object::cast_to<ImageTexture>(ObjectDB::get_instance(*texture_id));
+
+		if (tex.is_valid()) {
+			return tex;
+		}
+	}
+
+	Ref<Image> i = p_resource->get_data();
+
+	Ref<ImageTexture> tex;
+#if VERSION_MAJOR < 4
+	tex.instantiate();
+	tex->create_from_image(i, 0);
+#else
+	tex = ImageTexture::create_from_image(i);
+#endif
+
+	ERR_FAIL_COND_V(!tex.is_valid(), tex);
+
+	_textures[id] = tex->get_instance_id();
+
+	Callable on_changed = callable_mp_static(&MDRTextureCache::_resource_changed).bind(static_cast<uint64_t>(id));
+
+	if (!p_resource->is_connected("changed", on_changed)) {
+		p_resource->connect("changed", on_changed);
+	}
+
+	if (_textures.size() >= _prune_size) {
+		_prune();
+	}
+
+	return tex;
+}
+#endif
+
+void MDRTextureCache::clear() {
+	MutexLock lock(_mutex);
+
+	_textures.clear();
+	_prune_size = MDR_TEXTURE_CACHE_MIN_PRUNE_SIZE;
+}
+
+void MDRTextureCache::_resource_changed(const uint64_t p_id) {
+	MutexLock lock(_mutex);
+
+	_textures.erase(ObjectID(p_id));
+}
+
+void MDRTextureCache::_prune() {
+	Vector<ObjectID> dead;
+
+	for (const KeyValue<ObjectID, ObjectID> &E : _textures) {
+		if (!ObjectDB::get_instance(E.key) || !ObjectDB::get_instance(E.value)) {
+			dead.push_back(E.key);
+		}
+	}
+
+	for (int i = 0; i < dead.size(); ++i) {
+		_textures.erase(dead[i]);
+	}
+
+	_prune_size = MAX(MDR_TEXTURE_CACHE_MIN_PRUNE_SIZE, _textures.size() * 2);
+}
@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2019-2022 Péter Magyar
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MDR_TEXTURE_CACHE_H
+#define MDR_TEXTURE_CACHE_H
+
+#include "core/object/object_id.h"
+#include "core/os/mutex.h"
+#include "core/templates/hash_map.h"
+#include "scene/resources/texture.h"
+
+#if TEXTURE_PACKER_PRESENT
+class PackerImageResource;
+#endif
+
+//ImageTextures made from PackerImageResources, shared between every MeshDataInstance.
+//Only the ids are stored, so a texture is freed with its last user.
+class MDRTextureCache {
+public:
+#if TEXTURE_PACKER_PRESENT
+	static Ref<ImageTexture> get_texture(const Ref<PackerImageResource> &p_resource);
+#endif
+
+	static void clear();
+
+protected:
+	static void _resource_changed(const uint64_t p_id);
+	static void _prune();
+
+	//Resource id -> texture id
+	static HashMap<ObjectID, ObjectID> _textures;
+	static int _prune_size;
+	static Mutex _mutex;
+};
+
+#endif